@@ -0,0 +1,95 @@
+# caffql_generate(<target> <output>
+#                 SCHEMA <schema json file>
+#                 [NAMESPACE <generated namespace>]
+#                 [SELECTION <selection manifest json file>]
+#                 [ABSL]
+#                 [DECODER <sax|on-demand>]
+#                 [COMPACT_QUERIES]
+#                 [MAX_DEPTH <levels>]
+#                 [OPERATION_MAX_DEPTHS <operation type>.<field>=<levels>...]
+#                 [JOBS <threads>]
+#                 [SCHEMA_CACHE <cache file>]
+#                 [SPLIT_OUTPUT <directory>]
+#                 [SOURCE <source file>])
+#
+# Adds a custom command generating the header <output> from a GraphQL json schema, run before <target> builds. The
+# header's directory is added to <target>'s include directories. The header is regenerated when the schema or caffql
+# changes, and is only rewritten when its contents change, so targets including it don't rebuild for unchanged
+# schemas. The schema and selection manifest are the only inputs, so they are tracked directly rather than through a
+# --depfile. With SOURCE, the generated functions are defined in that source file, which is compiled into <target>
+# rather than into everything including the header. <target> then only needs to be the one library that includes the
+# header. The SPLIT_OUTPUT directory should only hold generated headers, as every header in it is a byproduct.
+function(caffql_generate target output)
+    cmake_parse_arguments(CAFFQL "ABSL;COMPACT_QUERIES" "SCHEMA;NAMESPACE;SELECTION;DECODER;MAX_DEPTH;JOBS;SCHEMA_CACHE;SPLIT_OUTPUT;SOURCE" "OPERATION_MAX_DEPTHS" ${ARGN})
+
+    if(NOT CAFFQL_SCHEMA)
+        message(FATAL_ERROR "caffql_generate requires a SCHEMA")
+    endif()
+
+    get_filename_component(output "${output}" ABSOLUTE BASE_DIR "${CMAKE_CURRENT_BINARY_DIR}")
+    get_filename_component(schema "${CAFFQL_SCHEMA}" ABSOLUTE)
+    set(arguments --schema "${schema}" --output "${output}")
+    if(CAFFQL_NAMESPACE)
+        list(APPEND arguments --namespace "${CAFFQL_NAMESPACE}")
+    endif()
+    set(selection "")
+    if(CAFFQL_SELECTION)
+        get_filename_component(selection "${CAFFQL_SELECTION}" ABSOLUTE)
+        list(APPEND arguments --selection "${selection}")
+    endif()
+    if(CAFFQL_ABSL)
+        list(APPEND arguments --absl)
+    endif()
+    if(CAFFQL_DECODER)
+        list(APPEND arguments --decoder "${CAFFQL_DECODER}")
+    endif()
+    if(CAFFQL_COMPACT_QUERIES)
+        list(APPEND arguments --compact-queries)
+    endif()
+    if(CAFFQL_MAX_DEPTH)
+        list(APPEND arguments --max-depth "${CAFFQL_MAX_DEPTH}")
+    endif()
+    foreach(operationMaxDepth IN LISTS CAFFQL_OPERATION_MAX_DEPTHS)
+        list(APPEND arguments --operation-max-depth "${operationMaxDepth}")
+    endforeach()
+    if(CAFFQL_JOBS)
+        list(APPEND arguments --jobs "${CAFFQL_JOBS}")
+    endif()
+    if(CAFFQL_SCHEMA_CACHE)
+        get_filename_component(schemaCache "${CAFFQL_SCHEMA_CACHE}" ABSOLUTE BASE_DIR "${CMAKE_CURRENT_BINARY_DIR}")
+        list(APPEND arguments --schema-cache "${schemaCache}")
+    endif()
+    set(splitHeaders "")
+    if(CAFFQL_SPLIT_OUTPUT)
+        get_filename_component(splitOutput "${CAFFQL_SPLIT_OUTPUT}" ABSOLUTE BASE_DIR "${CMAKE_CURRENT_BINARY_DIR}")
+        list(APPEND arguments --split-output "${splitOutput}")
+        # The headers are named after the schema's types, so they are only known once they have been generated. The
+        # glob is checked on every build, and reconfigures when generation adds or removes headers.
+        file(GLOB splitHeaders CONFIGURE_DEPENDS "${splitOutput}/*.hpp")
+        list(APPEND splitHeaders "${splitOutput}/caffql-common.hpp")
+        list(REMOVE_DUPLICATES splitHeaders)
+    endif()
+    set(source "")
+    if(CAFFQL_SOURCE)
+        get_filename_component(source "${CAFFQL_SOURCE}" ABSOLUTE BASE_DIR "${CMAKE_CURRENT_BINARY_DIR}")
+        list(APPEND arguments --source "${source}")
+    endif()
+
+    # The header keeps its modification time when it is unchanged, so a stamp records when it was last generated.
+    # Otherwise Make would consider it out of date and rerun the command on every build.
+    set(stamp "${output}.stamp")
+
+    add_custom_command(
+        OUTPUT "${stamp}"
+        BYPRODUCTS "${output}" ${source} ${splitHeaders}
+        COMMAND caffql-cli ${arguments}
+        COMMAND "${CMAKE_COMMAND}" -E touch "${stamp}"
+        DEPENDS caffql-cli "${schema}" ${selection}
+        COMMENT "Generating ${output} from ${CAFFQL_SCHEMA}"
+        VERBATIM
+    )
+
+    get_filename_component(outputDirectory "${output}" DIRECTORY)
+    target_sources(${target} PRIVATE "${stamp}" "${output}" ${source})
+    target_include_directories(${target} PRIVATE "${outputDirectory}")
+endfunction()
@@ -1,11 +1,59 @@
 #include "CodeGeneration.hpp"
+#include "Sha256.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
 
 namespace caffql {
 
+TypeRef::TypeRef(TypeKind kind, std::optional<Symbol> name, TypeRef const & ofType) {
+    if (kind != TypeKind::NonNull && kind != TypeKind::List) {
+        *this = TypeRef{kind, name};
+        return;
+    }
+
+    if (ofType.modifierCount == maxModifierCount) {
+        throw std::length_error{"TypeRef nesting exceeds " + std::to_string(maxModifierCount) + " levels"};
+    }
+
+    *this = ofType;
+    modifiers = (modifiers << 1) | (kind == TypeKind::List ? 1 : 0);
+    ++modifierCount;
+}
+
+TypeRef TypeRef::ofType() const {
+    if (modifierCount == 0) {
+        throw std::logic_error{"Only NonNull and List types have an ofType"};
+    }
+
+    auto type = *this;
+    type.modifiers >>= 1;
+    --type.modifierCount;
+    return type;
+}
+
+void from_json(Json const & json, Symbol & symbol) {
+    symbol = Symbol{json.get_ref<Json::string_t const &>()};
+}
+
 void from_json(Json const & json, TypeRef & type) {
-    get_value_to(json, "kind", type.kind);
-    get_value_to(json, "name", type.name);
-    get_value_to(json, "ofType", type.ofType);
+    TypeKind kind;
+    std::optional<Symbol> name;
+    get_value_to(json, "kind", kind);
+    get_value_to(json, "name", name);
+
+    auto ofType = json.find("ofType");
+    if (ofType != json.end() && !ofType->is_null()) {
+        type = TypeRef{kind, name, ofType->get<TypeRef>()};
+    } else {
+        type = TypeRef{kind, name};
+    }
 }
 
 void from_json(Json const & json, InputValue & input) {
@@ -56,47 +104,87 @@ void from_json(Json const & json, Schema & schema) {
     get_value_to(json, "types", schema.types);
 }
 
-std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & types) {
-    using namespace std;
+TypeMap::TypeMap(std::vector<Type> types) : types{std::move(types)} {
+    if (this->types.size() >= npos) {
+        throw std::length_error{"Too many types in schema"};
+    }
 
-    struct TypeWithDependencies {
-        Type type;
-        unordered_set<string> dependencies;
-    };
+    uint32_t maxSymbolId = 0;
+    for (auto const & type : this->types) {
+        maxSymbolId = std::max(maxSymbolId, type.name.id());
+    }
 
-    unordered_map<string, unordered_set<string>> typesToDependents;
-    map<string, TypeWithDependencies> typesToDependencies;
+    indicesBySymbolId.assign(size_t{maxSymbolId} + 1, npos);
+    for (TypeIndex index = 0; index < this->types.size(); ++index) {
+        indicesBySymbolId[this->types[index].name.id()] = index;
+    }
+}
 
-    auto isCustomType = [](TypeKind kind) {
-        switch (kind) {
-        case TypeKind::Object:
-        case TypeKind::Interface:
-        case TypeKind::Union:
-        case TypeKind::Enum:
-        case TypeKind::InputObject:
-            return true;
+TypeIndex TypeMap::indexOf(Symbol name) const {
+    auto const index = find(name);
+    if (index == npos) {
+        throw std::out_of_range{"Unknown type: " + name.str()};
+    }
+    return index;
+}
 
-        case TypeKind::Scalar:
-        case TypeKind::List:
-        case TypeKind::NonNull:
-            return false;
-        }
+static bool isCustomType(TypeKind kind) {
+    switch (kind) {
+    case TypeKind::Object:
+    case TypeKind::Interface:
+    case TypeKind::Union:
+    case TypeKind::Enum:
+    case TypeKind::InputObject:
+        return true;
 
-        throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
-    };
+    case TypeKind::Scalar:
+    case TypeKind::List:
+    case TypeKind::NonNull:
+        return false;
+    }
+
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(kind))};
+}
+
+static std::vector<bool> sortedCustomTypes(TypeMap const & typeMap) {
+    auto const & types = typeMap.all();
+    std::vector<bool> isSorted(types.size());
 
-    for (auto const & type : types) {
-        // Ignore metatypes, which begin with underscores
-        if (!isCustomType(type.kind) || type.name.rfind("__", 0) == 0) {
+    for (TypeIndex index = 0; index < types.size(); ++index) {
+        auto const & type = types[index];
+        // Ignore metatypes, which begin with underscores, and all but the last of any types sharing a name
+        isSorted[index] = isCustomType(type.kind) && type.name.str().rfind("__", 0) != 0 &&
+                          typeMap.find(type.name) == index;
+    }
+
+    return isSorted;
+}
+
+static std::vector<std::vector<TypeIndex>> customTypeDependencies(
+        TypeMap const & typeMap, std::vector<bool> const & isSorted) {
+    auto const & types = typeMap.all();
+    std::vector<std::vector<TypeIndex>> dependencies(types.size());
+    // The last type that each type was added as a dependency of, so that dependencies are only added once
+    std::vector<TypeIndex> lastDependents(types.size(), TypeMap::npos);
+
+    for (TypeIndex index = 0; index < types.size(); ++index) {
+        if (!isSorted[index]) {
             continue;
         }
 
-        unordered_set<string> dependencies;
+        auto const & type = types[index];
+        auto & typeDependencies = dependencies[index];
+
+        auto addDependency = [&](TypeRef const & dependency) {
+            if (!dependency.hasName() || !isCustomType(dependency.kind())) {
+                return;
+            }
 
-        auto addDependency = [&](auto const & dependency) {
-            if (dependency.name && isCustomType(dependency.kind)) {
-                typesToDependents[*dependency.name].insert(type.name);
-                dependencies.insert(*dependency.name);
+            auto const dependencyIndex = typeMap.find(dependency.name());
+            if (dependencyIndex != TypeMap::npos && isSorted[dependencyIndex] &&
+                lastDependents[dependencyIndex] != index) {
+                lastDependents[dependencyIndex] = index;
+                typeDependencies.push_back(dependencyIndex);
             }
         };
 
@@ -115,78 +203,219 @@ std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & typ
         for (auto const & possibleType : type.possibleTypes) {
             addDependency(possibleType);
         }
-
-        typesToDependencies[type.name] = {type, move(dependencies)};
     }
 
-    vector<Type> sortedTypes;
+    return dependencies;
+}
+
+std::vector<std::vector<TypeIndex>> customTypeDependencies(TypeMap const & typeMap) {
+    return customTypeDependencies(typeMap, sortedCustomTypes(typeMap));
+}
+
+std::vector<TypeComponent> sortCustomTypeComponentsByDependencyOrder(TypeMap const & typeMap) {
+    using namespace std;
+
+    auto const & types = typeMap.all();
+    auto const isSorting = sortedCustomTypes(typeMap);
+    auto const dependencies = customTypeDependencies(typeMap, isSorting);
+
+    // Tarjan's strongly connected components, iteratively so that long chains can't overflow the stack. Components
+    // are completed in dependency order, which the sort below doesn't rely on.
+    constexpr auto unvisited = numeric_limits<size_t>::max();
+    vector<size_t> visitOrder(types.size(), unvisited);
+    vector<size_t> lowLinks(types.size());
+    vector<bool> isOnStack(types.size());
+    vector<TypeIndex> stack;
+    vector<size_t> componentIndices(types.size());
+    vector<TypeComponent> components;
+    size_t visitCount = 0;
+
+    auto visit = [&](TypeIndex index) {
+        visitOrder[index] = lowLinks[index] = visitCount++;
+        stack.push_back(index);
+        isOnStack[index] = true;
+    };
+
+    for (TypeIndex root = 0; root < types.size(); ++root) {
+        if (!isSorting[root] || visitOrder[root] != unvisited) {
+            continue;
+        }
 
-    while (!typesToDependencies.empty()) {
-        auto const initialCount = typesToDependencies.size();
+        // Each frame is a type and the index of its next dependency to visit
+        vector<pair<TypeIndex, size_t>> frames{{root, 0}};
+        visit(root);
+
+        while (!frames.empty()) {
+            auto const index = frames.back().first;
+            auto & nextDependency = frames.back().second;
+
+            if (nextDependency < dependencies[index].size()) {
+                auto const dependency = dependencies[index][nextDependency++];
+                if (visitOrder[dependency] == unvisited) {
+                    visit(dependency);
+                    frames.push_back({dependency, 0});
+                } else if (isOnStack[dependency]) {
+                    lowLinks[index] = min(lowLinks[index], visitOrder[dependency]);
+                }
+                continue;
+            }
 
-        vector<string> addedTypeNames;
+            if (lowLinks[index] == visitOrder[index]) {
+                TypeComponent component;
+                TypeIndex member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    isOnStack[member] = false;
+                    componentIndices[member] = components.size();
+                    component.types.push_back(member);
+                } while (member != index);
+
+                sort(component.types.begin(), component.types.end(), [&](TypeIndex lhs, TypeIndex rhs) {
+                    return types[lhs].name < types[rhs].name;
+                });
+                component.isRecursive = component.types.size() > 1 ||
+                                        find(dependencies[index].begin(), dependencies[index].end(), index) !=
+                                                dependencies[index].end();
+                components.push_back(move(component));
+            }
 
-        for (auto const & pair : typesToDependencies) {
-            if (pair.second.dependencies.empty()) {
-                sortedTypes.push_back(pair.second.type);
-                addedTypeNames.push_back(pair.first);
+            frames.pop_back();
+            if (!frames.empty()) {
+                auto const parent = frames.back().first;
+                lowLinks[parent] = min(lowLinks[parent], lowLinks[index]);
+            }
+        }
+    }
 
-                for (auto const & dependentName : typesToDependents[pair.first]) {
-                    typesToDependencies[dependentName].dependencies.erase(pair.first);
+    // Number of distinct dependency components not yet sorted, and the components that depend on each component
+    vector<size_t> unsortedDependencyCounts(components.size());
+    vector<vector<size_t>> dependents(components.size());
+    // The last component that each component was counted as a dependency of
+    vector<size_t> lastDependentComponents(components.size(), numeric_limits<size_t>::max());
+
+    for (size_t componentIndex = 0; componentIndex < components.size(); ++componentIndex) {
+        for (auto const index : components[componentIndex].types) {
+            for (auto const dependency : dependencies[index]) {
+                auto const dependencyComponent = componentIndices[dependency];
+                if (dependencyComponent != componentIndex &&
+                    lastDependentComponents[dependencyComponent] != componentIndex) {
+                    lastDependentComponents[dependencyComponent] = componentIndex;
+                    ++unsortedDependencyCounts[componentIndex];
+                    dependents[dependencyComponent].push_back(componentIndex);
                 }
             }
         }
+    }
+
+    // Emits components, named by their alphabetically first type, in alphabetical passes over the components whose
+    // dependencies are all sorted. A component that becomes ready after the current pass has gone by its name waits
+    // for the next pass, so the order is the same as repeatedly sweeping the remaining types alphabetically, without
+    // rescanning them.
+    struct IsAlphabeticallyAfter {
+        vector<Type> const * types;
+        vector<TypeComponent> const * components;
+
+        bool operator()(size_t lhs, size_t rhs) const { return name(rhs) < name(lhs); }
+
+        Symbol name(size_t component) const { return (*types)[(*components)[component].types.front()].name; }
+    };
+
+    IsAlphabeticallyAfter const isAlphabeticallyAfter{&types, &components};
+    using ReadyQueue = priority_queue<size_t, vector<size_t>, IsAlphabeticallyAfter>;
+    ReadyQueue currentPass{isAlphabeticallyAfter};
+    ReadyQueue nextPass{isAlphabeticallyAfter};
+
+    for (size_t componentIndex = 0; componentIndex < components.size(); ++componentIndex) {
+        if (unsortedDependencyCounts[componentIndex] == 0) {
+            currentPass.push(componentIndex);
+        }
+    }
 
-        for (auto const & addedName : addedTypeNames) {
-            typesToDependencies.erase(addedName);
+    vector<TypeComponent> sortedComponents;
+    sortedComponents.reserve(components.size());
+
+    while (!currentPass.empty() || !nextPass.empty()) {
+        if (currentPass.empty()) {
+            swap(currentPass, nextPass);
         }
 
-        if (typesToDependencies.size() == initialCount) {
-            throw runtime_error{"Circular dependencies in schema"};
+        auto const componentIndex = currentPass.top();
+        currentPass.pop();
+        sortedComponents.push_back(components[componentIndex]);
+
+        for (auto const dependent : dependents[componentIndex]) {
+            if (--unsortedDependencyCounts[dependent] == 0) {
+                (isAlphabeticallyAfter(dependent, componentIndex) ? currentPass : nextPass).push(dependent);
+            }
         }
     }
 
+    return sortedComponents;
+}
+
+std::vector<TypeIndex> sortCustomTypesByDependencyOrder(TypeMap const & typeMap) {
+    std::vector<TypeIndex> sortedTypes;
+    for (auto const & component : sortCustomTypeComponentsByDependencyOrder(typeMap)) {
+        sortedTypes.insert(sortedTypes.end(), component.types.begin(), component.types.end());
+    }
     return sortedTypes;
 }
 
+BoxedTypes boxedTypes(std::vector<TypeComponent> const & components, TypeMap const & typeMap) {
+    BoxedTypes boxed;
+    for (auto const & component : components) {
+        if (component.isRecursive) {
+            for (auto const index : component.types) {
+                boxed.insert(typeMap.at(index).name);
+            }
+        }
+    }
+    return boxed;
+}
+
 std::string indent(size_t indentation) { return std::string(indentation * spacesPerIndent, ' '); }
 
-std::string generateDescription(std::optional<std::string> const & optionalDescription, size_t indentation) {
+void generateDescription(CodeWriter & writer, std::optional<std::string> const & optionalDescription) {
     if (!optionalDescription) {
-        return "";
+        return;
     }
 
     auto const & description = *optionalDescription;
     if (description.empty()) {
-        return {};
+        return;
     }
 
-    std::string generated;
-
     if (description.find('\n') == std::string::npos) {
-        generated += indent(indentation) + "// " + description + "\n";
+        writer.indent() << "// " << description << '\n';
     } else {
         // Use block comments for multiline strings
-        generated += indent(indentation) + "/*\n" + indent(indentation);
+        writer.indent() << "/*\n";
+        writer.indent();
 
         for (auto const character : description) {
             if (character == '\n') {
-                generated += "\n" + indent(indentation);
+                writer << '\n';
+                writer.indent();
                 continue;
             }
 
-            generated += character;
+            writer << character;
         }
 
-        generated += "\n" + indent(indentation) + "*/\n";
+        writer << '\n';
+        writer.indent() << "*/\n";
     }
-
-    return generated;
 }
 
-std::string screamingSnakeCaseToPascalCase(std::string const & snake) {
-    std::string pascal;
+std::string generateDescription(std::optional<std::string> const & description, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateDescription(writer, description);
+    return writer.take();
+}
 
+// Writes a screaming snake case name in pascal case, without an intermediate string.
+static void writePascalCase(CodeWriter & writer, std::string const & snake) {
     bool isFirstInWord = true;
     for (auto const & character : snake) {
         if (character == '_') {
@@ -194,15 +423,15 @@ std::string screamingSnakeCaseToPascalCase(std::string const & snake) {
             continue;
         }
 
-        if (isFirstInWord) {
-            pascal += toupper(character);
-            isFirstInWord = false;
-        } else {
-            pascal += tolower(character);
-        }
+        writer << static_cast<char>(isFirstInWord ? toupper(character) : tolower(character));
+        isFirstInWord = false;
     }
+}
 
-    return pascal;
+std::string screamingSnakeCaseToPascalCase(std::string const & snake) {
+    CodeWriter writer;
+    writePascalCase(writer, snake);
+    return writer.take();
 }
 
 std::string capitalize(std::string string) {
@@ -215,42 +444,129 @@ std::string uncapitalize(std::string string) {
     return string;
 }
 
+void generateEnum(CodeWriter & writer, Type const & type) {
+    generateDescription(writer, type.description);
+    writer.indent() << "enum class " << type.name.str() << " {\n";
+
+    for (auto const & value : type.enumValues) {
+        writer.increaseIndentation();
+        generateDescription(writer, value.description);
+        writer.decreaseIndentation();
+        writePascalCase(writer.indent(1), value.name);
+        writer << ",\n";
+    }
+
+    writer.indent(1) << unknownCaseName << " = -1\n";
+
+    writer.indent() << "};\n\n";
+}
+
 std::string generateEnum(Type const & type, size_t indentation) {
-    std::string generated;
-    generated += generateDescription(type.description, indentation);
-    generated += indent(indentation) + "enum class " + type.name + " {\n";
+    CodeWriter writer{indentation};
+    generateEnum(writer, type);
+    return writer.take();
+}
 
-    auto const valueIndentation = indentation + 1;
+static void writeDeserializationFunctionSignature(
+        CodeWriter & writer, std::string_view typeName, FunctionPart part = FunctionPart::InlineDefinition) {
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
+    }
+    writer << "void from_json(" << cppJsonTypeName << " const & json, " << typeName << " & value)";
+}
 
-    for (auto const & value : type.enumValues) {
-        generated += generateDescription(value.description, valueIndentation);
-        generated += indent(valueIndentation) + screamingSnakeCaseToPascalCase(value.name) + ",\n";
+static void writeSerializationFunctionSignature(
+        CodeWriter & writer, std::string_view typeName, FunctionPart part = FunctionPart::InlineDefinition) {
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
     }
+    writer << "void to_json(" << cppJsonTypeName << " & json, " << typeName << " const & value)";
+}
+
+static void generateEnumToStringView(CodeWriter & writer, Type const & type) {
+    auto const & name = type.name.str();
 
-    generated += indent(valueIndentation) + unknownCaseName + " = -1\n";
+    writer.indent() << "constexpr string_view to_string_view(" << name << " value) {\n";
+    writer.indent(1) << "switch (value) {\n";
+
+    for (auto const & value : type.enumValues) {
+        writer.indent(1) << "case " << name << "::";
+        writePascalCase(writer, value.name);
+        writer << ":\n";
+        writer.indent(2) << "return \"" << value.name << "\";\n";
+    }
 
-    generated += indent(indentation) + "};\n\n";
+    writer.indent(1) << "case " << name << "::" << unknownCaseName << ":\n";
+    writer.indent(2) << "break;\n";
+    writer.indent(1) << "}\n";
+    writer.indent(1) << "return {};\n";
+    writer.indent() << "}\n\n";
+}
 
-    return generated;
+static void writeFromStringViewSignature(CodeWriter & writer, std::string_view typeName, FunctionPart part) {
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
+    }
+    writer << "void from_string_view(string_view name, " << typeName << " & value)";
 }
 
-std::string generateEnumSerialization(Type const & type, size_t indentation) {
-    std::string generated;
+void generateEnumSerialization(CodeWriter & writer, Type const & type, FunctionPart part) {
+    auto const & name = type.name.str();
 
-    generated += indent(indentation) + "NLOHMANN_JSON_SERIALIZE_ENUM(" + type.name + ", {\n";
+    if (part != FunctionPart::Definition) {
+        generateEnumToStringView(writer, type);
+    }
 
-    auto const valueIndentation = indentation + 1;
+    if (part == FunctionPart::Declaration) {
+        writeFromStringViewSignature(writer.indent(), name, part);
+        writer << ";\n";
+        writeSerializationFunctionSignature(writer.indent(), name, part);
+        writer << ";\n";
+        writeDeserializationFunctionSignature(writer.indent(), name, part);
+        writer << ";\n\n";
+        return;
+    }
 
-    generated += indent(valueIndentation) + "{" + type.name + "::" + unknownCaseName + ", nullptr},\n";
+    writeFromStringViewSignature(writer.indent(), name, part);
+    writer << " {\n";
 
+    std::vector<std::string_view> names;
+    names.reserve(type.enumValues.size());
     for (auto const & value : type.enumValues) {
-        generated += indent(valueIndentation) + "{" + type.name + "::" + screamingSnakeCaseToPascalCase(value.name) +
-                     ", \"" + value.name + "\"},\n";
+        names.push_back(value.name);
     }
 
-    generated += indent(indentation) + "});\n\n";
+    generateStringDispatch(writer, "name", names, [&](size_t index) {
+        return "value = " + name + "::" + screamingSnakeCaseToPascalCase(type.enumValues[index].name) + ";";
+    });
+
+    writer.indent(1) << "value = " << name << "::" << unknownCaseName << ";\n";
+    writer.indent() << "}\n\n";
+
+    writeSerializationFunctionSignature(writer.indent(), name, part);
+    writer << " {\n";
+    writer.indent(1) << "auto const name = to_string_view(value);\n";
+    writer.indent(1) << "if (name.empty()) {\n";
+    writer.indent(2) << "json = nullptr;\n";
+    writer.indent(1) << "} else {\n";
+    writer.indent(2) << "json = std::string(name.data(), name.size());\n";
+    writer.indent(1) << "}\n";
+    writer.indent() << "}\n\n";
+
+    writeDeserializationFunctionSignature(writer.indent(), name, part);
+    writer << " {\n";
+    writer.indent(1) << "if (json.is_string()) {\n";
+    writer.indent(2) << "from_string_view(json.get_ref<std::string const &>(), value);\n";
+    writer.indent(1) << "} else {\n";
+    writer.indent(2) << "value = " << name << "::" << unknownCaseName << ";\n";
+    writer.indent(1) << "}\n";
+    writer.indent() << "}\n\n";
+}
 
-    return generated;
+std::string generateEnumSerialization(Type const & type, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateEnumSerialization(writer, type);
+    return writer.take();
 }
 
 Scalar scalarType(std::string const & name) {
@@ -287,380 +603,2720 @@ std::string cppScalarName(Scalar scalar) {
     throw std::invalid_argument{"Invalid Scalar value: " + std::to_string(static_cast<int>(scalar))};
 }
 
-std::string cppTypeName(TypeRef const & type, bool shouldCheckNullability) {
-    if (shouldCheckNullability && type.kind != TypeKind::NonNull) {
-        return "optional<" + cppTypeName(type, false) + ">";
+namespace {
+
+struct TypeNameCache {
+    std::mutex mutex;
+    // Node based, so references to the names stay valid as more are added.
+    std::unordered_map<TypeRef, std::string> names;
+};
+
+// The names of a cache that a thread has already looked up, which it finds again without taking the cache's lock.
+using ThreadTypeNames = std::unordered_map<TypeRef, std::string const *>;
+
+} // namespace
+
+template <typename Render>
+static std::string const & memoizedTypeName(
+        TypeNameCache & cache, ThreadTypeNames & threadNames, TypeRef const & type, Render && render) {
+    auto threadName = threadNames.find(type);
+    if (threadName != threadNames.end()) {
+        return *threadName->second;
     }
 
-    switch (type.kind) {
-    case TypeKind::Object:
-    case TypeKind::Interface:
-    case TypeKind::Union:
-    case TypeKind::Enum:
-    case TypeKind::InputObject:
-        return type.name.value();
+    std::string const * name = nullptr;
+    {
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        auto it = cache.names.find(type);
+        if (it != cache.names.end()) {
+            name = &it->second;
+        }
+    }
 
-    case TypeKind::Scalar:
-        return cppScalarName(scalarType(type.name.value()));
+    if (!name) {
+        // Rendering recurses into the cache for wrapped types, so it happens outside the lock.
+        auto rendered = render();
 
-    case TypeKind::List:
-        return "std::vector<" + cppTypeName(*type.ofType) + ">";
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        name = &cache.names.emplace(type, std::move(rendered)).first->second;
+    }
 
-    case TypeKind::NonNull:
-        return cppTypeName(*type.ofType, false);
+    threadNames.emplace(type, name);
+    return *name;
+}
+
+std::string const & cppTypeName(TypeRef const & type, bool shouldCheckNullability) {
+    static TypeNameCache nullableCache;
+    static TypeNameCache cache;
+    thread_local ThreadTypeNames nullableThreadNames;
+    thread_local ThreadTypeNames threadNames;
+
+    if (shouldCheckNullability && type.kind() != TypeKind::NonNull) {
+        return memoizedTypeName(nullableCache, nullableThreadNames, type, [&] {
+            return "optional<" + cppTypeName(type, false) + ">";
+        });
     }
 
-    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind))};
+    return memoizedTypeName(cache, threadNames, type, [&]() -> std::string {
+        switch (type.kind()) {
+        case TypeKind::Object:
+        case TypeKind::Interface:
+        case TypeKind::Union:
+        case TypeKind::Enum:
+        case TypeKind::InputObject:
+            return type.name().str();
+
+        case TypeKind::Scalar:
+            return cppScalarName(scalarType(type.name().str()));
+
+        case TypeKind::List:
+            return "std::vector<" + cppTypeName(type.ofType()) + ">";
+
+        case TypeKind::NonNull:
+            return cppTypeName(type.ofType(), false);
+        }
+
+        throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind()))};
+    });
 }
 
-std::string graphqlTypeName(TypeRef const & type) {
-    switch (type.kind) {
-    case TypeKind::Scalar:
+std::string const & graphqlTypeName(TypeRef const & type) {
+    static TypeNameCache cache;
+    thread_local ThreadTypeNames threadNames;
+
+    return memoizedTypeName(cache, threadNames, type, [&]() -> std::string {
+        switch (type.kind()) {
+        case TypeKind::Scalar:
+        case TypeKind::Object:
+        case TypeKind::Union:
+        case TypeKind::Interface:
+        case TypeKind::Enum:
+        case TypeKind::InputObject:
+            return type.name().str();
+
+        case TypeKind::List:
+            return "[" + graphqlTypeName(type.ofType()) + "]";
+
+        case TypeKind::NonNull:
+            return graphqlTypeName(type.ofType()) + "!";
+        }
+
+        throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind()))};
+    });
+}
+
+std::string cppBoxedTypeName(TypeRef const & type, bool shouldCheckNullability) {
+    switch (type.kind()) {
     case TypeKind::Object:
-    case TypeKind::Union:
     case TypeKind::Interface:
+    case TypeKind::Union:
     case TypeKind::Enum:
     case TypeKind::InputObject:
-        return type.name.value();
+    case TypeKind::Scalar:
+        // Boxes are nullable, so they replace the optional as well as the value
+        return std::string{cppBoxedOptionalTypeName} + "<" + cppTypeName(type, false) + ">";
 
-    case TypeKind::List:
-        return "[" + graphqlTypeName(*type.ofType) + "]";
+    case TypeKind::List: {
+        auto list = "std::vector<" + cppBoxedTypeName(type.ofType()) + ">";
+        return shouldCheckNullability ? "optional<" + list + ">" : list;
+    }
 
     case TypeKind::NonNull:
-        return graphqlTypeName(*type.ofType) + "!";
+        return cppBoxedTypeName(type.ofType(), false);
     }
 
-    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind))};
+    throw std::invalid_argument{"Invalid TypeKind value: " + std::to_string(static_cast<int>(type.kind()))};
 }
 
-std::string cppVariant(std::vector<TypeRef> const & possibleTypes, std::string const & unknownTypeName) {
-    std::string generated = "variant<";
-    for (auto const & type : possibleTypes) {
-        generated += type.name.value() + ", ";
-    }
-    generated += unknownTypeName + ">";
-    return generated;
+bool isBoxed(TypeRef const & type, BoxedTypes const & boxedTypes) {
+    auto const underlyingType = type.underlyingType();
+    return underlyingType.hasName() && boxedTypes.count(underlyingType.name()) > 0;
 }
 
-std::string generateDeserializationFunctionDeclaration(std::string const & typeName, size_t indentation) {
-    return indent(indentation) + "inline void from_json(" + cppJsonTypeName + " const & json, " + typeName +
-           " & value) {\n";
+std::string cppMemberTypeName(TypeRef const & type, BoxedTypes const & boxedTypes) {
+    if (!isBoxed(type, boxedTypes)) {
+        return cppTypeName(type);
+    }
+    // Boxed members are deserialized as nullable, including lists of boxes.
+    return cppBoxedTypeName(type.kind() == TypeKind::NonNull ? type.ofType() : type);
 }
 
-std::string generateFieldDeserialization(Field const & field, size_t indentation) {
-    if (field.type.kind == TypeKind::NonNull) {
-        return indent(indentation) + "json.at(\"" + field.name + "\").get_to(value." + field.name + ");\n";
+void cppVariant(CodeWriter & writer, std::vector<TypeRef> const & possibleTypes, std::string_view unknownTypeName) {
+    writer << "variant<";
+    for (auto const & type : possibleTypes) {
+        writer << type.name().str() << ", ";
     }
+    writer << unknownTypeName << '>';
+}
 
-    std::string generated;
-    generated += indent(indentation) + "{\n";
-    generated += indent(indentation + 1) + "auto it = json.find(\"" + field.name + "\");\n";
-    generated += indent(indentation + 1) + "if (it != json.end()) {\n";
-    generated += indent(indentation + 2) + "it->get_to(value." + field.name + ");\n";
-    generated += indent(indentation + 1) + "} else {\n";
-    generated += indent(indentation + 2) + "value." + field.name + ".reset();\n";
-    generated += indent(indentation + 1) + "}\n";
-    generated += indent(indentation) + "}\n";
+std::string cppVariant(std::vector<TypeRef> const & possibleTypes, std::string const & unknownTypeName) {
+    CodeWriter writer;
+    cppVariant(writer, possibleTypes, unknownTypeName);
+    return writer.take();
+}
 
-    return generated;
+void generateDeserializationFunctionDeclaration(CodeWriter & writer, std::string_view typeName, FunctionPart part) {
+    writeDeserializationFunctionSignature(writer.indent(), typeName, part);
+    writer << " {\n";
 }
 
-std::string generateVariantDeserialization(
-        Type const & type, std::string const & constructUnknown, size_t indentation) {
-    std::string generated;
+// Declares a deserialization function that a generated source defines.
+static void generateDeserializationFunctionPrototype(CodeWriter & writer, std::string_view typeName) {
+    writeDeserializationFunctionSignature(writer.indent(), typeName, FunctionPart::Declaration);
+    writer << ";\n\n";
+}
+
+std::string generateDeserializationFunctionDeclaration(std::string const & typeName, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateDeserializationFunctionDeclaration(writer, typeName);
+    return writer.take();
+}
 
-    generated += generateDeserializationFunctionDeclaration(type.name, indentation);
+// Boxed members are deserialized as nullable, see README.md.
+static bool isRequiredField(Field const & field, BoxedTypes const & boxedTypes) {
+    return field.type.kind() == TypeKind::NonNull && !isBoxed(field.type, boxedTypes);
+}
 
-    generated += indent(indentation + 1) + "std::string occupiedType = json.at(\"__typename\");\n";
-    generated += indent(indentation + 1);
+void generateFieldDeserialization(CodeWriter & writer, Field const & field, BoxedTypes const & boxedTypes) {
+    auto const & name = field.name.str();
 
-    for (auto const & possibleType : type.possibleTypes) {
-        generated += "if (occupiedType == \"" + possibleType.name.value() + "\") {\n";
-        generated += indent(indentation + 2) + "value = {" + possibleType.name.value() + "(json)};\n";
-        generated += indent(indentation + 1) + "} else ";
+    if (isRequiredField(field, boxedTypes)) {
+        writer.indent() << "json.at(\"" << name << "\").get_to(value." << name << ");\n";
+        return;
     }
 
-    generated += "{\n";
-    generated += indent(indentation + 2) + "value = {" + constructUnknown + "};\n";
-    generated += indent(indentation + 1) + "}\n";
-
-    generated += indent(indentation) + "}\n\n";
+    writer.indent() << "{\n";
+    writer.indent(1) << "auto it = json.find(\"" << name << "\");\n";
+    writer.indent(1) << "if (it != json.end()) {\n";
+    writer.indent(2) << "it->get_to(value." << name << ");\n";
+    writer.indent(1) << "} else {\n";
+    writer.indent(2) << "value." << name << ".reset();\n";
+    writer.indent(1) << "}\n";
+    writer.indent() << "}\n";
+}
 
-    return generated;
+std::string generateFieldDeserialization(Field const & field, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateFieldDeserialization(writer, field, boxedTypes);
+    return writer.take();
 }
 
-std::string generateInterface(Type const & type, size_t indentation) {
-    std::string interface;
-    std::string unknownImplementation;
+namespace {
 
-    interface += generateDescription(type.description, indentation);
-    interface += indent(indentation) + "struct " + type.name + " {\n";
-    auto const unknownTypeName = unknownCaseName + type.name;
-    unknownImplementation += indent(indentation) + "struct " + unknownTypeName + " {\n";
+struct StringDispatch {
+    CodeWriter & writer;
+    std::string_view subject;
+    std::vector<std::string_view> const & names;
+    DispatchMatch const & generateMatch;
 
-    auto const fieldIndentation = indentation + 1;
+    void generateMatchOf(size_t index, size_t level) const {
+        writer.indent(level) << "if (" << subject << " == \"" << names[index] << "\") {\n";
+        writer.indent(level + 1) << generateMatch(index) << "\n";
+        writer.indent(level + 1) << "return;\n";
+        writer.indent(level) << "}\n";
+    }
 
-    interface += indent(fieldIndentation) + cppVariant(type.possibleTypes, unknownTypeName) + " implementation;\n\n";
+    // Switches on the character that the most of the names, all of one size, differ in, until one name is left.
+    void generateCharacterSwitch(std::vector<size_t> const & indices, size_t level) const {
+        std::map<char, std::vector<size_t>> partition;
+        size_t position = 0;
 
-    for (auto const & field : type.fields) {
-        auto const typeName = cppTypeName(field.type);
-        unknownImplementation += indent(fieldIndentation) + typeName + " " + field.name + ";\n";
+        for (size_t candidate = 0; candidate < names[indices.front()].size(); ++candidate) {
+            std::map<char, std::vector<size_t>> candidatePartition;
+            for (auto index : indices) {
+                candidatePartition[names[index][candidate]].push_back(index);
+            }
 
-        auto const typeNameConstRef = typeName + " const & ";
-        interface += generateDescription(field.description, fieldIndentation);
-        interface += indent(fieldIndentation) + typeNameConstRef + field.name + "() const {\n";
-        interface += indent(fieldIndentation + 1) + "return visit([](auto const & implementation) -> " +
-                     typeNameConstRef + "{\n";
-        interface += indent(fieldIndentation + 2) + "return implementation." + field.name + ";\n";
-        interface += indent(fieldIndentation + 1) + "}, implementation);\n";
-        interface += indent(fieldIndentation) + "}\n\n";
-    }
+            if (candidatePartition.size() > partition.size()) {
+                partition = std::move(candidatePartition);
+                position = candidate;
+            }
+        }
 
-    interface += indent(indentation) + "};\n\n";
-    unknownImplementation += indent(indentation) + "};\n\n";
+        if (partition.size() <= 1) {
+            for (auto index : indices) {
+                generateMatchOf(index, level);
+            }
+            return;
+        }
 
-    return unknownImplementation + interface;
-}
+        writer.indent(level) << "switch (" << subject << "[" << std::to_string(position) << "]) {\n";
 
-std::string generateInterfaceUnknownCaseDeserialization(Type const & type, size_t indentation) {
-    std::string generated;
+        for (auto const & [character, group] : partition) {
+            writer.indent(level) << "case '" << character << "':\n";
+            generateCharacterSwitch(group, level + 1);
+            writer.indent(level + 1) << "break;\n";
+        }
 
-    auto const unknownTypeName = unknownCaseName + type.name;
+        writer.indent(level) << "}\n";
+    }
+};
 
-    generated += generateDeserializationFunctionDeclaration(unknownTypeName, indentation);
+} // namespace
 
-    for (auto const & field : type.fields) {
-        generated += generateFieldDeserialization(field, indentation + 1);
+void generateStringDispatch(
+        CodeWriter & writer,
+        std::string_view subject,
+        std::vector<std::string_view> const & names,
+        DispatchMatch const & generateMatch) {
+    if (names.empty()) {
+        return;
     }
 
-    generated += indent(indentation) + "}\n\n";
+    std::map<size_t, std::vector<size_t>> indicesBySize;
+    for (size_t index = 0; index < names.size(); ++index) {
+        indicesBySize[names[index].size()].push_back(index);
+    }
 
-    return generated;
-}
+    StringDispatch const dispatch{writer, subject, names, generateMatch};
 
-std::string generateInterfaceDeserialization(Type const & type, size_t indentation) {
-    return generateInterfaceUnknownCaseDeserialization(type, indentation) +
-           generateVariantDeserialization(type, unknownCaseName + type.name + "(json)", indentation);
-}
+    writer.indent(1) << "switch (" << subject << ".size()) {\n";
 
-std::string generateUnion(Type const & type, size_t indentation) {
-    std::string generated;
+    for (auto const & [size, indices] : indicesBySize) {
+        writer.indent(1) << "case " << std::to_string(size) << ":\n";
+        dispatch.generateCharacterSwitch(indices, 2);
+        writer.indent(2) << "break;\n";
+    }
 
-    auto const unknownTypeName = unknownCaseName + type.name;
-    generated += indent(indentation) + "using " + unknownTypeName + " = monostate;\n";
-    generated += generateDescription(type.description, indentation);
-    generated += indent(indentation) + "using " + type.name + " = " + cppVariant(type.possibleTypes, unknownTypeName) +
-                 ";\n\n";
-    return generated;
+    writer.indent(1) << "}\n";
 }
 
-std::string generateUnionDeserialization(Type const & type, size_t indentation) {
-    return generateVariantDeserialization(type, unknownCaseName + type.name + "()", indentation);
+std::string generateStringDispatch(
+        std::string_view subject,
+        std::vector<std::string_view> const & names,
+        DispatchMatch const & generateMatch,
+        size_t indentation) {
+    CodeWriter writer{indentation};
+    generateStringDispatch(writer, subject, names, generateMatch);
+    return writer.take();
 }
 
-template <typename T>
-static std::string generateField(T const & field, size_t indentation) {
-    std::string generated;
-    generated += generateDescription(field.description, indentation);
-    generated += indent(indentation) + cppTypeName(field.type) + " " + field.name + ";\n";
-    return generated;
+static std::vector<std::string_view> possibleTypeNames(Type const & type) {
+    std::vector<std::string_view> names;
+    names.reserve(type.possibleTypes.size());
+    for (auto const & possibleType : type.possibleTypes) {
+        names.push_back(possibleType.name().str());
+    }
+    return names;
 }
 
-std::string generateObject(Type const & type, size_t indentation) {
-    std::string generated;
+void generateVariantDeserialization(
+        CodeWriter & writer, Type const & type, std::string_view constructUnknown, FunctionPart part) {
+    if (part == FunctionPart::Declaration) {
+        generateDeserializationFunctionPrototype(writer, type.name.str());
+        return;
+    }
 
-    generated += generateDescription(type.description, indentation);
-    generated += indent(indentation) + "struct " + type.name + " {\n";
+    generateDeserializationFunctionDeclaration(writer, type.name.str(), part);
 
-    auto const fieldIndentation = indentation + 1;
+    writer.indent(1) << "auto const & occupiedType = json.at(\"__typename\").get_ref<std::string const &>();\n";
 
-    for (auto const & field : type.fields) {
-        generated += generateField(field, fieldIndentation);
-    }
+    auto const names = possibleTypeNames(type);
+    generateStringDispatch(writer, "occupiedType", names, [&](size_t index) {
+        return "value = {" + std::string{names[index]} + "(json)};";
+    });
 
-    generated += indent(indentation) + "};\n\n";
+    writer.indent(1) << "value = {" << constructUnknown << "};\n";
 
-    return generated;
+    writer.indent() << "}\n\n";
 }
 
-std::string generateObjectDeserialization(Type const & type, size_t indentation) {
-    std::string generated;
+std::string generateVariantDeserialization(
+        Type const & type, std::string const & constructUnknown, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateVariantDeserialization(writer, type, constructUnknown);
+    return writer.take();
+}
 
-    generated += generateDeserializationFunctionDeclaration(type.name, indentation);
+void generateInterface(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes) {
+    auto const unknownTypeName = unknownCaseName + type.name.str();
 
+    writer.indent() << "struct " << unknownTypeName << " {\n";
     for (auto const & field : type.fields) {
-        generated += generateFieldDeserialization(field, indentation + 1);
+        writer.indent(1) << cppMemberTypeName(field.type, boxedTypes) << ' ' << field.name.str() << ";\n";
     }
+    writer.indent() << "};\n\n";
 
-    generated += indent(indentation) + "}\n\n";
-
-    return generated;
-}
-
-std::string generateInputObject(Type const & type, size_t indentation) {
-    std::string generated;
+    generateDescription(writer, type.description);
+    writer.indent() << "struct " << type.name.str() << " {\n";
 
-    generated += generateDescription(type.description, indentation);
-    generated += indent(indentation) + "struct " + type.name + " {\n";
+    cppVariant(writer.indent(1), type.possibleTypes, unknownTypeName);
+    writer << " implementation;\n\n";
 
-    auto const fieldIndentation = indentation + 1;
+    writer.increaseIndentation();
 
-    for (auto const & field : type.inputFields) {
-        generated += generateField(field, fieldIndentation);
+    for (auto const & field : type.fields) {
+        auto const typeName = cppMemberTypeName(field.type, boxedTypes);
+        auto const & name = field.name.str();
+
+        generateDescription(writer, field.description);
+        writer.indent() << typeName << " const & " << name << "() const {\n";
+        writer.indent(1) << "return visit([](auto const & implementation) -> " << typeName << " const & {\n";
+        writer.indent(2) << "return implementation." << name << ";\n";
+        writer.indent(1) << "}, implementation);\n";
+        writer.indent() << "}\n\n";
     }
 
-    generated += indent(indentation) + "};\n\n";
+    writer.decreaseIndentation();
 
-    return generated;
+    writer.indent() << "};\n\n";
 }
 
-template <typename FieldType>
-static std::string generateFieldSerialization(
-        FieldType const & field, const std::string & fieldPrefix, const std::string & jsonName, size_t indentation) {
-    return indent(indentation) + jsonName + "[\"" + field.name + "\"] = " + fieldPrefix + field.name + ";\n";
+std::string generateInterface(Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateInterface(writer, type, boxedTypes);
+    return writer.take();
 }
 
-std::string generateInputObjectSerialization(Type const & type, size_t indentation) {
-    std::string generated;
+void generateInterfaceUnknownCaseDeserialization(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part == FunctionPart::Declaration) {
+        generateDeserializationFunctionPrototype(writer, unknownCaseName + type.name.str());
+        return;
+    }
 
-    generated += indent(indentation) + "inline void to_json(" + cppJsonTypeName + " & json, " + type.name +
-                 " const & value) {\n";
+    generateDeserializationFunctionDeclaration(writer, unknownCaseName + type.name.str(), part);
 
-    for (auto const & field : type.inputFields) {
-        generated += generateFieldSerialization(field, "value.", "json", indentation + 1);
+    writer.increaseIndentation();
+    for (auto const & field : type.fields) {
+        generateFieldDeserialization(writer, field, boxedTypes);
     }
+    writer.decreaseIndentation();
 
-    generated += indent(indentation) + "}\n\n";
-
-    return generated;
+    writer.indent() << "}\n\n";
 }
 
-std::string operationQueryName(Operation operation) {
-    switch (operation) {
-    case Operation::Query:
-        return "query";
-    case Operation::Mutation:
-        return "mutation";
-    case Operation::Subscription:
-        return "subscription";
-    }
+std::string generateInterfaceUnknownCaseDeserialization(
+        Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateInterfaceUnknownCaseDeserialization(writer, type, boxedTypes);
+    return writer.take();
+}
 
-    throw std::invalid_argument{"Invalid Operation value: " + std::to_string(static_cast<int>(operation))};
+void generateInterfaceDeserialization(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    generateInterfaceUnknownCaseDeserialization(writer, type, boxedTypes, part);
+    generateVariantDeserialization(writer, type, unknownCaseName + type.name.str() + "(json)", part);
 }
 
-std::string appendNameToVariablePrefix(std::string const & variablePrefix, std::string const & name) {
-    return variablePrefix.empty() ? uncapitalize(name) : variablePrefix + capitalize(name);
+std::string generateInterfaceDeserialization(Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateInterfaceDeserialization(writer, type, boxedTypes);
+    return writer.take();
 }
 
-std::string generateQueryField(
-        Field const & field,
-        TypeMap const & typeMap,
-        std::string const & variablePrefix,
-        std::vector<QueryVariable> & variables,
-        size_t indentation) {
-    std::string generated;
+void generateUnion(CodeWriter & writer, Type const & type) {
+    auto const unknownTypeName = unknownCaseName + type.name.str();
 
-    generated += indent(indentation) + field.name;
+    writer.indent() << "using " << unknownTypeName << " = monostate;\n";
+    generateDescription(writer, type.description);
+    writer.indent() << "using " << type.name.str() << " = ";
+    cppVariant(writer, type.possibleTypes, unknownTypeName);
+    writer << ";\n\n";
+}
 
-    if (!field.args.empty()) {
-        generated += "(\n";
-        for (auto const & arg : field.args) {
-            auto variableName = appendNameToVariablePrefix(variablePrefix, arg.name);
-            generated += indent(indentation + 1) + arg.name + ": $" + variableName + "\n";
-            variables.push_back({variableName, arg.type});
+std::string generateUnion(Type const & type, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateUnion(writer, type);
+    return writer.take();
+}
+
+void generateUnionDeserialization(CodeWriter & writer, Type const & type, FunctionPart part) {
+    generateVariantDeserialization(writer, type, unknownCaseName + type.name.str() + "()", part);
+}
+
+std::string generateUnionDeserialization(Type const & type, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateUnionDeserialization(writer, type);
+    return writer.take();
+}
+
+template <typename T>
+static void generateField(CodeWriter & writer, T const & field, BoxedTypes const & boxedTypes) {
+    generateDescription(writer, field.description);
+    writer.indent() << cppMemberTypeName(field.type, boxedTypes) << ' ' << field.name.str() << ";\n";
+}
+
+template <typename T>
+static void generateStruct(
+        CodeWriter & writer, Type const & type, std::vector<T> const & fields, BoxedTypes const & boxedTypes) {
+    generateDescription(writer, type.description);
+    writer.indent() << "struct " << type.name.str() << " {\n";
+
+    writer.increaseIndentation();
+    for (auto const & field : fields) {
+        generateField(writer, field, boxedTypes);
+    }
+    writer.decreaseIndentation();
+
+    writer.indent() << "};\n\n";
+}
+
+void generateObject(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes) {
+    generateStruct(writer, type, type.fields, boxedTypes);
+}
+
+std::string generateObject(Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateObject(writer, type, boxedTypes);
+    return writer.take();
+}
+
+void generateObjectDeserialization(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part == FunctionPart::Declaration) {
+        generateDeserializationFunctionPrototype(writer, type.name.str());
+        return;
+    }
+
+    // Objects that limitSelectionDepth leaves without fields only select __typename, so there is nothing to read.
+    if (type.fields.empty()) {
+        writer.indent();
+        if (part == FunctionPart::InlineDefinition) {
+            writer << "inline ";
+        }
+        writer << "void from_json(" << cppJsonTypeName << " const &, " << type.name.str() << " &) {}\n\n";
+        return;
+    }
+
+    generateDeserializationFunctionDeclaration(writer, type.name.str(), part);
+
+    writer.increaseIndentation();
+    for (auto const & field : type.fields) {
+        generateFieldDeserialization(writer, field, boxedTypes);
+    }
+    writer.decreaseIndentation();
+
+    writer.indent() << "}\n\n";
+}
+
+std::string generateObjectDeserialization(Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateObjectDeserialization(writer, type, boxedTypes);
+    return writer.take();
+}
+
+void generateInputObject(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes) {
+    generateStruct(writer, type, type.inputFields, boxedTypes);
+}
+
+std::string generateInputObject(Type const & type, size_t indentation, BoxedTypes const & boxedTypes) {
+    CodeWriter writer{indentation};
+    generateInputObject(writer, type, boxedTypes);
+    return writer.take();
+}
+
+// Key of a field in the json object that it is serialized into.
+static std::string const & serializedName(InputValue const & field) {
+    return field.name.str();
+}
+
+static std::string const & serializedName(QueryVariable const & variable) {
+    return variable.queryName();
+}
+
+template <typename FieldType>
+static void generateFieldSerialization(
+        CodeWriter & writer, FieldType const & field, std::string_view fieldPrefix, std::string_view jsonName) {
+    writer.indent() << jsonName << "[\"" << serializedName(field) << "\"] = " << fieldPrefix << field.name.str()
+                    << ";\n";
+}
+
+static void writeJsonWriterFunctionSignature(CodeWriter & writer, std::string_view typeName, FunctionPart part) {
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
+    }
+    writer << "void write_json(JsonWriter & writer, " << typeName << " const & value)";
+}
+
+// Writes the members of a json object, whose keys are written along with the punctuation around them in one append.
+template <typename FieldType>
+static void generateJsonObjectWriting(
+        CodeWriter & writer, std::vector<FieldType> const & fields, std::string_view fieldPrefix) {
+    if (fields.empty()) {
+        writer.indent(1) << "writer.append(\"{}\");\n";
+        return;
+    }
+
+    auto separator = "{";
+    for (auto const & field : fields) {
+        writer.indent(1) << "writer.append(\"" << separator << "\\\"" << serializedName(field) << "\\\":\");\n";
+        writer.indent(1) << "write_json(writer, " << fieldPrefix << field.name.str() << ");\n";
+        separator = ",";
+    }
+    writer.indent(1) << "writer.append('}');\n";
+}
+
+void generateInputObjectSerialization(CodeWriter & writer, Type const & type, FunctionPart part) {
+    writeSerializationFunctionSignature(writer.indent(), type.name.str(), part);
+    if (part == FunctionPart::Declaration) {
+        writer << ";\n";
+        writeJsonWriterFunctionSignature(writer.indent(), type.name.str(), part);
+        writer << ";\n\n";
+        return;
+    }
+    writer << " {\n";
+
+    writer.increaseIndentation();
+    for (auto const & field : type.inputFields) {
+        generateFieldSerialization(writer, field, "value.", "json");
+    }
+    writer.decreaseIndentation();
+
+    writer.indent() << "}\n\n";
+
+    writeJsonWriterFunctionSignature(writer.indent(), type.name.str(), part);
+    writer << " {\n";
+    generateJsonObjectWriting(writer, type.inputFields, "value.");
+    writer.indent() << "}\n\n";
+}
+
+std::string generateInputObjectSerialization(Type const & type, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateInputObjectSerialization(writer, type);
+    return writer.take();
+}
+
+static void replaceAll(std::string & text, std::string const & from, std::string const & to) {
+    for (auto position = text.find(from); position != std::string::npos; position = text.find(from, position)) {
+        text.replace(position, from.size(), to);
+        position += to.size();
+    }
+}
+
+// Indents each nonempty line of `code`, and substitutes the names of the json and boxed optional types.
+static void generateSupportCode(CodeWriter & writer, char const * code) {
+    for (auto line = code; *line != '\0';) {
+        auto const lineEnd = std::strchr(line, '\n') + 1;
+        std::string text{line, lineEnd};
+        if (text != "\n") {
+            writer.indent();
+        }
+        replaceAll(text, "$BoxedOptional", cppBoxedOptionalTypeName);
+        replaceAll(text, "$Json", cppJsonTypeName);
+        writer << text;
+        line = lineEnd;
+    }
+}
+
+void generateBoxedOptional(CodeWriter & writer, FunctionPart part) {
+    auto const box = R"(// Nullable box for members whose types are recursive. Values are allocated from per type pools of fixed size
+// blocks, so deserializing deeply recursive responses doesn't allocate once per node. Each thread keeps a few freed
+// slots for itself, and gives the rest back to a shared free list, as it does with all of them when it exits. Boxes can
+// move between threads, and pools only grow with the number of values alive at once.
+template <typename T>
+class $BoxedOptional {
+public:
+    $BoxedOptional() = default;
+
+    $BoxedOptional(T value) : value{construct(std::move(value))} {}
+
+    $BoxedOptional($BoxedOptional const & other) : value{other ? construct(*other) : nullptr} {}
+
+    $BoxedOptional($BoxedOptional && other) noexcept : value{other.value} { other.value = nullptr; }
+
+    $BoxedOptional & operator=($BoxedOptional other) noexcept {
+        std::swap(value, other.value);
+        return *this;
+    }
+
+    ~$BoxedOptional() { reset(); }
+
+    void reset() {
+        if (value) {
+            value->~T();
+            release(value);
+            value = nullptr;
+        }
+    }
+
+    bool has_value() const { return value != nullptr; }
+
+    explicit operator bool() const { return has_value(); }
+
+    T & operator*() { return *value; }
+
+    T const & operator*() const { return *value; }
+
+    T * operator->() { return value; }
+
+    T const * operator->() const { return value; }
+
+private:
+    union Slot {
+        Slot * next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static constexpr size_t slotsPerBlock = 64;
+
+    // Threads give freed slots beyond this back to the shared free list.
+    static constexpr size_t maximumThreadSlots = 2 * slotsPerBlock;
+
+    struct SharedSlots {
+        std::mutex mutex;
+        Slot * slots = nullptr;
+    };
+
+    struct ThreadSlots {
+        Slot * slots;
+        size_t count;
+        bool exited;
+    };
+
+    struct ThreadExit {
+        ~ThreadExit() {
+            auto & local = threadSlots();
+            local.exited = true;
+            giveSlots(local, local.count);
+        }
+    };
+
+    T * value = nullptr;
+
+    // Never destroyed, so boxes with static storage duration can still release into it.
+    static SharedSlots & sharedSlots() {
+        static auto slots = new SharedSlots;
+        return *slots;
+    }
+
+    // Trivially destructible, so boxes destroyed after the thread's ThreadExit can still release into it.
+    static ThreadSlots & threadSlots() {
+        thread_local ThreadSlots slots{};
+        thread_local ThreadExit threadExit;
+        return slots;
+    }
+
+    // Moves the first count of the thread's free slots to the shared free list.
+    static void giveSlots(ThreadSlots & local, size_t count) {
+        if (count == 0) {
+            return;
+        }
+
+        auto first = local.slots;
+        auto last = first;
+        for (size_t i = 1; i < count; ++i) {
+            last = last->next;
+        }
+        local.slots = last->next;
+        local.count -= count;
+
+        auto & shared = sharedSlots();
+        std::lock_guard<std::mutex> lock{shared.mutex};
+        last->next = shared.slots;
+        shared.slots = first;
+    }
+
+    // Takes up to a block of slots from the shared free list, and allocates a new block only when it is empty.
+    static void takeSlots(ThreadSlots & local) {
+        {
+            auto & shared = sharedSlots();
+            std::lock_guard<std::mutex> lock{shared.mutex};
+            while (shared.slots && local.count < slotsPerBlock) {
+                auto slot = shared.slots;
+                shared.slots = slot->next;
+                slot->next = local.slots;
+                local.slots = slot;
+                ++local.count;
+            }
+        }
+
+        if (!local.slots) {
+            auto block = new Slot[slotsPerBlock];
+            for (size_t i = 0; i < slotsPerBlock; ++i) {
+                block[i].next = local.slots;
+                local.slots = &block[i];
+            }
+            local.count = slotsPerBlock;
+        }
+    }
+
+    template <typename... Args>
+    static T * construct(Args &&... args) {
+        auto & local = threadSlots();
+        if (!local.slots) {
+            takeSlots(local);
+        }
+
+        auto slot = local.slots;
+        local.slots = slot->next;
+        --local.count;
+        try {
+            return new (slot->storage) T(std::forward<Args>(args)...);
+        } catch (...) {
+            release(slot->storage);
+            throw;
+        }
+    }
+
+    static void release(void * storage) {
+        auto slot = static_cast<Slot *>(storage);
+        auto & local = threadSlots();
+        slot->next = local.slots;
+        local.slots = slot;
+        ++local.count;
+
+        if (local.exited) {
+            giveSlots(local, local.count);
+        } else if (local.count > maximumThreadSlots) {
+            giveSlots(local, local.count - slotsPerBlock);
+        }
+    }
+};
+
+)";
+
+    auto const serialization = R"(template <typename T>
+void to_json($Json & json, $BoxedOptional<T> const & box) {
+    if (box) {
+        json = *box;
+    } else {
+        json = nullptr;
+    }
+}
+
+// Deserializes in place, reusing the box's value if it has one.
+template <typename T>
+void from_json($Json const & json, $BoxedOptional<T> & box) {
+    if (json.is_null()) {
+        box.reset();
+    } else {
+        if (!box) {
+            box = T{};
+        }
+        json.get_to(*box);
+    }
+}
+
+)";
+
+    if (part != FunctionPart::Definition) {
+        generateSupportCode(writer, box);
+    }
+    if (part != FunctionPart::Declaration) {
+        generateSupportCode(writer, serialization);
+    }
+}
+
+std::string generateBoxedOptional(size_t indentation) {
+    CodeWriter writer{indentation};
+    generateBoxedOptional(writer);
+    return writer.take();
+}
+
+void generateJsonWriter(CodeWriter & writer, BoxedTypes const & boxedTypes, FunctionPart part) {
+    auto const jsonWriter = R"(// Writes json text straight into a string, such as a buffer reused between requests,
+// without building json values. Each value is written by the write_json function of its type.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string & buffer) : buffer(buffer) {}
+
+    void append(string_view text) { buffer.append(text.data(), text.size()); }
+
+    void append(char character) { buffer.push_back(character); }
+
+    void writeString(string_view text);
+
+    void writeInteger(long long value);
+
+    // Writes the shortest of 15 or 17 significant digits that reads back as the same value, and null for values that
+    // json can't represent, as nlohmann::json does.
+    void writeNumber(double value);
+
+private:
+    std::string & buffer;
+};
+
+)";
+
+    auto const declarations = R"(void write_json(JsonWriter & writer, std::string const & value);
+void write_json(JsonWriter & writer, bool value);
+void write_json(JsonWriter & writer, int32_t value);
+void write_json(JsonWriter & writer, double value);
+
+)";
+
+    std::string functions = R"($inlinevoid JsonWriter::writeString(string_view text) {
+    buffer.push_back('"');
+
+    // Runs of characters that don't need escaping are appended at once.
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        auto const character = static_cast<unsigned char>(text[i]);
+        if (character >= 0x20 && character != '"' && character != '\\') {
+            continue;
+        }
+
+        buffer.append(text.data() + runStart, i - runStart);
+        runStart = i + 1;
+
+        switch (character) {
+        case '"':
+            buffer += "\\\"";
+            break;
+        case '\\':
+            buffer += "\\\\";
+            break;
+        case '\b':
+            buffer += "\\b";
+            break;
+        case '\f':
+            buffer += "\\f";
+            break;
+        case '\n':
+            buffer += "\\n";
+            break;
+        case '\r':
+            buffer += "\\r";
+            break;
+        case '\t':
+            buffer += "\\t";
+            break;
+        default:
+            buffer += "\\u00";
+            buffer.push_back("0123456789abcdef"[character >> 4]);
+            buffer.push_back("0123456789abcdef"[character & 0xf]);
+            break;
+        }
+    }
+
+    buffer.append(text.data() + runStart, text.size() - runStart);
+    buffer.push_back('"');
+}
+
+$inlinevoid JsonWriter::writeInteger(long long value) {
+    char digits[24];
+    auto const length = std::snprintf(digits, sizeof(digits), "%lld", value);
+    buffer.append(digits, static_cast<size_t>(length));
+}
+
+$inlinevoid JsonWriter::writeNumber(double value) {
+    if (!std::isfinite(value)) {
+        buffer += "null";
+        return;
+    }
+
+    char digits[32];
+    auto length = std::snprintf(digits, sizeof(digits), "%.15g", value);
+    if (std::strtod(digits, nullptr) != value) {
+        length = std::snprintf(digits, sizeof(digits), "%.17g", value);
+    }
+
+    // The decimal point of the C locale, whichever locale is set.
+    for (auto character = digits; character != digits + length; ++character) {
+        if (*character == ',') {
+            *character = '.';
+        }
+    }
+    buffer.append(digits, static_cast<size_t>(length));
+}
+
+$inlinevoid write_json(JsonWriter & writer, std::string const & value) { writer.writeString(value); }
+
+$inlinevoid write_json(JsonWriter & writer, bool value) { writer.append(value ? "true" : "false"); }
+
+$inlinevoid write_json(JsonWriter & writer, int32_t value) { writer.writeInteger(value); }
+
+$inlinevoid write_json(JsonWriter & writer, double value) { writer.writeNumber(value); }
+
+)";
+
+    auto const templateDeclarations = R"(// Enums are written as their to_string_view names, and Unknown as null.
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+void write_json(JsonWriter & writer, T value) {
+    auto const name = to_string_view(value);
+    if (name.empty()) {
+        writer.append("null");
+    } else {
+        writer.writeString(name);
+    }
+}
+
+template <typename T>
+void write_json(JsonWriter & writer, optional<T> const & value);
+
+template <typename T>
+void write_json(JsonWriter & writer, std::vector<T> const & values);
+
+)";
+
+    auto const boxedOptionalDeclaration = R"(template <typename T>
+void write_json(JsonWriter & writer, $BoxedOptional<T> const & box);
+
+)";
+
+    auto const templateDefinitions = R"(template <typename T>
+void write_json(JsonWriter & writer, optional<T> const & value) {
+    if (value) {
+        write_json(writer, *value);
+    } else {
+        writer.append("null");
+    }
+}
+
+template <typename T>
+void write_json(JsonWriter & writer, std::vector<T> const & values) {
+    writer.append('[');
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i != 0) {
+            writer.append(',');
+        }
+        write_json(writer, values[i]);
+    }
+    writer.append(']');
+}
+
+)";
+
+    auto const boxedOptionalDefinition = R"(template <typename T>
+void write_json(JsonWriter & writer, $BoxedOptional<T> const & box) {
+    if (box) {
+        write_json(writer, *box);
+    } else {
+        writer.append("null");
+    }
+}
+
+)";
+
+    if (part != FunctionPart::Definition) {
+        generateSupportCode(writer, jsonWriter);
+    }
+
+    if (part == FunctionPart::Declaration) {
+        generateSupportCode(writer, declarations);
+    } else {
+        replaceAll(functions, "$inline", part == FunctionPart::InlineDefinition ? "inline " : "");
+        generateSupportCode(writer, functions.c_str());
+    }
+
+    if (part == FunctionPart::Definition) {
+        return;
+    }
+
+    generateSupportCode(writer, templateDeclarations);
+    if (!boxedTypes.empty()) {
+        generateSupportCode(writer, boxedOptionalDeclaration);
+    }
+    generateSupportCode(writer, templateDefinitions);
+    if (!boxedTypes.empty()) {
+        generateSupportCode(writer, boxedOptionalDefinition);
+    }
+}
+
+void generateRecursiveComponent(
+        CodeWriter & writer,
+        TypeComponent const & component,
+        TypeMap const & typeMap,
+        BoxedTypes const & boxedTypes,
+        FunctionPart part) {
+    auto forEachType = [&](std::initializer_list<TypeKind> kinds, auto && body) {
+        for (auto const index : component.types) {
+            auto const & type = typeMap.at(index);
+            if (std::find(kinds.begin(), kinds.end(), type.kind) != kinds.end()) {
+                body(type);
+            }
+        }
+    };
+
+    if (part != FunctionPart::Definition) {
+        forEachType({TypeKind::Object, TypeKind::Interface, TypeKind::InputObject}, [&](Type const & type) {
+            writer.indent() << "struct " << type.name.str() << ";\n";
+        });
+        writer << '\n';
+
+        // Union variants only name their possible types, so they can be declared before any of them are defined.
+        forEachType({TypeKind::Union}, [&](Type const & type) { generateUnion(writer, type); });
+
+        forEachType({TypeKind::Object}, [&](Type const & type) { generateObject(writer, type, boxedTypes); });
+        forEachType({TypeKind::InputObject}, [&](Type const & type) { generateInputObject(writer, type, boxedTypes); });
+        forEachType({TypeKind::Interface}, [&](Type const & type) { generateInterface(writer, type, boxedTypes); });
+
+        // Declared for every part, so that a header with functions defined out of line only needs these.
+        forEachType({TypeKind::Object, TypeKind::Interface, TypeKind::Union}, [&](Type const & type) {
+            writeDeserializationFunctionSignature(writer.indent(), type.name.str(), part);
+            writer << ";\n";
+        });
+        forEachType({TypeKind::InputObject}, [&](Type const & type) {
+            writeSerializationFunctionSignature(writer.indent(), type.name.str(), part);
+            writer << ";\n";
+            writeJsonWriterFunctionSignature(writer.indent(), type.name.str(), part);
+            writer << ";\n";
+        });
+        writer << '\n';
+
+        if (part == FunctionPart::Declaration) {
+            return;
+        }
+    }
+
+    auto const definedKinds = {TypeKind::Object, TypeKind::Interface, TypeKind::Union, TypeKind::InputObject};
+    forEachType(definedKinds, [&](Type const & type) {
+        switch (type.kind) {
+        case TypeKind::Object:
+            generateObjectDeserialization(writer, type, boxedTypes, part);
+            break;
+        case TypeKind::Interface:
+            generateInterfaceDeserialization(writer, type, boxedTypes, part);
+            break;
+        case TypeKind::Union:
+            generateUnionDeserialization(writer, type, part);
+            break;
+        default:
+            generateInputObjectSerialization(writer, type, part);
+            break;
+        }
+    });
+}
+
+std::string generateRecursiveComponent(
+        TypeComponent const & component, TypeMap const & typeMap, BoxedTypes const & boxedTypes, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateRecursiveComponent(writer, component, typeMap, boxedTypes);
+    return writer.take();
+}
+
+void generateSaxDecoder(CodeWriter & writer, BoxedTypes const & boxedTypes) {
+    auto const decoder = R"(// Decodes responses from json SAX events, without building json values. Each value is
+// decoded by the saxDecode function of its type, which the events of the value are sent to. A container pushes a
+// frame to receive its keys, elements and end, and expects the value following a key or element to be decoded into a
+// member.
+struct SaxEvent {
+    enum Kind {
+        Null,
+        Boolean,
+        Integer,
+        Unsigned,
+        Float,
+        String,
+        StartObject,
+        StartArray,
+        Key,
+        Element,
+        EndObject,
+        EndArray
+    };
+
+    Kind kind;
+    bool boolean = false;
+    int64_t integer = 0;
+    uint64_t unsignedInteger = 0;
+    double number = 0;
+    // The string or key, which decoding may move from.
+    std::string * string = nullptr;
+};
+
+class SaxDecoder;
+
+using SaxHandler = void (*)(SaxDecoder & decoder, void * value, SaxEvent & event);
+
+template <typename T>
+void saxDecodeValue(SaxDecoder & decoder, void * value, SaxEvent & event);
+
+template <typename T>
+void saxDecodeTypename(SaxDecoder & decoder, void * value, SaxEvent & event);
+
+void saxSkip(SaxDecoder & decoder, void * value, SaxEvent & event);
+void saxCapture(SaxDecoder & decoder, void * value, SaxEvent & event);
+
+// An object being captured into a json value, when a variant's __typename isn't its first key.
+struct SaxCapture {
+    $Json json;
+    std::vector<$Json *> containers;
+    std::string key;
+    void * target = nullptr;
+    void (*finish)($Json const & json, void * target) = nullptr;
+};
+
+template <typename T>
+void saxFinishCapture($Json const & json, void * target) {
+    json.get_to(*static_cast<T *>(target));
+}
+
+class SaxDecoder {
+public:
+    // Decodes the next value into `value`.
+    template <typename T>
+    void expect(T & value) {
+        expect(&value, &saxDecodeValue<T>);
+    }
+
+    void expect(void * value, SaxHandler handler) { pending = {value, handler, 0}; }
+
+    // Decodes the next value into the member at `index` of those that the object being decoded requires.
+    template <typename T>
+    void expectRequired(T & value, size_t index) {
+        auto const offset = frames.back().state;
+        auto & seen = requiredMembers[offset + 1 + index / 64];
+        auto const bit = uint64_t{1} << index % 64;
+        if (!(seen & bit)) {
+            seen |= bit;
+            --requiredMembers[offset];
+        }
+        expect(value);
+    }
+
+    // Skips the next value.
+    void skip() { expect(nullptr, &saxSkip); }
+
+    void push(void * value, SaxHandler handler, size_t state = 0) { frames.push_back({value, handler, state}); }
+
+    void pop() { frames.pop_back(); }
+
+    // Decodes `value` from an object whose start has already been read.
+    template <typename T>
+    void startObject(T & value) {
+        SaxEvent event{SaxEvent::StartObject};
+        saxDecodeValue<T>(*this, &value, event);
+    }
+
+    // Handles the events of an object other than its keys, counting down the required members it has left.
+    template <typename T>
+    void decodeObject(T & value, SaxEvent & event, size_t requiredCount) {
+        switch (event.kind) {
+        case SaxEvent::StartObject:
+            push(&value, &saxDecodeValue<T>, requiredMembers.size());
+            requiredMembers.push_back(requiredCount);
+            requiredMembers.resize(requiredMembers.size() + (requiredCount + 63) / 64);
+            break;
+        case SaxEvent::EndObject: {
+            auto const offset = frames.back().state;
+            if (requiredMembers[offset] != 0) {
+                throw $Json::out_of_range::create(403, "required key not found");
+            }
+            requiredMembers.resize(offset);
+            pop();
+            break;
+        }
+        default:
+            unexpected(event, "object");
+        }
+    }
+
+    // Decodes a variant from an object that names its possible type with __typename. Generated queries select it
+    // first, and objects where it comes later are captured and deserialized from json instead.
+    template <typename T>
+    void decodeVariant(T & value, SaxEvent & event) {
+        switch (event.kind) {
+        case SaxEvent::StartObject:
+            push(&value, &saxDecodeValue<T>);
+            break;
+        case SaxEvent::Key:
+            pop();
+            if (*event.string == "__typename") {
+                expect(&value, &saxDecodeTypename<T>);
+            } else {
+                capture(value, *event.string);
+            }
+            break;
+        case SaxEvent::EndObject:
+            throw $Json::out_of_range::create(403, "key '__typename' not found");
+        default:
+            unexpected(event, "object");
+        }
+    }
+
+    template <typename T>
+    void capture(T & value, std::string & firstKey) {
+        captured.json = $Json::object();
+        captured.containers.assign(1, &captured.json);
+        captured.key = std::move(firstKey);
+        captured.target = &value;
+        captured.finish = &saxFinishCapture<T>;
+        push(&captured, &saxCapture);
+        expect(&captured, &saxCapture);
+    }
+
+    [[noreturn]] static void unexpected(SaxEvent const & event, char const * expected) {
+        static char const * const names[] = {"null", "boolean", "number", "number", "number", "string", "object",
+                                             "array", "key", "element", "end of object", "end of array"};
+        throw $Json::type_error::create(302, std::string("type must be ") + expected + ", but is " + names[event.kind]);
+    }
+
+    // The json SAX interface.
+    bool null() { return decodeValue({SaxEvent::Null}); }
+
+    bool boolean(bool value) {
+        SaxEvent event{SaxEvent::Boolean};
+        event.boolean = value;
+        return decodeValue(event);
+    }
+
+    bool number_integer($Json::number_integer_t value) {
+        SaxEvent event{SaxEvent::Integer};
+        event.integer = value;
+        return decodeValue(event);
+    }
+
+    bool number_unsigned($Json::number_unsigned_t value) {
+        SaxEvent event{SaxEvent::Unsigned};
+        event.unsignedInteger = value;
+        return decodeValue(event);
+    }
+
+    bool number_float($Json::number_float_t value, std::string const &) {
+        SaxEvent event{SaxEvent::Float};
+        event.number = value;
+        return decodeValue(event);
+    }
+
+    bool string(std::string & value) {
+        SaxEvent event{SaxEvent::String};
+        event.string = &value;
+        return decodeValue(event);
+    }
+
+    bool start_object(size_t) { return decodeValue({SaxEvent::StartObject}); }
+
+    bool key(std::string & value) {
+        SaxEvent event{SaxEvent::Key};
+        event.string = &value;
+        return decodeContainer(event);
+    }
+
+    bool end_object() { return decodeContainer({SaxEvent::EndObject}); }
+
+    bool start_array(size_t) { return decodeValue({SaxEvent::StartArray}); }
+
+    bool end_array() { return decodeContainer({SaxEvent::EndArray}); }
+
+    bool parse_error(size_t, std::string const &, $Json::exception const & error) {
+        throw static_cast<$Json::parse_error const &>(error);
+    }
+
+private:
+    struct Frame {
+        void * value;
+        SaxHandler handler;
+        // Handlers' own state, such as where an object's required members are in requiredMembers.
+        size_t state;
+    };
+
+    std::vector<Frame> frames;
+    // For each object being decoded, the number of required members it has left, followed by a bit per required
+    // member that is set once it has been read, so that repeated keys are only counted once.
+    std::vector<uint64_t> requiredMembers;
+    Frame pending = {nullptr, nullptr, 0};
+    SaxCapture captured;
+
+    // Values are either expected after a key, or are elements of the array on top.
+    bool decodeValue(SaxEvent event) {
+        if (!pending.handler) {
+            SaxEvent element{SaxEvent::Element};
+            decodeContainer(element);
+        }
+        auto const target = pending;
+        pending.handler = nullptr;
+        target.handler(*this, target.value, event);
+        return true;
+    }
+
+    bool decodeContainer(SaxEvent event) {
+        auto const frame = frames.back();
+        frame.handler(*this, frame.value, event);
+        return true;
+    }
+};
+
+inline void saxSkip(SaxDecoder & decoder, void *, SaxEvent & event) {
+    switch (event.kind) {
+    case SaxEvent::StartObject:
+    case SaxEvent::StartArray:
+        decoder.push(nullptr, &saxSkip);
+        break;
+    case SaxEvent::Key:
+    case SaxEvent::Element:
+        decoder.skip();
+        break;
+    case SaxEvent::EndObject:
+    case SaxEvent::EndArray:
+        decoder.pop();
+        break;
+    default:
+        break;
+    }
+}
+
+inline void saxCapture(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    auto & capture = *static_cast<SaxCapture *>(value);
+    auto & container = *capture.containers.back();
+    auto insert = [&]($Json element) -> $Json & {
+        if (container.is_object()) {
+            return container[capture.key] = std::move(element);
+        }
+        container.push_back(std::move(element));
+        return container.back();
+    };
+
+    switch (event.kind) {
+    case SaxEvent::Null:
+        insert(nullptr);
+        break;
+    case SaxEvent::Boolean:
+        insert(event.boolean);
+        break;
+    case SaxEvent::Integer:
+        insert(event.integer);
+        break;
+    case SaxEvent::Unsigned:
+        insert(event.unsignedInteger);
+        break;
+    case SaxEvent::Float:
+        insert(event.number);
+        break;
+    case SaxEvent::String:
+        insert(std::move(*event.string));
+        break;
+    case SaxEvent::StartObject:
+        capture.containers.push_back(&insert($Json::object()));
+        break;
+    case SaxEvent::StartArray:
+        capture.containers.push_back(&insert($Json::array()));
+        break;
+    case SaxEvent::Key:
+        capture.key = std::move(*event.string);
+        decoder.expect(value, &saxCapture);
+        break;
+    case SaxEvent::Element:
+        decoder.expect(value, &saxCapture);
+        break;
+    case SaxEvent::EndObject:
+    case SaxEvent::EndArray:
+        capture.containers.pop_back();
+        if (capture.containers.empty()) {
+            decoder.pop();
+            capture.finish(capture.json, capture.target);
+        }
+        break;
+    }
+}
+
+template <typename T>
+void saxDecodeTypename(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    if (event.kind != SaxEvent::String) {
+        decoder.unexpected(event, "string");
+    }
+    saxDecodeAlternative(decoder, *static_cast<T *>(value), *event.string);
+}
+
+inline void saxDecode(SaxDecoder & decoder, std::string & value, SaxEvent & event) {
+    if (event.kind != SaxEvent::String) {
+        decoder.unexpected(event, "string");
+    }
+    value = std::move(*event.string);
+}
+
+inline void saxDecode(SaxDecoder & decoder, bool & value, SaxEvent & event) {
+    if (event.kind != SaxEvent::Boolean) {
+        decoder.unexpected(event, "boolean");
+    }
+    value = event.boolean;
+}
+
+template <typename T>
+void saxDecodeNumber(SaxDecoder & decoder, T & value, SaxEvent & event) {
+    switch (event.kind) {
+    case SaxEvent::Integer:
+        value = static_cast<T>(event.integer);
+        break;
+    case SaxEvent::Unsigned:
+        value = static_cast<T>(event.unsignedInteger);
+        break;
+    case SaxEvent::Float:
+        value = static_cast<T>(event.number);
+        break;
+    default:
+        decoder.unexpected(event, "number");
+    }
+}
+
+inline void saxDecode(SaxDecoder & decoder, int32_t & value, SaxEvent & event) {
+    saxDecodeNumber(decoder, value, event);
+}
+
+inline void saxDecode(SaxDecoder & decoder, double & value, SaxEvent & event) {
+    saxDecodeNumber(decoder, value, event);
+}
+
+// The unknown case of unions.
+inline void saxDecode(SaxDecoder & decoder, monostate &, SaxEvent & event) { saxSkip(decoder, nullptr, event); }
+
+// Enums are decoded from strings by their generated from_string_view.
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+void saxDecode(SaxDecoder & decoder, T & value, SaxEvent & event) {
+    switch (event.kind) {
+    case SaxEvent::Null:
+        value = T::Unknown;
+        break;
+    case SaxEvent::String:
+        from_string_view(*event.string, value);
+        break;
+    default:
+        decoder.unexpected(event, "string");
+    }
+}
+
+template <typename T>
+void saxDecode(SaxDecoder & decoder, optional<T> & value, SaxEvent & event) {
+    if (event.kind == SaxEvent::Null) {
+        value.reset();
+        return;
+    }
+    if (!value) {
+        value.emplace();
+    }
+    saxDecodeValue<T>(decoder, &*value, event);
+}
+
+template <typename T>
+void saxDecode(SaxDecoder & decoder, std::vector<T> & value, SaxEvent & event) {
+    switch (event.kind) {
+    case SaxEvent::StartArray:
+        value.clear();
+        decoder.push(&value, &saxDecodeValue<std::vector<T>>);
+        break;
+    case SaxEvent::Element:
+        value.emplace_back();
+        decoder.expect(value.back());
+        break;
+    case SaxEvent::EndArray:
+        decoder.pop();
+        break;
+    default:
+        decoder.unexpected(event, "array");
+    }
+}
+
+inline void saxDecodeBooleanElement(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    bool element;
+    saxDecode(decoder, element, event);
+    static_cast<std::vector<bool> *>(value)->push_back(element);
+}
+
+// Elements of std::vector<bool> can't be referenced, so they're appended once decoded.
+inline void saxDecode(SaxDecoder & decoder, std::vector<bool> & value, SaxEvent & event) {
+    switch (event.kind) {
+    case SaxEvent::StartArray:
+        value.clear();
+        decoder.push(&value, &saxDecodeValue<std::vector<bool>>);
+        break;
+    case SaxEvent::Element:
+        decoder.expect(&value, &saxDecodeBooleanElement);
+        break;
+    case SaxEvent::EndArray:
+        decoder.pop();
+        break;
+    default:
+        decoder.unexpected(event, "array");
+    }
+}
+
+)";
+
+    auto const boxedOptional = R"(template <typename T>
+void saxDecode(SaxDecoder & decoder, $BoxedOptional<T> & box, SaxEvent & event) {
+    if (event.kind == SaxEvent::Null) {
+        box.reset();
+        return;
+    }
+    if (!box) {
+        box = T{};
+    }
+    saxDecodeValue<T>(decoder, &*box, event);
+}
+
+)";
+
+    auto const response = R"(template <typename T>
+void saxDecodeValue(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    saxDecode(decoder, *static_cast<T *>(value), event);
+}
+
+inline void saxDecode(SaxDecoder & decoder, GraphqlError & value, SaxEvent & event) {
+    if (event.kind != SaxEvent::Key) {
+        decoder.decodeObject(value, event, 1);
+    } else if (*event.string == "message") {
+        decoder.expectRequired(value.message, 0);
+    } else {
+        decoder.skip();
+    }
+}
+
+template <typename Data>
+struct SaxResponse {
+    char const * fieldName;
+    Data data;
+    optional<std::vector<GraphqlError>> errors;
+    bool hasDataObject = false;
+    bool hasData = false;
+};
+
+template <typename Data>
+void saxDecodeResponseData(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    auto & response = *static_cast<SaxResponse<Data> *>(value);
+    switch (event.kind) {
+    case SaxEvent::Null:
+        response.hasDataObject = true;
+        break;
+    case SaxEvent::StartObject:
+        response.hasDataObject = true;
+        decoder.push(value, &saxDecodeResponseData<Data>);
+        break;
+    case SaxEvent::Key:
+        if (*event.string == response.fieldName) {
+            response.hasData = true;
+            decoder.expect(response.data);
+        } else {
+            decoder.skip();
+        }
+        break;
+    case SaxEvent::EndObject:
+        decoder.pop();
+        break;
+    default:
+        decoder.unexpected(event, "object");
+    }
+}
+
+template <typename Data>
+void saxDecodeResponse(SaxDecoder & decoder, void * value, SaxEvent & event) {
+    auto & response = *static_cast<SaxResponse<Data> *>(value);
+    switch (event.kind) {
+    case SaxEvent::StartObject:
+        decoder.push(value, &saxDecodeResponse<Data>);
+        break;
+    case SaxEvent::Key:
+        if (*event.string == "data") {
+            decoder.expect(value, &saxDecodeResponseData<Data>);
+        } else if (*event.string == "errors") {
+            decoder.expect(response.errors);
+        } else {
+            decoder.skip();
+        }
+        break;
+    case SaxEvent::EndObject:
+        decoder.pop();
+        break;
+    default:
+        decoder.unexpected(event, "object");
+    }
+}
+
+// Decodes the response to an operation on `fieldName` as its response function would from the parsed body.
+template <typename Data>
+GraphqlResponse<Data> decodeGraphqlResponse(char const * body, size_t size, char const * fieldName, bool isRequired) {
+    SaxResponse<Data> response{fieldName, Data{}, {}};
+    SaxDecoder decoder;
+    decoder.expect(&response, &saxDecodeResponse<Data>);
+    $Json::sax_parse({body, size}, &decoder);
+
+    if (response.errors) {
+        return std::move(*response.errors);
+    }
+    if (!response.hasDataObject) {
+        throw $Json::out_of_range::create(403, "key 'data' not found");
+    }
+    if (isRequired && !response.hasData) {
+        throw $Json::out_of_range::create(403, std::string("key '") + fieldName + "' not found");
+    }
+    return std::move(response.data);
+}
+
+)";
+
+    generateSupportCode(writer, decoder);
+    if (!boxedTypes.empty()) {
+        generateSupportCode(writer, boxedOptional);
+    }
+    generateSupportCode(writer, response);
+}
+
+static void writeSaxDecodeSignature(CodeWriter & writer, std::string_view typeName, FunctionPart part) {
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
+    }
+    writer << "void saxDecode(SaxDecoder & decoder, " << typeName << " & value, SaxEvent & event) {\n";
+}
+
+static void generateFieldsSaxDecoding(
+        CodeWriter & writer,
+        std::string_view typeName,
+        std::vector<Field> const & fields,
+        BoxedTypes const & boxedTypes,
+        FunctionPart part) {
+    auto const requiredFields = std::count_if(fields.begin(), fields.end(), [&](Field const & field) {
+        return isRequiredField(field, boxedTypes);
+    });
+
+    writeSaxDecodeSignature(writer.indent(), typeName, part);
+    writer.indent(1) << "if (event.kind != SaxEvent::Key) {\n";
+    writer.indent(2) << "decoder.decodeObject(value, event, " << std::to_string(requiredFields) << ");\n";
+
+    size_t requiredIndex = 0;
+    for (auto const & field : fields) {
+        auto const & name = field.name.str();
+        writer.indent(1) << "} else if (*event.string == \"" << name << "\") {\n";
+        if (isRequiredField(field, boxedTypes)) {
+            writer.indent(2) << "decoder.expectRequired(value." << name << ", ";
+            writer << std::to_string(requiredIndex++) << ");\n";
+        } else {
+            writer.indent(2) << "decoder.expect(value." << name << ");\n";
+        }
+    }
+
+    writer.indent(1) << "} else {\n";
+    writer.indent(2) << "decoder.skip();\n";
+    writer.indent(1) << "}\n";
+    writer.indent() << "}\n\n";
+}
+
+// Starts decoding the possible type named by __typename into `variant`, a member expression of `value`.
+static void generateVariantSaxDecoding(
+        CodeWriter & writer, Type const & type, std::string_view variant, FunctionPart part) {
+    auto const & name = type.name.str();
+
+    if (part == FunctionPart::InlineDefinition) {
+        writer.indent() << "inline ";
+    } else {
+        writer.indent();
+    }
+    writer << "void saxDecodeAlternative(SaxDecoder & decoder, " << name;
+    writer << " & value, std::string const & typeName) {\n";
+
+    auto const names = possibleTypeNames(type);
+    generateStringDispatch(writer, "typeName", names, [&](size_t index) {
+        return "decoder.startObject(" + std::string{variant} + ".emplace<" + std::string{names[index]} + ">());";
+    });
+
+    writer.indent(1) << "decoder.startObject(" << variant << ".emplace<" << unknownCaseName << name << ">());\n";
+    writer.indent() << "}\n\n";
+
+    writeSaxDecodeSignature(writer.indent(), name, part);
+    writer.indent(1) << "decoder.decodeVariant(value, event);\n";
+    writer.indent() << "}\n\n";
+}
+
+void generateObjectSaxDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part != FunctionPart::Declaration) {
+        generateFieldsSaxDecoding(writer, type.name.str(), type.fields, boxedTypes, part);
+    }
+}
+
+void generateInterfaceSaxDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part != FunctionPart::Declaration) {
+        generateFieldsSaxDecoding(writer, unknownCaseName + type.name.str(), type.fields, boxedTypes, part);
+        generateVariantSaxDecoding(writer, type, "value.implementation", part);
+    }
+}
+
+void generateUnionSaxDecoding(CodeWriter & writer, Type const & type, FunctionPart part) {
+    if (part != FunctionPart::Declaration) {
+        generateVariantSaxDecoding(writer, type, "value", part);
+    }
+}
+
+static void generateSaxDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    switch (type.kind) {
+    case TypeKind::Object:
+        generateObjectSaxDecoding(writer, type, boxedTypes, part);
+        break;
+    case TypeKind::Interface:
+        generateInterfaceSaxDecoding(writer, type, boxedTypes, part);
+        break;
+    case TypeKind::Union:
+        generateUnionSaxDecoding(writer, type, part);
+        break;
+    default:
+        break;
+    }
+}
+
+void generateOnDemandDecoder(CodeWriter & writer, BoxedTypes const & boxedTypes) {
+    auto const decoder = R"(// Decodes responses with simdjson's On Demand API. Values are parsed as they are decoded
+// into the generated types, and values that aren't decoded, such as fields that weren't selected, are skipped without
+// being parsed.
+inline simdjson::ondemand::parser & onDemandParser() {
+    thread_local simdjson::ondemand::parser parser;
+    return parser;
+}
+
+// Copies a body into a buffer with the padding simdjson needs past its end, reused by each thread.
+inline simdjson::padded_string_view onDemandPaddedCopy(char const * body, size_t size) {
+    thread_local std::string buffer;
+    buffer.assign(body, size);
+    buffer.resize(size + simdjson::SIMDJSON_PADDING);
+    return simdjson::padded_string_view(buffer.data(), size, buffer.size());
+}
+
+inline void onDemandDecode(simdjson::ondemand::value json, std::string & value) {
+    std::string_view text = json.get_string();
+    value.assign(text.data(), text.size());
+}
+
+inline void onDemandDecode(simdjson::ondemand::value json, bool & value) { value = json.get_bool(); }
+
+inline void onDemandDecode(simdjson::ondemand::value json, int32_t & value) {
+    int64_t number = json.get_int64();
+    value = static_cast<int32_t>(number);
+}
+
+inline void onDemandDecode(simdjson::ondemand::value json, double & value) { value = json.get_double(); }
+
+// The unknown case of unions.
+inline void onDemandDecodeMembers(simdjson::ondemand::object, monostate &) {}
+
+// Enums are decoded from strings by their generated from_string_view.
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+void onDemandDecode(simdjson::ondemand::value json, T & value);
+
+template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, optional<T> & value);
+
+template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, std::vector<T> & value);
+
+)";
+
+    auto const boxedOptionalDeclaration = R"(template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, $BoxedOptional<T> & box);
+
+)";
+
+    auto const definitions = R"(template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type>
+void onDemandDecode(simdjson::ondemand::value json, T & value) {
+    if (json.is_null()) {
+        value = T::Unknown;
+    } else {
+        std::string_view text = json.get_string();
+        from_string_view(text, value);
+    }
+}
+
+template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, optional<T> & value) {
+    if (json.is_null()) {
+        value.reset();
+        return;
+    }
+    if (!value) {
+        value.emplace();
+    }
+    onDemandDecode(json, *value);
+}
+
+template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, std::vector<T> & value) {
+    value.clear();
+    for (simdjson::ondemand::value element : json.get_array()) {
+        value.emplace_back();
+        onDemandDecode(element, value.back());
+    }
+}
+
+// Elements of std::vector<bool> can't be referenced, so they're appended once decoded.
+inline void onDemandDecode(simdjson::ondemand::value json, std::vector<bool> & value) {
+    value.clear();
+    for (simdjson::ondemand::value element : json.get_array()) {
+        value.push_back(element.get_bool());
+    }
+}
+
+)";
+
+    auto const boxedOptionalDefinition = R"(template <typename T>
+void onDemandDecode(simdjson::ondemand::value json, $BoxedOptional<T> & box) {
+    if (json.is_null()) {
+        box.reset();
+        return;
+    }
+    if (!box) {
+        box = T{};
+    }
+    onDemandDecode(json, *box);
+}
+
+)";
+
+    auto const response = R"(// Decodes a variant from an object that names its possible type with __typename,
+// wherever it is in the object.
+template <typename T>
+void onDemandDecodeVariant(simdjson::ondemand::value json, T & value) {
+    simdjson::ondemand::object object = json.get_object();
+    std::string_view typeName = object["__typename"];
+    object.reset();
+    onDemandDecodeAlternative(object, value, typeName);
+}
+
+inline void onDemandDecode(simdjson::ondemand::value json, GraphqlError & value) {
+    bool hasMessage = false;
+    for (simdjson::ondemand::field field : json.get_object()) {
+        if (field.key() == "message") {
+            hasMessage = true;
+            onDemandDecode(field.value(), value.message);
+        }
+    }
+    if (!hasMessage) {
+        throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);
+    }
+}
+
+// Decodes the response to an operation on `fieldName` as its response function would from the parsed body.
+template <typename Data>
+GraphqlResponse<Data> decodeOnDemandResponse(
+        simdjson::padded_string_view body, char const * fieldName, bool isRequired) {
+    simdjson::ondemand::document document = onDemandParser().iterate(body);
+    Data data{};
+    optional<std::vector<GraphqlError>> errors;
+    bool hasDataObject = false;
+    bool hasData = false;
+
+    for (simdjson::ondemand::field member : document.get_object()) {
+        auto const key = member.key();
+        if (key == "errors") {
+            onDemandDecode(member.value(), errors);
+        } else if (key == "data") {
+            hasDataObject = true;
+            simdjson::ondemand::value dataValue = member.value();
+            if (dataValue.is_null()) {
+                continue;
+            }
+            for (simdjson::ondemand::field dataMember : dataValue.get_object()) {
+                if (dataMember.key() == fieldName) {
+                    hasData = true;
+                    onDemandDecode(dataMember.value(), data);
+                }
+            }
+        }
+    }
+
+    if (errors) {
+        return std::move(*errors);
+    }
+    if (!hasDataObject || (isRequired && !hasData)) {
+        throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);
+    }
+    return data;
+}
+
+)";
+
+    generateSupportCode(writer, decoder);
+    if (!boxedTypes.empty()) {
+        generateSupportCode(writer, boxedOptionalDeclaration);
+    }
+    generateSupportCode(writer, definitions);
+    if (!boxedTypes.empty()) {
+        generateSupportCode(writer, boxedOptionalDefinition);
+    }
+    generateSupportCode(writer, response);
+}
+
+namespace {
+
+enum class OnDemandFunction { Members, Decode, Alternative };
+
+} // namespace
+
+// Leaves the decoded value's parameter unnamed when `isValueUsed` is false.
+static void writeOnDemandSignature(
+        CodeWriter & writer,
+        OnDemandFunction function,
+        std::string_view typeName,
+        FunctionPart part,
+        bool isValueUsed = true) {
+    writer.indent();
+    if (part == FunctionPart::InlineDefinition) {
+        writer << "inline ";
+    }
+
+    switch (function) {
+    case OnDemandFunction::Members:
+        writer << "void onDemandDecodeMembers(simdjson::ondemand::object object, " << typeName
+               << (isValueUsed ? " & value)" : " &)");
+        break;
+    case OnDemandFunction::Decode:
+        writer << "void onDemandDecode(simdjson::ondemand::value json, " << typeName << " & value)";
+        break;
+    case OnDemandFunction::Alternative:
+        writer << "void onDemandDecodeAlternative(simdjson::ondemand::object object, " << typeName;
+        writer << " & value, std::string_view typeName)";
+        break;
+    }
+}
+
+static void generateOnDemandMembersDecoding(
+        CodeWriter & writer,
+        std::string_view typeName,
+        std::vector<Field> const & fields,
+        BoxedTypes const & boxedTypes,
+        FunctionPart part) {
+    auto const requiredFields = std::count_if(fields.begin(), fields.end(), [&](Field const & field) {
+        return isRequiredField(field, boxedTypes);
+    });
+
+    writeOnDemandSignature(writer, OnDemandFunction::Members, typeName, part, !fields.empty());
+    writer << " {\n";
+
+    // Objects that limitSelectionDepth leaves without fields only select __typename, so every member is skipped.
+    if (fields.empty()) {
+        writer.indent(1) << "for (simdjson::ondemand::field field : object) {\n";
+        writer.indent(2) << "static_cast<void>(field);\n";
+        writer.indent(1) << "}\n";
+        writer.indent() << "}\n\n";
+        return;
+    }
+
+    // A bit per required member, set once it has been read, so that repeated keys are only counted once.
+    if (requiredFields != 0) {
+        writer.indent(1) << "std::bitset<" << std::to_string(requiredFields) << "> requiredMembers;\n";
+    }
+    writer.indent(1) << "for (simdjson::ondemand::field field : object) {\n";
+    writer.indent(2) << "auto const key = field.key();\n";
+    writer.indent(2);
+
+    size_t requiredIndex = 0;
+    for (auto const & field : fields) {
+        auto const & name = field.name.str();
+        writer << "if (key == \"" << name << "\") {\n";
+        if (isRequiredField(field, boxedTypes)) {
+            writer.indent(3) << "requiredMembers.set(" << std::to_string(requiredIndex++) << ");\n";
         }
-        generated += indent(indentation) + ")";
+        writer.indent(3) << "onDemandDecode(field.value(), value." << name << ");\n";
+        writer.indent(2) << (&field == &fields.back() ? "}\n" : "} else ");
     }
 
-    auto const & underlyingFieldType = field.type.underlyingType();
-    if (underlyingFieldType.kind != TypeKind::Scalar && underlyingFieldType.kind != TypeKind::Enum) {
-        generated += " {\n";
-        generated += generateQueryFields(
-                typeMap.at(underlyingFieldType.name.value()),
-                typeMap,
-                appendNameToVariablePrefix(variablePrefix, underlyingFieldType.name.value()),
-                variables,
-                {},
-                indentation + 1);
-        generated += indent(indentation) + "}";
+    writer.indent(1) << "}\n";
+    if (requiredFields != 0) {
+        writer.indent(1) << "if (!requiredMembers.all()) {\n";
+        writer.indent(2) << "throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);\n";
+        writer.indent(1) << "}\n";
     }
+    writer.indent() << "}\n\n";
+}
 
-    generated += "\n";
+// Decodes the members of the possible type named by __typename into `variant`, a member expression of `value`.
+static void generateOnDemandVariantDecoding(
+        CodeWriter & writer, Type const & type, std::string_view variant, FunctionPart part) {
+    auto const & name = type.name.str();
 
-    return generated;
+    writeOnDemandSignature(writer, OnDemandFunction::Alternative, name, part);
+    writer << " {\n";
+
+    auto const names = possibleTypeNames(type);
+    generateStringDispatch(writer, "typeName", names, [&](size_t index) {
+        return "onDemandDecodeMembers(object, " + std::string{variant} + ".emplace<" + std::string{names[index]}
+                + ">());";
+    });
+
+    writer.indent(1) << "onDemandDecodeMembers(object, " << variant << ".emplace<" << unknownCaseName << name;
+    writer << ">());\n";
+    writer.indent() << "}\n\n";
+
+    writeOnDemandSignature(writer, OnDemandFunction::Decode, name, part);
+    writer << " {\n";
+    writer.indent(1) << "onDemandDecodeVariant(json, value);\n";
+    writer.indent() << "}\n\n";
 }
 
-std::string generateQueryFields(
+void generateObjectOnDemandDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part == FunctionPart::Declaration) {
+        return;
+    }
+
+    auto const & name = type.name.str();
+    generateOnDemandMembersDecoding(writer, name, type.fields, boxedTypes, part);
+
+    writeOnDemandSignature(writer, OnDemandFunction::Decode, name, part);
+    writer << " {\n";
+    writer.indent(1) << "onDemandDecodeMembers(json.get_object(), value);\n";
+    writer.indent() << "}\n\n";
+}
+
+void generateInterfaceOnDemandDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    if (part != FunctionPart::Declaration) {
+        generateOnDemandMembersDecoding(writer, unknownCaseName + type.name.str(), type.fields, boxedTypes, part);
+        generateOnDemandVariantDecoding(writer, type, "value.implementation", part);
+    }
+}
+
+void generateUnionOnDemandDecoding(CodeWriter & writer, Type const & type, FunctionPart part) {
+    if (part != FunctionPart::Declaration) {
+        generateOnDemandVariantDecoding(writer, type, "value", part);
+    }
+}
+
+// Declares the on demand decoding of a type, which types of a recursive component call before it is defined.
+static void generateOnDemandDecodingPrototypes(CodeWriter & writer, Type const & type, FunctionPart part) {
+    auto const & name = type.name.str();
+    auto prototype = [&](OnDemandFunction function, std::string_view typeName) {
+        writeOnDemandSignature(writer, function, typeName, part);
+        writer << ";\n";
+    };
+
+    switch (type.kind) {
+    case TypeKind::Object:
+        prototype(OnDemandFunction::Members, name);
+        prototype(OnDemandFunction::Decode, name);
+        break;
+    case TypeKind::Interface:
+        prototype(OnDemandFunction::Members, unknownCaseName + name);
+        prototype(OnDemandFunction::Alternative, name);
+        prototype(OnDemandFunction::Decode, name);
+        break;
+    case TypeKind::Union:
+        prototype(OnDemandFunction::Alternative, name);
+        prototype(OnDemandFunction::Decode, name);
+        break;
+    default:
+        break;
+    }
+}
+
+static void generateOnDemandDecoding(
+        CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes, FunctionPart part) {
+    switch (type.kind) {
+    case TypeKind::Object:
+        generateObjectOnDemandDecoding(writer, type, boxedTypes, part);
+        break;
+    case TypeKind::Interface:
+        generateInterfaceOnDemandDecoding(writer, type, boxedTypes, part);
+        break;
+    case TypeKind::Union:
+        generateUnionOnDemandDecoding(writer, type, part);
+        break;
+    default:
+        break;
+    }
+}
+
+// Generates the functions decoding `type` from response bodies, if `decoding` has any.
+static void generateResponseDecoding(
+        CodeWriter & writer,
         Type const & type,
-        TypeMap const & typeMap,
-        std::string const & variablePrefix,
-        std::vector<QueryVariable> & variables,
-        std::vector<Field> const & ignoredFields,
-        size_t indentation) {
-    std::string generated;
+        BoxedTypes const & boxedTypes,
+        FunctionPart part,
+        ResponseDecoding decoding) {
+    switch (decoding) {
+    case ResponseDecoding::Dom:
+        break;
+    case ResponseDecoding::Sax:
+        generateSaxDecoding(writer, type, boxedTypes, part);
+        break;
+    case ResponseDecoding::OnDemand:
+        generateOnDemandDecoding(writer, type, boxedTypes, part);
+        break;
+    }
+}
+
+std::string operationQueryName(Operation operation) {
+    switch (operation) {
+    case Operation::Query:
+        return "query";
+    case Operation::Mutation:
+        return "mutation";
+    case Operation::Subscription:
+        return "subscription";
+    }
+
+    throw std::invalid_argument{"Invalid Operation value: " + std::to_string(static_cast<int>(operation))};
+}
+
+std::string appendNameToVariablePrefix(std::string const & variablePrefix, std::string const & name) {
+    return variablePrefix.empty() ? uncapitalize(name) : variablePrefix + capitalize(name);
+}
+
+std::string compactVariableName(size_t index) {
+    static constexpr std::string_view letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    // Bijective numeration, which has no zero digit, so that names of each length follow on from the shorter ones.
+    std::string name;
+    for (auto remaining = index + 1; remaining > 0; remaining = (remaining - 1) / letters.size()) {
+        name += letters[(remaining - 1) % letters.size()];
+    }
+    std::reverse(name.begin(), name.end());
+    return name;
+}
+
+static bool isNameCharacter(char character) {
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+           (character >= '0' && character <= '9') || character == '_';
+}
+
+std::string compactQuery(std::string_view query, std::vector<QueryVariable> const & variables) {
+    std::string compact;
+    compact.reserve(query.size());
+    auto nextVariable = variables.begin();
+
+    size_t position = 0;
+    while (position < query.size()) {
+        auto const character = query[position];
+        if (character == ' ' || character == '\n' || character == ',') {
+            ++position;
+        } else if (isNameCharacter(character)) {
+            auto const end = std::find_if_not(query.begin() + position, query.end(), isNameCharacter) - query.begin();
+            // Adjacent names are the only tokens that need whitespace to tell them apart.
+            if (!compact.empty() && isNameCharacter(compact.back())) {
+                compact += ' ';
+            }
+            compact += query.substr(position, end - position);
+            position = end;
+        } else if (character == '$') {
+            if (nextVariable == variables.end()) {
+                throw std::logic_error{"Query references more variables than it declares"};
+            }
+            compact += '$';
+            compact += nextVariable->queryName();
+            ++nextVariable;
+            position = std::find_if_not(query.begin() + position + 1, query.end(), isNameCharacter) - query.begin();
+        } else {
+            compact += character;
+            ++position;
+        }
+    }
+
+    return compact;
+}
+
+namespace {
+
+// A field of a selection set, with its arguments, or a fragment on one of the possible types of an interface or union.
+struct Selection {
+    // Lines before the selection's own selection set, with those after the first indented relative to it
+    std::vector<std::string> lines;
+    std::optional<size_t> selectionSet;
+    bool isTypeCondition = false;
+    bool hasArguments = false;
+};
+
+struct SelectionSet {
+    Symbol typeName;
+    std::vector<Selection> selections;
+    // Variables are named after the path to the arguments that reference them, so sets that reference any differ from
+    // every other set, and can't be spread from a fragment without reordering the variables.
+    bool hasVariables = false;
+    // Approximate length in a compact query, which decides whether repeated sets are worth making into fragments
+    size_t compactSize = 0;
+};
+
+// Fields by name, which the selection sets of an interface's or union's possible types leave out when they are equal.
+using IgnoredFields = std::unordered_map<Symbol, Field const *>;
+
+// Whether a type was being expanded when a selection set was built, which decided whether the set omitted its fields
+// of that type.
+struct PathCondition {
+    TypeIndex type;
+    bool isExpanding;
+};
+
+// A built selection set without variables, which building the set again would give wherever its conditions hold.
+struct MemoizedSelectionSet {
+    IgnoredFields const * ignoredFields;
+    size_t depth;
+    Json const * manifestSelection;
+    std::vector<PathCondition> conditions;
+    size_t index;
+};
+
+// A selection set being built, with the conditions that it has depended on so far.
+struct PendingSelectionSet {
+    // Length of the expansion path when the set began, which only types before it are conditions on
+    size_t pathLength;
+    std::vector<PathCondition> conditions;
+};
+
+// Builds the selection sets of a query, storing each distinct set once so that the sets repeated in the query can be
+// written as named fragments.
+//
+// A type's selection set only differs between the places it is reached by the types of its nested fields that are
+// being expanded there, so sets are memoized by type along with those conditions, and each is only built once however
+// often the query reaches it. Sets with variables are always built, as their variables are named after their path.
+//
+// Depths are the number of levels of selection sets that may be nested in the selection set being built, and fields
+// that would need a selection set deeper than that are left out.
+//
+// Manifest selections are objects of fields from a selection manifest, or nullptr. A set built from a manifest selection
+// only selects the fields that it names, whatever other operations select of the same type. The fields that it names
+// with objects of their own follow them even when their type is being expanded, as the manifest nests them explicitly
+// and is finite.
+struct SelectionSets {
+    static constexpr size_t unlimitedDepth = std::numeric_limits<size_t>::max();
+
+    TypeMap const & typeMap;
+    std::vector<QueryVariable> & variables;
+    // Types whose selection sets are being built, outermost first, which types not in the type map are held in as npos
+    std::vector<TypeIndex> expansionPath;
+    // By type, one past its last position in the expansion path, or 0 when it isn't being expanded
+    std::vector<size_t> expansionEnds;
+    // The expansion ends that the types in the expansion path had before they were added to it
+    std::vector<size_t> previousExpansionEnds;
+    std::vector<SelectionSet> sets;
+    std::unordered_map<std::string, size_t> indices;
+    std::unordered_map<Symbol, std::vector<MemoizedSelectionSet>> memoized;
+    std::vector<PendingSelectionSet> pending;
+    // Node based, so memoized sets can point to the fields that they ignore.
+    std::unordered_map<Symbol, IgnoredFields> interfaceFields;
+
+    SelectionSets(TypeMap const & typeMap, std::vector<QueryVariable> & variables)
+        : typeMap{typeMap}, variables{variables}, expansionEnds(typeMap.size()) {}
+
+    void beginExpanding(Symbol typeName) {
+        auto const type = typeMap.find(typeName);
+        expansionPath.push_back(type);
+        if (type != TypeMap::npos) {
+            previousExpansionEnds.push_back(expansionEnds[type]);
+            expansionEnds[type] = expansionPath.size();
+        }
+    }
+
+    void endExpanding() {
+        auto const type = expansionPath.back();
+        expansionPath.pop_back();
+        if (type != TypeMap::npos) {
+            expansionEnds[type] = previousExpansionEnds.back();
+            previousExpansionEnds.pop_back();
+        }
+    }
+
+    // Whether `type` is being expanded, which the set being built depends on unless it expanded the type itself.
+    bool isExpanding(TypeIndex type) {
+        auto const end = expansionEnds[type];
+        auto const isExpanding = end > 0;
+        if (!pending.empty()) {
+            auto & set = pending.back();
+            if (!isExpanding || end <= set.pathLength) {
+                set.conditions.push_back({type, isExpanding});
+            }
+        }
+        return isExpanding;
+    }
+
+    // The object that `manifestSelection` names `key` with, or nullptr.
+    static Json const * nestedSelection(Json const * manifestSelection, std::string const & key) {
+        if (!manifestSelection) {
+            return nullptr;
+        }
+        auto const nested = manifestSelection->find(key);
+        return nested != manifestSelection->end() && nested->is_object() ? &*nested : nullptr;
+    }
+
+    // The selection of the fields of a possible type that `manifestSelection` has no fragment for, which selects only
+    // the fields of the interface, or none.
+    static Json const * fragmentSelection(Json const * manifestSelection, std::string const & possibleTypeName) {
+        static Json const noFields = Json::object();
+        auto const fragment = nestedSelection(manifestSelection, "...on " + possibleTypeName);
+        return fragment || !manifestSelection ? fragment : &noFields;
+    }
+
+    // Nothing for fields whose type is already being expanded, unless `manifestSelection` nests them explicitly, so
+    // that expanding recursive types terminates, and for fields that would need a selection set beyond the depth.
+    std::optional<Selection> field(
+            Field const & field,
+            std::string const & variablePrefix,
+            size_t depth,
+            Json const * manifestSelection = nullptr) {
+        auto const underlyingFieldType = field.type.underlyingType();
+        auto const hasSelectionSet =
+                underlyingFieldType.kind() != TypeKind::Scalar && underlyingFieldType.kind() != TypeKind::Enum;
+        auto const underlyingFieldTypeName = underlyingFieldType.name();
+
+        if (hasSelectionSet &&
+            (depth == 0 || (!manifestSelection && isExpanding(typeMap.indexOf(underlyingFieldTypeName))))) {
+            return std::nullopt;
+        }
+
+        Selection selection;
+        auto & lines = selection.lines;
+        lines.push_back(field.name.str());
+
+        if (!field.args.empty()) {
+            lines.back() += '(';
+            for (auto const & arg : field.args) {
+                auto variableName = appendNameToVariablePrefix(variablePrefix, arg.name.str());
+                lines.push_back(std::string(spacesPerIndent, ' ') + arg.name.str() + ": $" + variableName);
+                variables.push_back({variableName, arg.type});
+            }
+            lines.push_back(")");
+            selection.hasArguments = true;
+        }
+
+        if (hasSelectionSet) {
+            beginExpanding(underlyingFieldTypeName);
+            selection.selectionSet = fields(
+                    typeMap.at(underlyingFieldTypeName),
+                    appendNameToVariablePrefix(variablePrefix, underlyingFieldTypeName.str()),
+                    nullptr,
+                    depth == unlimitedDepth ? unlimitedDepth : depth - 1,
+                    manifestSelection);
+            endExpanding();
+        }
+
+        return selection;
+    }
+
+    // Index of the selection set of `type`'s fields, except those equal to `ignoredFields`.
+    size_t fields(
+            Type const & type,
+            std::string const & variablePrefix,
+            IgnoredFields const * ignoredFields,
+            size_t depth,
+            Json const * manifestSelection = nullptr) {
+        auto & candidates = memoized[type.name];
+        for (auto const & candidate : candidates) {
+            auto const & conditions = candidate.conditions;
+            if (candidate.ignoredFields == ignoredFields && candidate.depth == depth &&
+                candidate.manifestSelection == manifestSelection &&
+                std::all_of(conditions.begin(), conditions.end(), [&](PathCondition const & condition) {
+                    return (expansionEnds[condition.type] > 0) == condition.isExpanding;
+                })) {
+                for (auto const & condition : conditions) {
+                    isExpanding(condition.type);
+                }
+                return candidate.index;
+            }
+        }
+
+        pending.push_back({expansionPath.size()});
+
+        SelectionSet set{type.name};
+        auto addSelection = [&](Selection selection) {
+            set.hasVariables = set.hasVariables || selection.hasArguments ||
+                               (selection.selectionSet && sets[*selection.selectionSet].hasVariables);
+            set.selections.push_back(std::move(selection));
+        };
+
+        if (!type.possibleTypes.empty()) {
+            addSelection(Selection{{"__typename"}});
+        }
 
-    auto addTypeFields = [&] {
         for (auto const & field : type.fields) {
-            if (std::find(ignoredFields.begin(), ignoredFields.end(), field) == ignoredFields.end()) {
-                generated += generateQueryField(
-                        field, typeMap, appendNameToVariablePrefix(variablePrefix, field.name), variables, indentation);
+            if (manifestSelection && !manifestSelection->contains(field.name.str())) {
+                continue;
+            }
+            if (ignoredFields) {
+                auto const ignoredField = ignoredFields->find(field.name);
+                if (ignoredField != ignoredFields->end() && *ignoredField->second == field) {
+                    continue;
+                }
+            }
+            if (auto selection = this->field(
+                        field,
+                        appendNameToVariablePrefix(variablePrefix, field.name.str()),
+                        depth,
+                        nestedSelection(manifestSelection, field.name.str()))) {
+                addSelection(std::move(*selection));
             }
         }
-    };
 
-    if (!type.possibleTypes.empty()) {
-        generated += indent(indentation) + "__typename\n";
+        // A field's selection set can't be empty, so one left without fields, by the depth or by leaving out the fields
+        // of types being expanded, selects the type name.
+        if (set.selections.empty() && !ignoredFields) {
+            addSelection(Selection{{"__typename"}});
+        }
 
-        addTypeFields();
+        if (!type.possibleTypes.empty()) {
+            auto const [typeFields, isNew] = interfaceFields.try_emplace(type.name);
+            if (isNew) {
+                for (auto const & field : type.fields) {
+                    typeFields->second.emplace(field.name, &field);
+                }
+            }
 
-        for (auto const & possibleType : type.possibleTypes) {
-            auto possibleTypeQuery = generateQueryFields(
-                    typeMap.at(possibleType.name.value()),
-                    typeMap,
-                    appendNameToVariablePrefix(variablePrefix, possibleType.name.value()),
-                    variables,
-                    type.fields,
-                    indentation + 1);
-            if (!possibleTypeQuery.empty()) {
-                generated += indent(indentation) + "...on " + possibleType.name.value() + " {\n";
-                generated += possibleTypeQuery;
-                generated += indent(indentation) + "}\n";
+            for (auto const & possibleType : type.possibleTypes) {
+                auto const & possibleTypeName = possibleType.name().str();
+
+                beginExpanding(possibleType.name());
+                auto const fragment = fields(
+                        typeMap.at(possibleType.name()),
+                        appendNameToVariablePrefix(variablePrefix, possibleTypeName),
+                        &typeFields->second,
+                        depth,
+                        fragmentSelection(manifestSelection, possibleTypeName));
+                endExpanding();
+
+                // Fragments without any fields of their own are dropped.
+                if (!sets[fragment].selections.empty()) {
+                    Selection selection{{"...on " + possibleTypeName}, fragment};
+                    selection.isTypeCondition = true;
+                    addSelection(std::move(selection));
+                }
             }
         }
-    } else {
-        addTypeFields();
+
+        auto conditions = std::move(pending.back().conditions);
+        pending.pop_back();
+        std::sort(conditions.begin(), conditions.end(), [](PathCondition const & lhs, PathCondition const & rhs) {
+            return lhs.type < rhs.type;
+        });
+        conditions.erase(
+                std::unique(
+                        conditions.begin(),
+                        conditions.end(),
+                        [](PathCondition const & lhs, PathCondition const & rhs) {
+                            return lhs.type == rhs.type;
+                        }),
+                conditions.end());
+        // The enclosing set depends on the same types, unless it expanded them itself.
+        for (auto const & condition : conditions) {
+            isExpanding(condition.type);
+        }
+
+        auto const index = intern(std::move(set));
+        if (!sets[index].hasVariables) {
+            candidates.push_back({ignoredFields, depth, manifestSelection, std::move(conditions), index});
+        }
+        return index;
+    }
+
+    size_t intern(SelectionSet set) {
+        // Nested sets are interned first, so equal sets have equal keys.
+        std::string key = set.typeName.str();
+        for (auto const & selection : set.selections) {
+            key += '\n';
+            for (auto const & line : selection.lines) {
+                key += line;
+                key += '\n';
+            }
+            if (selection.selectionSet) {
+                key += std::to_string(*selection.selectionSet);
+            }
+        }
+
+        auto const [position, inserted] = indices.try_emplace(std::move(key), sets.size());
+        if (inserted) {
+            set.compactSize = 2;
+            for (auto const & selection : set.selections) {
+                for (auto const & line : selection.lines) {
+                    set.compactSize += std::count_if(line.begin(), line.end(), [](char character) {
+                        return character != ' ' && character != ',';
+                    });
+                }
+                set.compactSize += 1 + (selection.selectionSet ? sets[*selection.selectionSet].compactSize : 0);
+            }
+            sets.push_back(std::move(set));
+        }
+        return position->second;
+    }
+
+    // Which of the sets to write as named fragments: those without variables that occur often enough in the query for
+    // their definition and spreads to be shorter than writing them out at each occurrence.
+    std::vector<bool> fragments() const {
+        std::vector<bool> isFragment(sets.size());
+        if (sets.empty()) {
+            return isFragment;
+        }
+
+        // Sets are stored after the sets nested in them, so the outermost set is last, and each set's occurrences are
+        // all counted by the time it is reached going backwards.
+        std::vector<size_t> occurrences(sets.size());
+        occurrences.back() = 1;
+        for (auto index = sets.size(); index-- > 0;) {
+            auto const & set = sets[index];
+            auto const count = occurrences[index];
+
+            // `fragment <Type>Fields on <Type>` once, and `...<Type>Fields` in place of each occurrence
+            auto const nameSize = set.typeName.str().size() + 6;
+            auto const definitionSize = 13 + nameSize + set.typeName.str().size();
+            auto const spreadSize = 5 + nameSize;
+            isFragment[index] = count > 1 && !set.hasVariables && !set.selections.empty() &&
+                                (count - 1) * set.compactSize > definitionSize + count * spreadSize;
+
+            auto const writtenCount = isFragment[index] ? 1 : count;
+            for (auto const & selection : set.selections) {
+                if (selection.selectionSet) {
+                    occurrences[*selection.selectionSet] += writtenCount;
+                }
+            }
+        }
+        return isFragment;
+    }
+};
+
+// Writes built selection sets, spreading those that are fragments. Fragments are named after their types, in the order
+// that they are first spread.
+struct SelectionSetWriter {
+    std::vector<SelectionSet> const & sets;
+    std::vector<bool> isFragment;
+    std::vector<std::string> fragmentNames;
+    std::vector<size_t> spreadFragments;
+    std::unordered_set<std::string> usedNames;
+
+    SelectionSetWriter(std::vector<SelectionSet> const & sets, std::vector<bool> isFragment)
+        : sets{sets}, isFragment{std::move(isFragment)}, fragmentNames(sets.size()) {}
+
+    std::string const & fragmentName(size_t index) {
+        auto & name = fragmentNames[index];
+        if (name.empty()) {
+            auto const baseName = sets[index].typeName.str() + "Fields";
+            name = baseName;
+            for (size_t number = 2; !usedNames.insert(name).second; ++number) {
+                name = baseName + std::to_string(number);
+            }
+            spreadFragments.push_back(index);
+        }
+        return name;
+    }
+
+    void writeSelection(CodeWriter & writer, Selection const & selection) {
+        auto const & selectionSet = selection.selectionSet;
+        if (selection.isTypeCondition && isFragment[*selectionSet]) {
+            writer.indent() << "..." << fragmentName(*selectionSet) << '\n';
+            return;
+        }
+
+        auto const & lines = selection.lines;
+        writer.indent() << lines.front();
+        for (auto line = lines.begin() + 1; line != lines.end(); ++line) {
+            writer << '\n';
+            writer.indent() << *line;
+        }
+
+        if (selectionSet) {
+            writer << " {\n";
+            writer.increaseIndentation();
+            if (isFragment[*selectionSet]) {
+                writer.indent() << "..." << fragmentName(*selectionSet) << '\n';
+            } else {
+                writeSelections(writer, *selectionSet);
+            }
+            writer.decreaseIndentation();
+            writer.indent() << '}';
+        }
+
+        writer << '\n';
+    }
+
+    void writeSelections(CodeWriter & writer, size_t index) {
+        for (auto const & selection : sets[index].selections) {
+            writeSelection(writer, selection);
+        }
+    }
+
+    // Fragments can spread other fragments, which are defined after them.
+    void writeFragmentDefinitions(CodeWriter & writer) {
+        for (size_t position = 0; position < spreadFragments.size(); ++position) {
+            auto const index = spreadFragments[position];
+            writer.indent() << "fragment " << fragmentNames[index] << " on " << sets[index].typeName.str() << " {\n";
+            writer.increaseIndentation();
+            writeSelections(writer, index);
+            writer.decreaseIndentation();
+            writer.indent() << "}\n";
+        }
+    }
+};
+
+} // namespace
+
+std::string generateQueryField(
+        Field const & field,
+        TypeMap const & typeMap,
+        std::string const & variablePrefix,
+        std::vector<QueryVariable> & variables,
+        size_t indentation) {
+    CodeWriter writer{indentation};
+    SelectionSets selectionSets{typeMap, variables};
+    auto const selection = selectionSets.field(field, variablePrefix, SelectionSets::unlimitedDepth);
+    SelectionSetWriter selectionSetWriter{selectionSets.sets, std::vector<bool>(selectionSets.sets.size())};
+    if (selection) {
+        selectionSetWriter.writeSelection(writer, *selection);
+    }
+    return writer.take();
+}
+
+std::string generateQueryFields(
+        Type const & type,
+        TypeMap const & typeMap,
+        std::string const & variablePrefix,
+        std::vector<QueryVariable> & variables,
+        std::vector<Field> const & ignoredFields,
+        size_t indentation) {
+    IgnoredFields ignoredFieldsByName;
+    for (auto const & field : ignoredFields) {
+        ignoredFieldsByName.emplace(field.name, &field);
     }
 
-    return generated;
+    CodeWriter writer{indentation};
+    SelectionSets selectionSets{typeMap, variables};
+    selectionSets.beginExpanding(type.name);
+    auto const selectionSet =
+            selectionSets.fields(type, variablePrefix, &ignoredFieldsByName, SelectionSets::unlimitedDepth);
+    SelectionSetWriter selectionSetWriter{selectionSets.sets, std::vector<bool>(selectionSets.sets.size())};
+    selectionSetWriter.writeSelections(writer, selectionSet);
+    return writer.take();
 }
 
 QueryDocument generateQueryDocument(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        QueryFormat format,
+        size_t maxDepth,
+        Json const * manifestSelection) {
     QueryDocument document;
-    auto & query = document.query;
     auto & variables = document.variables;
+    auto const isCompact = format == QueryFormat::Compact;
+
+    // The selection set declares the variables, so it is generated before the header that lists them.
+    SelectionSets selectionSets{typeMap, variables};
+    auto const selection = selectionSets.field(
+            field, "", maxDepth == 0 ? SelectionSets::unlimitedDepth : maxDepth, manifestSelection);
+    SelectionSetWriter selectionSetWriter{selectionSets.sets, selectionSets.fragments()};
+    CodeWriter selectionSet{isCompact ? 0 : indentation + 1};
+    if (selection) {
+        selectionSetWriter.writeSelection(selectionSet, *selection);
+    }
+    CodeWriter fragmentDefinitions{isCompact ? 0 : indentation};
+    selectionSetWriter.writeFragmentDefinitions(fragmentDefinitions);
 
-    auto selectionSet = generateQueryField(field, typeMap, "", variables, indentation + 1);
+    if (isCompact) {
+        for (size_t index = 0; index < variables.size(); ++index) {
+            variables[index].compactName = compactVariableName(index);
+        }
+
+        auto & query = document.query;
+        query = operationQueryName(operation) + ' ' + capitalize(field.name.str());
+        // Unlike indented queries, compact ones leave out the parentheses when there are no variables, which GraphQL
+        // doesn't allow to be empty.
+        if (!variables.empty()) {
+            query += '(';
+            for (auto const & variable : variables) {
+                query += '$' + variable.compactName.str() + ':' + graphqlTypeName(variable.type);
+            }
+            query += ')';
+        }
+        query += '{' + compactQuery(selectionSet.str(), variables) + '}';
+        query += compactQuery(fragmentDefinitions.str(), {});
+        return document;
+    }
 
-    query += indent(indentation) + operationQueryName(operation) + " " + capitalize(field.name) + "(\n";
+    CodeWriter writer{indentation};
+    writer.indent() << operationQueryName(operation) << ' ';
+    writer.capitalized(field.name.str()) << "(\n";
 
     for (auto const & variable : variables) {
-        query += indent(indentation + 1) + "$" + variable.name + ": " + graphqlTypeName(variable.type) + "\n";
+        writer.indent(1) << '$' << variable.name.str() << ": " << graphqlTypeName(variable.type) << '\n';
     }
 
-    query += indent(indentation) + ") {\n";
-    query += selectionSet;
-    query += indent(indentation) + "}\n";
+    writer.indent() << ") {\n";
+    writer << selectionSet.str();
+    writer.indent() << "}\n";
+    writer << fragmentDefinitions.str();
 
+    document.query = writer.take();
     return document;
 }
 
 bool shouldPassByReferenceToRequestFunction(TypeRef const & type) {
-    auto currentType = &type;
+    auto currentType = type;
     while (true) {
-        switch (currentType->kind) {
+        switch (currentType.kind()) {
         case TypeKind::Scalar:
-            switch (scalarType(currentType->name.value())) {
+            switch (scalarType(currentType.name().str())) {
             case Scalar::Int:
             case Scalar::Float:
             case Scalar::Boolean:
@@ -675,156 +3331,430 @@ bool shouldPassByReferenceToRequestFunction(TypeRef const & type) {
         case TypeKind::Enum:
             return false;
 
-        case TypeKind::Object:
-        case TypeKind::Interface:
-        case TypeKind::Union:
-        case TypeKind::InputObject:
-        case TypeKind::List:
-            return true;
+        case TypeKind::Object:
+        case TypeKind::Interface:
+        case TypeKind::Union:
+        case TypeKind::InputObject:
+        case TypeKind::List:
+            return true;
+
+        case TypeKind::NonNull:
+            if (currentType.hasOfType()) {
+                currentType = currentType.ofType();
+                continue;
+            } else {
+                throw std::runtime_error{"Nonnull should be wrapped a type"};
+            }
+        }
+    }
+}
+
+static CodeWriter & writeOperationTypeName(CodeWriter & writer, Field const & field) {
+    return writer.capitalized(field.name.str()) << "Field";
+}
+
+static void writeRequestParameters(CodeWriter & writer, QueryDocument const & document) {
+    for (auto it = document.variables.begin(); it != document.variables.end(); ++it) {
+        writer << cppTypeName(it->type);
+        if (shouldPassByReferenceToRequestFunction(it->type)) {
+            writer << " const &";
+        }
+        writer << ' ' << it->name.str();
+
+        if (it != document.variables.end() - 1) {
+            writer << ", ";
+        }
+    }
+}
+
+// Writes text as a raw string literal, delimited so that the text can't end it early.
+static void writeRawStringLiteral(CodeWriter & writer, std::string_view text) {
+    std::string_view const delimiter = text.find(")\"") == std::string_view::npos ? "" : "caffql";
+    writer << "R\"" << delimiter << '(' << text << ')' << delimiter << '"';
+}
+
+static void generateVariablesSerialization(CodeWriter & writer, QueryDocument const & document) {
+    writer.indent(1) << cppJsonTypeName << " variables;\n";
+
+    writer.increaseIndentation();
+    for (auto const & variable : document.variables) {
+        generateFieldSerialization(writer, variable, "", "variables");
+    }
+    writer.decreaseIndentation();
+}
+
+void generateOperationRequestFunction(
+        CodeWriter & writer,
+        Field const & field,
+        QueryDocument const & document,
+        FunctionPart part,
+        QueryFormat format) {
+    if (part == FunctionPart::Definition) {
+        writer.indent() << cppJsonTypeName << ' ';
+        writeOperationTypeName(writer, field) << "::request(";
+    } else {
+        writer.indent() << "static " << cppJsonTypeName << " request(";
+    }
+
+    writeRequestParameters(writer, document);
+
+    if (part == FunctionPart::Declaration) {
+        writer << ");\n\n";
+        return;
+    }
 
-        case TypeKind::NonNull:
-            if (currentType->ofType) {
-                currentType = &*currentType->ofType;
-                continue;
-            } else {
-                throw std::runtime_error{"Nonnull should be wrapped a type"};
-            }
+    writer << ") {\n";
+
+    // Use raw string literal for the query.
+    if (format == QueryFormat::Compact) {
+        writer.indent(1) << cppJsonTypeName << " query = ";
+        writeRawStringLiteral(writer, document.query);
+        writer << ";\n";
+    } else {
+        // The document is indented to line up with the function.
+        writer.indent(1) << cppJsonTypeName << " query = R\"(\n";
+        std::string_view query = document.query;
+        for (size_t lineStart = 0; lineStart < query.size();) {
+            auto const lineEnd = std::min(query.find('\n', lineStart), query.size() - 1) + 1;
+            writer.indent(2) << query.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd;
         }
+        writer.indent(1) << ")\";\n";
     }
+    generateVariablesSerialization(writer, document);
+
+    writer.indent(1) << "return {{\"query\", std::move(query)}, {\"variables\", std::move(variables)}};\n";
+
+    writer.indent() << "}\n\n";
 }
 
-std::string generateOperationRequestFunction(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
-    auto const functionIndentation = indentation + 1;
-    auto const queryIndentation = functionIndentation + 1;
+void generateOperationRequestBodyPrefix(CodeWriter & writer, QueryDocument const & document) {
+    auto const prefix = "{\"query\":" + Json(document.query).dump() + ",\"variables\":";
 
-    auto const document = generateQueryDocument(field, operation, typeMap, queryIndentation);
+    writer.indent() << "static string_view constexpr " << requestBodyPrefixName << " = ";
+    writeRawStringLiteral(writer, prefix);
+    writer << ";\n\n";
 
-    std::string generated;
-    generated += indent(indentation) + "static " + cppJsonTypeName + " request(";
+    auto const hash = sha256Hex(document.query);
+    writer.indent() << "static string_view constexpr " << queryHashName << " = \"" << hash << "\";\n\n";
 
-    for (auto it = document.variables.begin(); it != document.variables.end(); ++it) {
-        auto typeName = cppTypeName(it->type);
-        if (shouldPassByReferenceToRequestFunction(it->type)) {
-            typeName += " const &";
+    writer.indent() << "static string_view constexpr " << persistedRequestBodyPrefixName << " = ";
+    writeRawStringLiteral(writer, R"({"extensions":{"persistedQuery":{"version":1,"sha256Hash":")" + hash + "\"}},");
+    writer << ";\n\n";
+}
+
+void generateOperationRequestBodyFunction(
+        CodeWriter & writer, Field const & field, QueryDocument const & document, FunctionPart part) {
+    // Writes the signature of the `part` of a function taking `parameters` and then the variables, and returns whether
+    // its body follows.
+    auto writeFunctionStart = [&](std::string_view returnType, std::string_view name, std::string_view parameters) {
+        if (part == FunctionPart::Definition) {
+            writer.indent() << returnType << ' ';
+            writeOperationTypeName(writer, field) << "::" << name << '(';
+        } else {
+            writer.indent() << "static " << returnType << ' ' << name << '(';
         }
-        generated += typeName + " " + it->name;
 
-        if (it != document.variables.end() - 1) {
-            generated += ", ";
+        writer << parameters;
+        if (!parameters.empty() && !document.variables.empty()) {
+            writer << ", ";
         }
-    }
+        writeRequestParameters(writer, document);
 
-    generated += ") {\n";
+        if (part == FunctionPart::Declaration) {
+            writer << ");\n\n";
+            return false;
+        }
 
-    // Use raw string literal for the query.
-    generated += indent(functionIndentation) + cppJsonTypeName + " query = R\"(\n" + document.query +
-                 indent(functionIndentation) + ")\";\n";
-    generated += indent(functionIndentation) + cppJsonTypeName + " variables;\n";
+        writer << ") {\n";
+        return true;
+    };
 
-    for (auto const & variable : document.variables) {
-        generated += generateFieldSerialization(variable, "", "variables", functionIndentation);
+    auto writeArguments = [&] {
+        for (auto const & variable : document.variables) {
+            writer << ", " << variable.name.str();
+        }
+    };
+
+    if (writeFunctionStart("void", "writeVariables", "JsonWriter & writer")) {
+        if (document.variables.empty()) {
+            writer.indent(1) << "writer.append(\"null\");\n";
+        } else {
+            generateJsonObjectWriting(writer, document.variables, "");
+        }
+        writer.indent() << "}\n\n";
+    }
+
+    if (writeFunctionStart("void", "writeRequestBody", "std::string & body")) {
+        writer.indent(1) << "JsonWriter writer{body};\n";
+        writer.indent(1) << "writer.append(" << requestBodyPrefixName << ");\n";
+        writer.indent(1) << "writeVariables(writer";
+        writeArguments();
+        writer << ");\n";
+        writer.indent(1) << "writer.append('}');\n";
+        writer.indent() << "}\n\n";
+    }
+
+    if (writeFunctionStart("std::string", "requestBody", "")) {
+        writer.indent(1) << "std::string body;\n";
+        writer.indent(1) << "writeRequestBody(body";
+        writeArguments();
+        writer << ");\n";
+        writer.indent(1) << "return body;\n";
+        writer.indent() << "}\n\n";
     }
 
-    generated += indent(functionIndentation) +
-                 "return {{\"query\", std::move(query)}, {\"variables\", std::move(variables)}};\n";
+    if (writeFunctionStart("void", "writePersistedRequestBody", "std::string & body, bool includeQuery")) {
+        writer.indent(1) << "JsonWriter writer{body};\n";
+        writer.indent(1) << "writer.append(" << persistedRequestBodyPrefixName << ");\n";
+        writer.indent(1) << "if (includeQuery) {\n";
+        writer.indent(2) << "writer.append(" << requestBodyPrefixName << ".substr(1));\n";
+        writer.indent(1) << "} else {\n";
+        writer.indent(2) << "writer.append(\"\\\"variables\\\":\");\n";
+        writer.indent(1) << "}\n";
+        writer.indent(1) << "writeVariables(writer";
+        writeArguments();
+        writer << ");\n";
+        writer.indent(1) << "writer.append('}');\n";
+        writer.indent() << "}\n\n";
+    }
 
-    generated += indent(indentation) + "}\n\n";
+    if (writeFunctionStart("std::string", "persistedRequestBody", "bool includeQuery")) {
+        writer.indent(1) << "std::string body;\n";
+        writer.indent(1) << "writePersistedRequestBody(body, includeQuery";
+        writeArguments();
+        writer << ");\n";
+        writer.indent(1) << "return body;\n";
+        writer.indent() << "}\n\n";
+    }
+}
 
-    return generated;
+std::string generateOperationRequestBodyFunction(
+        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation, QueryFormat format) {
+    CodeWriter writer{indentation};
+    auto const document = generateQueryDocument(field, operation, typeMap, 0, format);
+    generateOperationRequestBodyPrefix(writer, document);
+    generateOperationRequestBodyFunction(writer, field, document);
+    return writer.take();
 }
 
-std::string generateOperationResponseFunction(Field const & field, size_t indentation) {
-    std::string generated;
+std::string generateOperationRequestFunction(
+        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation, QueryFormat format) {
+    CodeWriter writer{indentation};
+    auto const document = generateQueryDocument(field, operation, typeMap, 0, format);
+    generateOperationRequestFunction(writer, field, document, FunctionPart::InlineDefinition, format);
+    return writer.take();
+}
 
-    auto const dataType = cppTypeName(field.type);
-    auto const errorsType = "std::vector<" + std::string{grapqlErrorTypeName} + ">";
-    auto const responseType = "GraphqlResponse<ResponseData>";
+void generateOperationResponseFunction(CodeWriter & writer, Field const & field, FunctionPart part) {
+    auto const & name = field.name.str();
 
-    generated += indent(indentation) + "using ResponseData = " + dataType + ";\n\n";
-    generated += indent(indentation) + "static " + responseType + " response(" + cppJsonTypeName + " const & json) {\n";
+    if (part == FunctionPart::Definition) {
+        writer.indent() << "GraphqlResponse<";
+        writeOperationTypeName(writer, field) << "::ResponseData> ";
+        writeOperationTypeName(writer, field) << "::response(" << cppJsonTypeName << " const & json) {\n";
+    } else {
+        writer.indent() << "using ResponseData = " << cppTypeName(field.type) << ";\n\n";
+        writer.indent() << "static GraphqlResponse<ResponseData> response(" << cppJsonTypeName << " const & json)";
+        if (part == FunctionPart::Declaration) {
+            writer << ";\n\n";
+            return;
+        }
+        writer << " {\n";
+    }
 
-    generated += indent(indentation + 1) + "auto errors = json.find(\"errors\");\n";
-    generated += indent(indentation + 1) + "if (errors != json.end()) {\n";
-    generated += indent(indentation + 2) + errorsType + " errorsList = " + "*errors;\n";
-    generated += indent(indentation + 2) + "return errorsList;\n";
-    generated += indent(indentation + 1) + "} else {\n";
+    writer.indent(1) << "auto errors = json.find(\"errors\");\n";
+    writer.indent(1) << "if (errors != json.end()) {\n";
+    writer.indent(2) << "std::vector<" << grapqlErrorTypeName << "> errorsList = *errors;\n";
+    writer.indent(2) << "return errorsList;\n";
+    writer.indent(1) << "} else {\n";
 
-    generated += indent(indentation + 2) + "auto const & data = json.at(\"data\");\n";
+    writer.indent(2) << "auto const & data = json.at(\"data\");\n";
 
-    if (field.type.kind == TypeKind::NonNull) {
-        generated += indent(indentation + 2) + "return ResponseData(data.at(\"" + field.name + "\"));\n";
+    if (field.type.kind() == TypeKind::NonNull) {
+        writer.indent(2) << "return ResponseData(data.at(\"" << name << "\"));\n";
     } else {
-        generated += indent(indentation + 2) + "auto it = data.find(\"" + field.name + "\");\n";
-        generated += indent(indentation + 2) + "if (it != data.end()) {\n";
-        generated += indent(indentation + 3) + "return ResponseData(*it);\n";
-        generated += indent(indentation + 2) + "} else {\n";
-        generated += indent(indentation + 3) + "return ResponseData{};\n";
-        generated += indent(indentation + 2) + "}\n";
+        writer.indent(2) << "auto it = data.find(\"" << name << "\");\n";
+        writer.indent(2) << "if (it != data.end()) {\n";
+        writer.indent(3) << "return it->get<ResponseData>();\n";
+        writer.indent(2) << "} else {\n";
+        writer.indent(3) << "return ResponseData{};\n";
+        writer.indent(2) << "}\n";
     }
 
-    generated += indent(indentation + 1) + "}\n";
+    writer.indent(1) << "}\n";
 
-    generated += indent(indentation) + "}\n\n";
+    writer.indent() << "}\n\n";
+}
 
-    return generated;
+std::string generateOperationResponseFunction(Field const & field, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateOperationResponseFunction(writer, field);
+    return writer.take();
 }
 
-std::string generateOperationType(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
-    auto const document = generateQueryDocument(field, operation, typeMap, 0);
+void generateOperationResponseDecoder(
+        CodeWriter & writer, Field const & field, FunctionPart part, ResponseDecoding decoding) {
+    auto const & name = field.name.str();
+    auto const isRequired = field.type.kind() == TypeKind::NonNull ? "true" : "false";
+
+    // Writes the `part` of a decodeResponse function taking `parameters`, which returns what `generateResult` writes.
+    auto generateFunction = [&](std::string_view parameters, auto && generateResult) {
+        if (part == FunctionPart::Definition) {
+            writer.indent() << "GraphqlResponse<";
+            writeOperationTypeName(writer, field) << "::ResponseData> ";
+            writeOperationTypeName(writer, field) << "::decodeResponse(" << parameters << ") {\n";
+        } else {
+            writer.indent() << "static GraphqlResponse<ResponseData> decodeResponse(" << parameters << ")";
+            if (part == FunctionPart::Declaration) {
+                writer << ";\n\n";
+                return;
+            }
+            writer << " {\n";
+        }
+
+        writer.indent(1) << "return ";
+        generateResult();
+        writer << ";\n";
+        writer.indent() << "}\n\n";
+    };
+
+    if (decoding == ResponseDecoding::OnDemand) {
+        generateFunction("simdjson::padded_string_view body", [&] {
+            writer << "decodeOnDemandResponse<ResponseData>(body, \"" << name << "\", " << isRequired << ")";
+        });
+        generateFunction("char const * body, size_t size", [&] {
+            writer << "decodeResponse(onDemandPaddedCopy(body, size))";
+        });
+    } else {
+        generateFunction("char const * body, size_t size", [&] {
+            writer << "decodeGraphqlResponse<ResponseData>(body, size, \"" << name << "\", " << isRequired << ")";
+        });
+    }
+
+    if (part != FunctionPart::Definition) {
+        writer.indent() << "static GraphqlResponse<ResponseData> decodeResponse(std::string const & body) {\n";
+        writer.indent(1) << "return decodeResponse(body.data(), body.size());\n";
+        writer.indent() << "}\n\n";
+    }
+}
 
-    std::string generated;
+void generateOperationType(
+        CodeWriter & writer,
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        FunctionPart part,
+        ResponseDecoding decoding,
+        QueryFormat format,
+        size_t maxDepth,
+        Json const * selection) {
+    auto const document = generateQueryDocument(field, operation, typeMap, 0, format, maxDepth, selection);
+
+    if (part == FunctionPart::Definition) {
+        generateOperationRequestFunction(writer, field, document, part, format);
+        generateOperationRequestBodyFunction(writer, field, document, part);
+        generateOperationResponseFunction(writer, field, part);
+        if (decoding != ResponseDecoding::Dom) {
+            generateOperationResponseDecoder(writer, field, part, decoding);
+        }
+        return;
+    }
 
-    generated += generateDescription(field.description, indentation);
-    generated += indent(indentation) + "struct " + capitalize(field.name) + "Field" + " {\n\n";
+    generateDescription(writer, field.description);
+    writer.indent() << "struct ";
+    writeOperationTypeName(writer, field) << " {\n\n";
 
-    generated += indent(indentation + 1) +
-                 "static Operation constexpr operation = Operation::" + capitalize(operationQueryName(operation)) +
-                 ";\n\n";
-    generated += generateOperationRequestFunction(field, operation, typeMap, indentation + 1);
-    generated += generateOperationResponseFunction(field, indentation + 1);
+    writer.indent(1) << "static Operation constexpr operation = Operation::";
+    writer.capitalized(operationQueryName(operation)) << ";\n\n";
 
-    generated += indent(indentation) + "};\n\n";
+    writer.increaseIndentation();
+    generateOperationRequestBodyPrefix(writer, document);
+    generateOperationRequestFunction(writer, field, document, part, format);
+    generateOperationRequestBodyFunction(writer, field, document, part);
+    generateOperationResponseFunction(writer, field, part);
+    if (decoding != ResponseDecoding::Dom) {
+        generateOperationResponseDecoder(writer, field, part, decoding);
+    }
+    writer.decreaseIndentation();
 
-    return generated;
+    writer.indent() << "};\n\n";
 }
 
-std::string generateOperationTypes(
-        Type const & type, Operation operation, TypeMap const & typeMap, size_t indentation) {
-    std::string generated;
+std::string generateOperationType(
+        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateOperationType(writer, field, operation, typeMap);
+    return writer.take();
+}
 
-    generated += indent(indentation) + "namespace " + type.name + " {\n\n";
+void generateOperationTypes(
+        CodeWriter & writer,
+        Type const & type,
+        Operation operation,
+        TypeMap const & typeMap,
+        FunctionPart part,
+        ResponseDecoding decoding,
+        QueryFormat format,
+        SelectionDepth const & depth) {
+    writer.indent() << "namespace " << type.name.str() << " {\n\n";
 
+    writer.increaseIndentation();
     for (auto const & field : type.fields) {
-        generated += generateOperationType(field, operation, typeMap, indentation + 1);
+        generateOperationType(
+                writer,
+                field,
+                operation,
+                typeMap,
+                part,
+                decoding,
+                format,
+                depth.maxDepthOf(type.name, field.name),
+                depth.selectionOf(type.name, field.name));
     }
+    writer.decreaseIndentation();
+
+    writer.indent() << "} // namespace " << type.name.str() << "\n\n";
+}
 
-    generated += indent(indentation) + "} // namespace " + type.name + "\n\n";
+std::string generateOperationTypes(
+        Type const & type, Operation operation, TypeMap const & typeMap, size_t indentation) {
+    CodeWriter writer{indentation};
+    generateOperationTypes(writer, type, operation, typeMap);
+    return writer.take();
+}
 
-    return generated;
+void generateGraphqlErrorType(CodeWriter & writer) {
+    writer.indent() << "struct " << grapqlErrorTypeName << " {\n";
+    writer.indent(1) << "std::string message;\n\n";
+    writer.indent(1) << "// Whether the server doesn't have the query of a persisted request, to send again with it.\n";
+    writer.indent(1) << "bool isPersistedQueryNotFound() const { return message == \"PersistedQueryNotFound\"; }\n";
+    writer.indent() << "};\n\n";
+    writer.indent() << "template <typename Data>\n";
+    writer.indent() << "using GraphqlResponse = variant<Data, std::vector<" << grapqlErrorTypeName << ">>;\n\n";
 }
 
 std::string generateGraphqlErrorType(size_t indentation) {
-    std::string generated;
-    generated += indent(indentation) + "struct " + grapqlErrorTypeName + " {\n";
-    generated += indent(indentation + 1) + "std::string message;\n";
-    generated += indent(indentation) + "};\n\n";
-    generated += indent(indentation) + "template <typename Data>\n";
-    generated += indent(indentation) + "using GraphqlResponse = variant<Data, std::vector<" + grapqlErrorTypeName +
-                 ">>;\n\n";
-
-    return generated;
+    CodeWriter writer{indentation};
+    generateGraphqlErrorType(writer);
+    return writer.take();
 }
 
-std::string generateGraphqlErrorDeserialization(size_t indentation) {
-    std::string generated;
+void generateGraphqlErrorDeserialization(CodeWriter & writer, FunctionPart part) {
+    if (part == FunctionPart::Declaration) {
+        generateDeserializationFunctionPrototype(writer, grapqlErrorTypeName);
+        return;
+    }
 
-    generated += generateDeserializationFunctionDeclaration(grapqlErrorTypeName, indentation);
-    generated += indent(indentation + 1) + "json.at(\"message\").get_to(value.message);\n";
-    generated += indent(indentation) + "}\n\n";
+    generateDeserializationFunctionDeclaration(writer, grapqlErrorTypeName, part);
+    writer.indent(1) << "json.at(\"message\").get_to(value.message);\n";
+    writer.indent() << "}\n\n";
+}
 
-    return generated;
+std::string generateGraphqlErrorDeserialization(size_t indentation) {
+    CodeWriter writer{indentation};
+    generateGraphqlErrorDeserialization(writer);
+    return writer.take();
 }
 
 std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace) {
@@ -839,33 +3769,25 @@ std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace) {
                                 std::to_string(static_cast<int>(algebraicNamespace))};
 }
 
-static std::string generateOptionalSerialization(AlgebraicNamespace algebraicNamespace) {
-    auto const namespaceName = algrebraicNamespaceName(algebraicNamespace);
-    char const * optionalInclude;
-    char const * variantInclude;
-
+static void generateAlgebraicIncludes(CodeWriter & writer, AlgebraicNamespace algebraicNamespace) {
     switch (algebraicNamespace) {
     case AlgebraicNamespace::Std:
-        optionalInclude = "<optional>";
-        variantInclude = "<variant>";
+        writer << "\n#include <optional>\n#include <string_view>\n#include <variant>\n\n";
         break;
 
     case AlgebraicNamespace::Absl:
-        optionalInclude = "\"absl/types/optional.h\"";
-        variantInclude = "\"absl/types/variant.h\"";
+        writer << "\n#include \"absl/strings/string_view.h\"\n#include \"absl/types/optional.h\"\n";
+        writer << "#include \"absl/types/variant.h\"\n\n";
         break;
     }
+}
 
-
-    auto format = R"(
-#include %s
-#include %s
-
-// optional serialization
+static void generateOptionalSerialization(CodeWriter & writer, AlgebraicNamespace algebraicNamespace) {
+    std::string serializer = R"(// optional serialization
 namespace nlohmann {
     template <typename T>
-    struct adl_serializer<%s::optional<T>> {
-        static void to_json(json & json, %s::optional<T> const & opt) {
+    struct adl_serializer<$Algebraic::optional<T>> {
+        static void to_json(json & json, $Algebraic::optional<T> const & opt) {
             if (opt.has_value()) {
                 json = *opt;
             } else {
@@ -873,7 +3795,7 @@ namespace nlohmann {
             }
         }
 
-        static void from_json(const json & json, %s::optional<T> & opt) {
+        static void from_json(const json & json, $Algebraic::optional<T> & opt) {
             if (json.is_null()) {
                 opt.reset();
             } else {
@@ -885,102 +3807,206 @@ namespace nlohmann {
 
 )";
 
-    std::string buffer(1000, '\0');
-    int len = snprintf(
-            &buffer[0],
-            buffer.size(),
-            format,
-            optionalInclude,
-            variantInclude,
-            namespaceName.c_str(),
-            namespaceName.c_str(),
-            namespaceName.c_str());
-    buffer.resize(len);
-    return buffer;
+    replaceAll(serializer, "$Algebraic", algrebraicNamespaceName(algebraicNamespace));
+    writer << serializer;
 }
 
-std::string generateTypes(
-        Schema const & schema, std::string const & generatedNamespace, AlgebraicNamespace algebraicNamespace) {
-    auto const sortedTypes = sortCustomTypesByDependencyOrder(schema.types);
+namespace {
+
+// Code generated from the read-only type map alone, so that chunks can be generated concurrently and then written in
+// order.
+struct Chunk {
+    enum class Kind {
+        Type,
+        // A recursive component, without any operation types
+        RecursiveComponent,
+        OperationTypesBegin,
+        OperationType,
+        OperationTypesEnd
+    };
 
-    TypeMap typeMap;
+    Kind kind;
+    // The type, the operation type, or the first type of the component
+    TypeIndex type;
+    // Operation types only
+    Operation operation = Operation::Query;
+    size_t field = 0;
+    // Recursive components only
+    TypeComponent component;
+};
+
+// A header of split output, generated from consecutive chunks
+struct SplitHeader {
+    Symbol name;
+    // Headers of the types the header's types depend on
+    std::vector<Symbol> includes;
+    // Types of a recursive component other than the first, whose headers only include this header
+    std::vector<Symbol> aliases;
+    size_t chunkCount = 0;
+};
+
+struct GenerationPlan {
+    std::vector<Chunk> chunks;
+    std::vector<SplitHeader> headers;
+};
+
+} // namespace
+
+static std::optional<Operation> operationOfType(Schema const & schema, Type const & type) {
+    auto isOperationType = [&](std::optional<Schema::OperationType> const & special) {
+        return special && special->name == type.name;
+    };
 
-    for (auto const & type : schema.types) {
-        typeMap[type.name] = type;
+    if (isOperationType(schema.queryType)) {
+        return Operation::Query;
+    } else if (isOperationType(schema.mutationType)) {
+        return Operation::Mutation;
+    } else if (isOperationType(schema.subscriptionType)) {
+        return Operation::Subscription;
     }
+    return std::nullopt;
+}
 
-    std::string source;
+// Splits the types into chunks in sorted order, and groups the chunks into a header per type, recursive component and
+// operation type. Root fields are chunks of their own, as the operation types of large schemas hold most of the code.
+static GenerationPlan planGeneration(
+        Schema const & schema, TypeMap const & typeMap, std::vector<TypeComponent> const & sortedComponents) {
+    GenerationPlan plan;
 
-    source +=
-            R"(// This file was automatically generated and should not be edited.
-#pragma once
+    auto const dependencies = customTypeDependencies(typeMap);
 
-#include <memory>
-#include <vector>
-#include "nlohmann/json.hpp")";
+    // Operation types generate namespaces rather than types, so nothing else includes them.
+    std::vector<std::optional<Operation>> operations(typeMap.size());
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        operations[index] = operationOfType(schema, typeMap.at(index));
+    }
 
-    source += generateOptionalSerialization(algebraicNamespace);
+    std::vector<Symbol> headerNames(typeMap.size());
 
-    source += "namespace " + generatedNamespace + " {\n\n";
+    auto addHeader = [&](std::vector<TypeIndex> const & types) {
+        auto & header = plan.headers.emplace_back();
+        header.name = typeMap.at(types.front()).name;
 
-    size_t typeIndentation = 1;
+        for (auto const index : types) {
+            headerNames[index] = header.name;
+            if (index != types.front()) {
+                header.aliases.push_back(typeMap.at(index).name);
+            }
+        }
 
-    source += indent(typeIndentation) + "using " + cppJsonTypeName + " = nlohmann::json;\n";
-    source += indent(typeIndentation) + "using " + cppIdTypeName + " = std::string;\n";
+        for (auto const index : types) {
+            for (auto const dependency : dependencies[index]) {
+                auto const & dependencyHeader = headerNames[dependency];
+                if (!operations[dependency] && dependencyHeader != header.name &&
+                    std::find(header.includes.begin(), header.includes.end(), dependencyHeader) ==
+                            header.includes.end()) {
+                    header.includes.push_back(dependencyHeader);
+                }
+            }
+        }
+    };
 
-    auto useAlgebraic = [&](char const * name) {
-        source +=
-                indent(typeIndentation) + "using " + algrebraicNamespaceName(algebraicNamespace) + "::" + name + ";\n";
+    auto addChunk = [&](Chunk chunk) {
+        plan.chunks.push_back(std::move(chunk));
+        ++plan.headers.back().chunkCount;
     };
 
-    useAlgebraic("optional");
-    useAlgebraic("variant");
-    useAlgebraic("monostate");
-    useAlgebraic("visit");
-    source += "\n";
+    auto addType = [&](TypeIndex index) {
+        auto const & type = typeMap.at(index);
+        addHeader({index});
+
+        if (auto const operation = operations[index]) {
+            addChunk({Chunk::Kind::OperationTypesBegin, index, *operation});
+            for (size_t field = 0; field < type.fields.size(); ++field) {
+                addChunk({Chunk::Kind::OperationType, index, *operation, field});
+            }
+            addChunk({Chunk::Kind::OperationTypesEnd, index, *operation});
+        } else {
+            addChunk({Chunk::Kind::Type, index});
+        }
+    };
+
+    for (auto const & component : sortedComponents) {
+        if (!component.isRecursive) {
+            addType(component.types.front());
+            continue;
+        }
 
-    source += indent(typeIndentation) + "enum class Operation { Query, Mutation, Subscription };\n\n";
+        TypeComponent declaredComponent{{}, true};
+        std::vector<TypeIndex> operationTypes;
+        for (auto const index : component.types) {
+            (operations[index] ? operationTypes : declaredComponent.types).push_back(index);
+        }
 
-    source += generateGraphqlErrorType(typeIndentation);
-    source += generateGraphqlErrorDeserialization(typeIndentation);
+        if (!declaredComponent.types.empty()) {
+            addHeader(declaredComponent.types);
+            auto const first = declaredComponent.types.front();
+            addChunk({Chunk::Kind::RecursiveComponent, first, Operation::Query, 0, std::move(declaredComponent)});
+        }
 
-    for (auto const & type : sortedTypes) {
-        auto isOperationType = [&](std::optional<Schema::OperationType> const & special) {
-            return special && special->name == type.name;
-        };
+        for (auto const index : operationTypes) {
+            addType(index);
+        }
+    }
+
+    return plan;
+}
 
+// Generates the `part` of a chunk's functions, along with its types unless `part` is FunctionPart::Definition.
+static void generateChunk(
+        CodeWriter & writer,
+        Chunk const & chunk,
+        TypeMap const & typeMap,
+        FunctionPart part,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    auto const & type = typeMap.at(chunk.type);
+    auto const definesTypes = part != FunctionPart::Definition;
+
+    // Only the references between the types of a recursive component are boxed. Types outside of it are complete
+    // wherever it references them, and are held by value.
+    BoxedTypes boxed;
+    for (auto const index : chunk.component.types) {
+        boxed.insert(typeMap.at(index).name);
+    }
+
+    switch (chunk.kind) {
+    case Chunk::Kind::Type:
         switch (type.kind) {
         case TypeKind::Object:
-            if (isOperationType(schema.queryType)) {
-                source += generateOperationTypes(type, Operation::Query, typeMap, typeIndentation);
-            } else if (isOperationType(schema.mutationType)) {
-                source += generateOperationTypes(type, Operation::Mutation, typeMap, typeIndentation);
-            } else if (isOperationType(schema.subscriptionType)) {
-                source += generateOperationTypes(type, Operation::Subscription, typeMap, typeIndentation);
-            } else {
-                source += generateObject(type, typeIndentation);
-                source += generateObjectDeserialization(type, typeIndentation);
+            if (definesTypes) {
+                generateObject(writer, type, boxed);
             }
+            generateObjectDeserialization(writer, type, boxed, part);
             break;
 
         case TypeKind::Interface:
-            source += generateInterface(type, typeIndentation);
-            source += generateInterfaceDeserialization(type, typeIndentation);
+            if (definesTypes) {
+                generateInterface(writer, type, boxed);
+            }
+            generateInterfaceDeserialization(writer, type, boxed, part);
             break;
 
         case TypeKind::Union:
-            source += generateUnion(type, typeIndentation);
-            source += generateUnionDeserialization(type, typeIndentation);
+            if (definesTypes) {
+                generateUnion(writer, type);
+            }
+            generateUnionDeserialization(writer, type, part);
             break;
 
         case TypeKind::Enum:
-            source += generateEnum(type, typeIndentation);
-            source += generateEnumSerialization(type, typeIndentation);
+            if (definesTypes) {
+                generateEnum(writer, type);
+            }
+            generateEnumSerialization(writer, type, part);
             break;
 
         case TypeKind::InputObject:
-            source += generateInputObject(type, typeIndentation);
-            source += generateInputObjectSerialization(type, typeIndentation);
+            if (definesTypes) {
+                generateInputObject(writer, type, boxed);
+            }
+            generateInputObjectSerialization(writer, type, part);
             break;
 
         case TypeKind::Scalar:
@@ -988,11 +4014,461 @@ std::string generateTypes(
         case TypeKind::NonNull:
             break;
         }
+        generateResponseDecoding(writer, type, boxed, part, decoding);
+        break;
+
+    case Chunk::Kind::RecursiveComponent:
+        generateRecursiveComponent(writer, chunk.component, typeMap, boxed, part);
+        if (decoding == ResponseDecoding::OnDemand && part != FunctionPart::Declaration) {
+            for (auto const index : chunk.component.types) {
+                generateOnDemandDecodingPrototypes(writer, typeMap.at(index), part);
+            }
+            writer << '\n';
+        }
+        for (auto const index : chunk.component.types) {
+            generateResponseDecoding(writer, typeMap.at(index), boxed, part, decoding);
+        }
+        break;
+
+    case Chunk::Kind::OperationTypesBegin:
+        writer.indent() << "namespace " << type.name.str() << " {\n\n";
+        break;
+
+    case Chunk::Kind::OperationType: {
+        auto const & field = type.fields[chunk.field];
+        writer.increaseIndentation();
+        generateOperationType(
+                writer,
+                field,
+                chunk.operation,
+                typeMap,
+                part,
+                decoding,
+                queryFormat,
+                depth.maxDepthOf(type.name, field.name),
+                depth.selectionOf(type.name, field.name));
+        writer.decreaseIndentation();
+        break;
+    }
+
+    case Chunk::Kind::OperationTypesEnd:
+        writer.indent() << "} // namespace " << type.name.str() << "\n\n";
+        break;
+    }
+}
+
+// Generates each chunk at `indentation`, and passes the chunks to `emit` in order along with their indices. With more
+// than one job, chunks are generated on that many threads, each taking the next ungenerated chunk as it finishes its
+// last, and are emitted as soon as every chunk before them has been. Threads don't run more than a few chunks ahead
+// of the emitted chunks, which bounds the chunks held at once.
+template <typename Emit>
+static void generateChunks(
+        std::vector<Chunk> const & chunks,
+        TypeMap const & typeMap,
+        FunctionPart part,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth,
+        size_t indentation,
+        size_t jobs,
+        Emit && emit) {
+    if (jobs <= 1 || chunks.size() <= 1) {
+        CodeWriter chunkWriter{indentation};
+        for (size_t index = 0; index < chunks.size(); ++index) {
+            generateChunk(chunkWriter, chunks[index], typeMap, part, decoding, queryFormat, depth);
+            emit(index, std::string_view{chunkWriter.str()});
+            chunkWriter.truncate(0);
+        }
+        return;
+    }
+
+    auto const maximumChunksAhead = jobs * 4;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::optional<std::string>> generated(chunks.size());
+    size_t nextChunk = 0;
+    size_t emittedChunks = 0;
+    std::exception_ptr error;
+
+    auto generate = [&] {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                changed.wait(lock, [&] {
+                    return error || nextChunk == chunks.size() || nextChunk < emittedChunks + maximumChunksAhead;
+                });
+                if (error || nextChunk == chunks.size()) {
+                    return;
+                }
+                index = nextChunk++;
+            }
+
+            std::optional<std::string> code;
+            std::exception_ptr chunkError;
+            try {
+                CodeWriter chunkWriter{indentation};
+                generateChunk(chunkWriter, chunks[index], typeMap, part, decoding, queryFormat, depth);
+                code = chunkWriter.take();
+            } catch (...) {
+                chunkError = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            if (chunkError) {
+                error = error ? error : chunkError;
+            } else {
+                generated[index] = std::move(code);
+            }
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(jobs);
+    for (size_t i = 0; i < jobs; ++i) {
+        threads.emplace_back(generate);
+    }
+
+    auto stop = [&](std::exception_ptr stopError) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            error = error ? error : stopError;
+            changed.notify_all();
+        }
+        for (auto & thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    };
+
+    try {
+        for (size_t index = 0; index < chunks.size(); ++index) {
+            std::string code;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                changed.wait(lock, [&] { return error || generated[index]; });
+                if (error) {
+                    break;
+                }
+                code = std::move(*generated[index]);
+                generated[index].reset();
+                ++emittedChunks;
+                changed.notify_all();
+            }
+
+            emit(index, std::string_view{code});
+        }
+    } catch (...) {
+        stop(std::current_exception());
+    }
+
+    stop(nullptr);
+}
+
+// Generates the runtime that the response decoding of generated types uses, if `decoding` needs one.
+static void generateResponseDecoder(CodeWriter & writer, BoxedTypes const & boxed, ResponseDecoding decoding) {
+    switch (decoding) {
+    case ResponseDecoding::Dom:
+        break;
+    case ResponseDecoding::Sax:
+        generateSaxDecoder(writer, boxed);
+        break;
+    case ResponseDecoding::OnDemand:
+        generateOnDemandDecoder(writer, boxed);
+        break;
+    }
+}
+
+static void generateGeneratedFileComment(CodeWriter & writer) {
+    writer << "// This file was automatically generated and should not be edited.\n#pragma once\n";
+}
+
+// Writes the includes and declarations every type depends on, leaving the generated namespace open.
+static void generateCommonDeclarations(
+        CodeWriter & writer,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        BoxedTypes const & boxed,
+        FunctionPart functions,
+        ResponseDecoding decoding) {
+    generateGeneratedFileComment(writer);
+
+    writer << R"(
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+)";
+
+    if (functions == FunctionPart::Declaration) {
+        writer << "#include \"nlohmann/json_fwd.hpp\"";
+    } else {
+        writer << "#include \"nlohmann/json.hpp\"";
+        if (decoding == ResponseDecoding::OnDemand) {
+            writer << "\n#include \"simdjson.h\"\n#include <bitset>";
+        }
     }
 
-    source += "} // namespace " + generatedNamespace + "\n";
+    if (!boxed.empty()) {
+        writer << "\n#include <mutex>\n#include <new>";
+    }
+
+    generateAlgebraicIncludes(writer, algebraicNamespace);
+
+    if (functions != FunctionPart::Declaration) {
+        generateOptionalSerialization(writer, algebraicNamespace);
+    } else if (decoding == ResponseDecoding::OnDemand) {
+        writer << "namespace simdjson {\nclass padded_string_view;\n}\n\n";
+    }
+
+    writer << "namespace " << generatedNamespace << " {\n\n";
+
+    writer.increaseIndentation();
+
+    writer.indent() << "using " << cppJsonTypeName << " = nlohmann::json;\n";
+    writer.indent() << "using " << cppIdTypeName << " = std::string;\n";
+
+    auto const algebraicNamespaceName = algrebraicNamespaceName(algebraicNamespace);
+    auto useAlgebraic = [&](char const * name) {
+        writer.indent() << "using " << algebraicNamespaceName << "::" << name << ";\n";
+    };
+
+    useAlgebraic("optional");
+    useAlgebraic("string_view");
+    useAlgebraic("variant");
+    useAlgebraic("monostate");
+    useAlgebraic("visit");
+    writer << '\n';
+
+    writer.indent() << "enum class Operation { Query, Mutation, Subscription };\n\n";
+
+    generateGraphqlErrorType(writer);
+    generateGraphqlErrorDeserialization(writer, functions);
+
+    if (!boxed.empty()) {
+        generateBoxedOptional(writer, functions);
+    }
+
+    generateJsonWriter(writer, boxed, functions);
+
+    if (functions != FunctionPart::Declaration) {
+        generateResponseDecoder(writer, boxed, decoding);
+    }
+}
+
+void generateTypes(
+        CodeWriter & writer,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs,
+        FunctionPart functions,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    TypeMap const typeMap{schema.types};
+    auto const sortedComponents = sortCustomTypeComponentsByDependencyOrder(typeMap);
+    auto const boxed = boxedTypes(sortedComponents, typeMap);
+    auto const plan = planGeneration(schema, typeMap, sortedComponents);
+
+    generateCommonDeclarations(writer, generatedNamespace, algebraicNamespace, boxed, functions, decoding);
+    writer.flush();
+
+    auto const emit = [&](size_t, std::string_view code) {
+        writer << code;
+        writer.flush();
+    };
+    generateChunks(
+            plan.chunks, typeMap, functions, decoding, queryFormat, depth, writer.indentation(), jobs, emit);
+
+    writer.decreaseIndentation();
+
+    writer << "} // namespace " << generatedNamespace << '\n';
+}
+
+std::string generateTypes(
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs,
+        FunctionPart functions,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    CodeWriter writer;
+    generateTypes(
+            writer, schema, generatedNamespace, algebraicNamespace, jobs, functions, decoding, queryFormat, depth);
+    return writer.take();
+}
+
+void generateSource(
+        CodeWriter & writer,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        std::string const & headerIncludePath,
+        size_t jobs,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    TypeMap const typeMap{schema.types};
+    auto const sortedComponents = sortCustomTypeComponentsByDependencyOrder(typeMap);
+    auto const boxed = boxedTypes(sortedComponents, typeMap);
+    auto const plan = planGeneration(schema, typeMap, sortedComponents);
+
+    writer << "// This file was automatically generated and should not be edited.\n";
+    writer << "#include \"" << headerIncludePath << "\"\n";
+    writer << "#include \"nlohmann/json.hpp\"\n";
+    if (decoding == ResponseDecoding::OnDemand) {
+        writer << "#include \"simdjson.h\"\n#include <bitset>\n";
+    }
+    writer << '\n';
+
+    generateOptionalSerialization(writer, algebraicNamespace);
+
+    writer << "namespace " << generatedNamespace << " {\n\n";
+    writer.increaseIndentation();
+
+    generateGraphqlErrorDeserialization(writer, FunctionPart::Definition);
+
+    if (!boxed.empty()) {
+        generateBoxedOptional(writer, FunctionPart::Definition);
+    }
+
+    generateJsonWriter(writer, boxed, FunctionPart::Definition);
+    generateResponseDecoder(writer, boxed, decoding);
+
+    writer.flush();
+
+    auto const emit = [&](size_t, std::string_view code) {
+        writer << code;
+        writer.flush();
+    };
+    auto const indentation = writer.indentation();
+    generateChunks(
+            plan.chunks,
+            typeMap,
+            FunctionPart::Definition,
+            decoding,
+            queryFormat,
+            depth,
+            indentation,
+            jobs,
+            emit);
+
+    writer.decreaseIndentation();
+
+    writer << "} // namespace " << generatedNamespace << '\n';
+}
+
+std::string generateSource(
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        std::string const & headerIncludePath,
+        size_t jobs,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    CodeWriter writer;
+    generateSource(writer,
+                   schema,
+                   generatedNamespace,
+                   algebraicNamespace,
+                   headerIncludePath,
+                   jobs,
+                   decoding,
+                   queryFormat,
+                   depth);
+    return writer.take();
+}
+
+static std::string headerFileName(Symbol name) { return name.str() + ".hpp"; }
+
+std::vector<std::string> generateSplitTypes(
+        HeaderSink const & writeHeader,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs,
+        FunctionPart functions,
+        ResponseDecoding decoding,
+        QueryFormat queryFormat,
+        SelectionDepth const & depth) {
+    TypeMap const typeMap{schema.types};
+    auto const sortedComponents = sortCustomTypeComponentsByDependencyOrder(typeMap);
+    auto const boxed = boxedTypes(sortedComponents, typeMap);
+    auto const plan = planGeneration(schema, typeMap, sortedComponents);
+
+    std::vector<std::string> headerNames{splitCommonHeaderName};
+    headerNames.reserve(plan.headers.size() + 1);
+
+    CodeWriter header;
+    generateCommonDeclarations(header, generatedNamespace, algebraicNamespace, boxed, functions, decoding);
+    header.decreaseIndentation();
+    header << "} // namespace " << generatedNamespace << '\n';
+    writeHeader(splitCommonHeaderName, header.str());
+
+    auto beginHeader = [&](SplitHeader const & splitHeader) {
+        header.truncate(0);
+        generateGeneratedFileComment(header);
+        header << "\n#include \"" << splitCommonHeaderName << "\"\n";
+        for (auto const & include : splitHeader.includes) {
+            header << "#include \"" << headerFileName(include) << "\"\n";
+        }
+        header << "\nnamespace " << generatedNamespace << " {\n\n";
+    };
+
+    auto endHeader = [&](SplitHeader const & splitHeader) {
+        header << "} // namespace " << generatedNamespace << '\n';
+        headerNames.push_back(headerFileName(splitHeader.name));
+        writeHeader(headerNames.back(), header.str());
+
+        for (auto const & alias : splitHeader.aliases) {
+            header.truncate(0);
+            generateGeneratedFileComment(header);
+            header << "\n#include \"" << headerFileName(splitHeader.name) << "\"\n";
+            writeHeader(headerFileName(alias), header.str());
+        }
+    };
+
+    size_t currentHeader = 0;
+    size_t remainingChunks = 0;
+
+    auto const emit = [&](size_t, std::string_view code) {
+        if (remainingChunks == 0) {
+            remainingChunks = plan.headers[currentHeader].chunkCount;
+            beginHeader(plan.headers[currentHeader]);
+        }
+
+        header << code;
+
+        if (--remainingChunks == 0) {
+            endHeader(plan.headers[currentHeader++]);
+        }
+    };
+    generateChunks(plan.chunks, typeMap, functions, decoding, queryFormat, depth, 1, jobs, emit);
+
+    return headerNames;
+}
+
+void generateUmbrellaHeader(CodeWriter & writer, std::vector<std::string> const & includePaths) {
+    generateGeneratedFileComment(writer);
+    writer << '\n';
+    for (auto const & path : includePaths) {
+        writer << "#include \"" << path << "\"\n";
+    }
+}
 
-    return source;
+std::string generateUmbrellaHeader(std::vector<std::string> const & includePaths) {
+    CodeWriter writer;
+    generateUmbrellaHeader(writer, includePaths);
+    return writer.take();
 }
 
 } // namespace caffql
@@ -1,6 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <unordered_set>
-#include "BoxedOptional.hpp"
+#include "CodeWriter.hpp"
+#include "Json.hpp"
+#include "Symbol.hpp"
 
 #define CAFFQL_DEFINE_EQUALS(T, equals)                                                                                \
     inline bool operator==(T const & lhs, T const & rhs) { equals }                                                    \
@@ -21,25 +26,72 @@ enum class Scalar {
     ID
 };
 
+// Reference to a type, stored flat: the named type under any NonNull and List wrappers, plus the stack of wrapper
+// modifiers from outermost to innermost packed one bit each. Trivially copyable, so unwrapping never allocates.
 struct TypeRef {
-    TypeKind kind;
-    std::optional<std::string> name;
+    static constexpr size_t maxModifierCount = 32;
+
+    TypeRef() = default;
+
+    // A named type, or a NonNull or List with no inner type.
+    TypeRef(TypeKind kind, std::optional<Symbol> name = std::nullopt)
+        : namedKind{kind}, isNamed{name.has_value()}, namedType{name.value_or(Symbol{})} {}
+
+    // Wraps `ofType` when `kind` is NonNull or List. Named kinds can't wrap another type, so `ofType` is ignored.
+    TypeRef(TypeKind kind, std::optional<Symbol> name, TypeRef const & ofType);
+
+    TypeKind kind() const { return modifierCount > 0 ? outermostModifier() : namedKind; }
+
+    bool hasName() const { return modifierCount == 0 && isNamed; }
+
+    // Empty for NonNull and List
+    Symbol name() const { return modifierCount == 0 ? namedType : Symbol{}; }
+
     // NonNull and List only
-    BoxedOptional<TypeRef> ofType;
+    bool hasOfType() const { return modifierCount > 0; }
+
+    TypeRef ofType() const;
 
-    TypeRef const & underlyingType() const {
-        if (ofType) {
-            return ofType->underlyingType();
-        }
-        return *this;
+    TypeRef underlyingType() const { return isNamed ? TypeRef{namedKind, namedType} : TypeRef{namedKind}; }
+
+    friend bool operator==(TypeRef const & lhs, TypeRef const & rhs) {
+        return lhs.modifiers == rhs.modifiers && lhs.modifierCount == rhs.modifierCount &&
+               lhs.namedKind == rhs.namedKind && lhs.isNamed == rhs.isNamed && lhs.namedType == rhs.namedType;
     }
+
+    friend bool operator!=(TypeRef const & lhs, TypeRef const & rhs) { return !(lhs == rhs); }
+
+private:
+    friend struct std::hash<TypeRef>;
+
+    // Bit i is set when the wrapper i levels in from the outside is a List, and clear for NonNull.
+    uint32_t modifiers = 0;
+    uint8_t modifierCount = 0;
+    TypeKind namedKind = TypeKind::Scalar;
+    bool isNamed = false;
+    Symbol namedType;
+
+    TypeKind outermostModifier() const { return (modifiers & 1) ? TypeKind::List : TypeKind::NonNull; }
 };
 
-CAFFQL_DEFINE_EQUALS(TypeRef, return lhs.kind == rhs.kind && lhs.name == rhs.name && lhs.ofType == rhs.ofType;)
+} // namespace caffql
+
+namespace std {
+template <>
+struct hash<caffql::TypeRef> {
+    size_t operator()(caffql::TypeRef const & type) const {
+        auto hash = std::hash<caffql::Symbol>{}(type.namedType);
+        hash ^= (size_t{type.modifiers} << 8 | size_t{type.modifierCount}) * 0x9e3779b97f4a7c15;
+        return hash ^ static_cast<size_t>(type.namedKind);
+    }
+};
+} // namespace std
+
+namespace caffql {
 
 struct InputValue {
     TypeRef type;
-    std::string name;
+    Symbol name;
     std::optional<std::string> description;
     // TODO: Default value
 };
@@ -49,7 +101,7 @@ CAFFQL_DEFINE_EQUALS(InputValue,
 
 struct Field {
     TypeRef type;
-    std::string name;
+    Symbol name;
     std::optional<std::string> description;
     std::vector<InputValue> args;
     // TODO: Deprecation
@@ -69,7 +121,7 @@ CAFFQL_DEFINE_EQUALS(EnumValue, return lhs.name == rhs.name && lhs.description =
 
 struct Type {
     TypeKind kind;
-    std::string name;
+    Symbol name;
     std::optional<std::string> description;
     // Object and Interface only
     std::vector<Field> fields;
@@ -96,7 +148,7 @@ enum class Operation { Query, Mutation, Subscription };
 struct Schema {
 
     struct OperationType {
-        std::string name;
+        Symbol name;
     };
 
     std::optional<OperationType> queryType;
@@ -106,7 +158,44 @@ struct Schema {
     // TODO: Directives
 };
 
-using TypeMap = std::unordered_map<std::string, Type>;
+CAFFQL_DEFINE_EQUALS(Schema::OperationType, return lhs.name == rhs.name;)
+
+CAFFQL_DEFINE_EQUALS(Schema,
+                     return lhs.queryType == rhs.queryType && lhs.mutationType == rhs.mutationType &&
+                            lhs.subscriptionType == rhs.subscriptionType && lhs.types == rhs.types;)
+
+// Dense index of a type within a TypeMap
+using TypeIndex = uint32_t;
+
+// Owns a schema's types and finds them by name. Lookup indexes a flat table by the name's symbol id, so it never
+// hashes or compares the text.
+struct TypeMap {
+    static constexpr TypeIndex npos = std::numeric_limits<TypeIndex>::max();
+
+    TypeMap() = default;
+
+    explicit TypeMap(std::vector<Type> types);
+
+    size_t size() const { return types.size(); }
+
+    std::vector<Type> const & all() const { return types; }
+
+    // npos if there is no type named `name`
+    TypeIndex find(Symbol name) const {
+        return name.id() < indicesBySymbolId.size() ? indicesBySymbolId[name.id()] : npos;
+    }
+
+    // Throws std::out_of_range if there is no type named `name`
+    TypeIndex indexOf(Symbol name) const;
+
+    Type const & at(TypeIndex index) const { return types.at(index); }
+
+    Type const & at(Symbol name) const { return types[indexOf(name)]; }
+
+private:
+    std::vector<Type> types;
+    std::vector<TypeIndex> indicesBySymbolId;
+};
 
 NLOHMANN_JSON_SERIALIZE_ENUM(
         TypeKind,
@@ -119,6 +208,8 @@ NLOHMANN_JSON_SERIALIZE_ENUM(
          {TypeKind::List, "LIST"},
          {TypeKind::NonNull, "NON_NULL"}});
 
+void from_json(Json const & json, Symbol & symbol);
+
 void from_json(Json const & json, TypeRef & type);
 
 void from_json(Json const & json, InputValue & input);
@@ -133,18 +224,103 @@ void from_json(Json const & json, Schema::OperationType & operationType);
 
 void from_json(Json const & json, Schema & schema);
 
+// Custom types that are declared together. The types of a recursive component reference each other, directly or
+// through other types of the component, so they are forward declared and held in a BoxedOptional wherever they are
+// members of each other.
+struct TypeComponent {
+    // Indices in the TypeMap, sorted alphabetically
+    std::vector<TypeIndex> types;
+    // More than one type, or a single type that references itself
+    bool isRecursive = false;
+};
+
+CAFFQL_DEFINE_EQUALS(TypeComponent, return lhs.types == rhs.types && lhs.isRecursive == rhs.isRecursive;)
+
+// Distinct custom types that each custom type depends on through its fields, their arguments, its input fields and its
+// possible types, indexed like `typeMap`. Metatypes, and all but the last of any types sharing a name, have no
+// dependencies and aren't depended on. References to types that aren't in `typeMap` are left to the compiler of the
+// generated code to report.
+std::vector<std::vector<TypeIndex>> customTypeDependencies(TypeMap const & typeMap);
+
+// Groups custom types into strongly connected components and sorts the components so that dependencies are before
+// dependents. Subsorts alphabetically by each component's first type so that sorting is deterministic. Runs in
+// O(n log n) for n types and their references.
+std::vector<TypeComponent> sortCustomTypeComponentsByDependencyOrder(TypeMap const & typeMap);
+
 // Sorts dependent types before their dependencies so types can be declared in the proper compilation order.
-// Subsorts alphabetically so that sorting is deterministic.
-std::vector<Type> sortCustomTypesByDependencyOrder(std::vector<Type> const & types);
+// Subsorts alphabetically so that sorting is deterministic. Returns the indices of the custom types in `typeMap`, with
+// the types of each recursive component kept together.
+std::vector<TypeIndex> sortCustomTypesByDependencyOrder(TypeMap const & typeMap);
+
+// Names of the types that are held in a BoxedOptional wherever they are members of the types being generated. Types are
+// only boxed in the other types of their own recursive component, so generating a component passes the names of its
+// types, and generating any other type passes none.
+using BoxedTypes = std::unordered_set<Symbol>;
+
+// Names of the types of every recursive component, which is only empty when the generated code needs no BoxedOptional.
+BoxedTypes boxedTypes(std::vector<TypeComponent> const & components, TypeMap const & typeMap);
 
-constexpr size_t spacesPerIndent = 4;
 constexpr auto unknownCaseName = "Unknown";
 constexpr auto cppJsonTypeName = "Json";
 constexpr auto cppIdTypeName = "Id";
 constexpr auto grapqlErrorTypeName = "GraphqlError";
+constexpr auto cppBoxedOptionalTypeName = "BoxedOptional";
 
 std::string indent(size_t indentation);
 
+// Which part of the generated (de)serialization, request and response functions to write. Generated headers either
+// define them inline, or only declare them for a generated source file to define, so that the JSON library is only
+// compiled into that file.
+enum class FunctionPart { InlineDefinition, Declaration, Definition };
+
+// How operation types decode responses. Dom only decodes them from json values. Sax also decodes them straight from
+// their text, driven by the JSON library's SAX parser, without building json values. OnDemand does so with simdjson's
+// On Demand API instead, which only parses the selected fields and skips the rest.
+enum class ResponseDecoding { Dom, Sax, OnDemand };
+
+// How operation types write their query documents. Indented queries are laid out for reading, with variables named
+// after the path to their argument. Compact queries have no insignificant whitespace, and name their variables with
+// compactVariableName, so they are smaller to send and quicker for servers to parse. Either way the parameters of the
+// request functions keep the descriptive names.
+enum class QueryFormat { Indented, Compact };
+
+// Limits on how deeply generated queries nest selection sets, counting the root field's selection set as the first
+// level. Fields that would need a selection set below the limit are left out, which only leaves response sizes
+// bounded when the types are generated from a schema passed through limitSelectionDepth with the same limits.
+//
+// Fields of types that are already being expanded are left out too, unless the operation's selection from a selection
+// manifest nests them explicitly with an object of fields. The generated types hold those fields in a BoxedOptional,
+// so they decode to null wherever they are left out.
+struct SelectionDepth {
+    // Limit of the operations without one of their own, or 0 for no limit
+    size_t maxDepth = 0;
+    // Limits of single operations, by their operation type's name and root field's name, with 0 for no limit
+    std::map<std::pair<Symbol, Symbol>, size_t> operationMaxDepths;
+    // Objects of fields that a selection manifest selects single operations with, by their operation type's name and
+    // root field's name
+    std::map<std::pair<Symbol, Symbol>, Json> operationSelections;
+
+    size_t maxDepthOf(Symbol operationType, Symbol rootField) const {
+        auto const limit = operationMaxDepths.find({operationType, rootField});
+        return limit == operationMaxDepths.end() ? maxDepth : limit->second;
+    }
+
+    // nullptr for operations without a selection
+    Json const * selectionOf(Symbol operationType, Symbol rootField) const {
+        auto const selection = operationSelections.find({operationType, rootField});
+        return selection == operationSelections.end() ? nullptr : &selection->second;
+    }
+
+    bool isLimited() const {
+        return maxDepth > 0 ||
+               std::any_of(operationMaxDepths.begin(), operationMaxDepths.end(), [](auto const & limit) {
+                   return limit.second > 0;
+               });
+    }
+};
+
+void generateDescription(CodeWriter & writer, std::optional<std::string> const & description);
+
 std::string generateDescription(std::optional<std::string> const & description, size_t indentation);
 
 std::string screamingSnakeCaseToPascalCase(std::string const & snake);
@@ -153,55 +329,221 @@ std::string capitalize(std::string string);
 
 std::string uncapitalize(std::string string);
 
+void generateEnum(CodeWriter & writer, Type const & type);
+
 std::string generateEnum(Type const & type, size_t indentation);
 
+// Generates a constexpr to_string_view, which is also generated with the declarations of the other functions, and a
+// from_string_view that dispatches on the value names with generateStringDispatch. to_json and from_json convert with
+// them, and like them map values that aren't strings or names of the enum to and from Unknown as json null.
+void generateEnumSerialization(
+        CodeWriter & writer, Type const & type, FunctionPart part = FunctionPart::InlineDefinition);
+
 std::string generateEnumSerialization(Type const & type, size_t indentation);
 
 Scalar scalarType(std::string const & name);
 
 std::string cppScalarName(Scalar scalar);
 
-std::string cppTypeName(TypeRef const & type, bool shouldCheckNullability = true);
+// Type spellings are memoized per distinct TypeRef, and the returned references remain valid for the life of the
+// process. Each thread also remembers the spellings it has looked up, so parallel generation doesn't contend for it.
+std::string const & cppTypeName(TypeRef const & type, bool shouldCheckNullability = true);
+
+std::string const & graphqlTypeName(TypeRef const & type);
 
-std::string graphqlTypeName(TypeRef const & type);
+// Spells a member whose named type is boxed, with the named type held in a BoxedOptional in place of the value or
+// optional it would otherwise be.
+std::string cppBoxedTypeName(TypeRef const & type, bool shouldCheckNullability = true);
+
+bool isBoxed(TypeRef const & type, BoxedTypes const & boxedTypes);
+
+// Spells a member of a type, boxing it if its named type is in `boxedTypes`.
+std::string cppMemberTypeName(TypeRef const & type, BoxedTypes const & boxedTypes);
+
+void cppVariant(CodeWriter & writer, std::vector<TypeRef> const & possibleTypes, std::string_view unknownTypeName);
 
 std::string cppVariant(std::vector<TypeRef> const & possibleTypes, std::string const & unknownTypeName);
 
+// Generates the statement of generateMatch for the name at index, run when a dispatched string equals that name.
+using DispatchMatch = std::function<std::string(size_t index)>;
+
+// Generates a dispatch that runs the statement of whichever of names the string expression subject equals, then
+// returns. It switches on the size of subject and then on the characters that tell names of that size apart, so
+// subject is compared with at most one name. Subjects that are none of the names fall through the dispatch.
+void generateStringDispatch(
+        CodeWriter & writer,
+        std::string_view subject,
+        std::vector<std::string_view> const & names,
+        DispatchMatch const & generateMatch);
+
+std::string generateStringDispatch(
+        std::string_view subject,
+        std::vector<std::string_view> const & names,
+        DispatchMatch const & generateMatch,
+        size_t indentation);
+
+void generateDeserializationFunctionDeclaration(
+        CodeWriter & writer, std::string_view typeName, FunctionPart part = FunctionPart::InlineDefinition);
+
 std::string generateDeserializationFunctionDeclaration(std::string const & typeName, size_t indentation);
 
-std::string generateFieldDeserialization(Field const & field, size_t indentation);
+// Boxed fields are deserialized as nullable even when they are non-null in the schema, as query generation omits
+// fields that would recurse.
+void generateFieldDeserialization(CodeWriter & writer, Field const & field, BoxedTypes const & boxedTypes = {});
+
+std::string generateFieldDeserialization(Field const & field, size_t indentation, BoxedTypes const & boxedTypes = {});
+
+void generateVariantDeserialization(
+        CodeWriter & writer,
+        Type const & type,
+        std::string_view constructUnknown,
+        FunctionPart part = FunctionPart::InlineDefinition);
 
 std::string generateVariantDeserialization(Type const & type, std::string const & constructUnknown, size_t indentation);
 
-std::string generateInterface(Type const & type, size_t indentation);
+void generateInterface(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes = {});
+
+std::string generateInterface(Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
+
+void generateInterfaceUnknownCaseDeserialization(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+std::string generateInterfaceUnknownCaseDeserialization(
+        Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
+
+void generateInterfaceDeserialization(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
 
-std::string generateInterfaceUnknownCaseDeserialization(Type const & type, size_t indentation);
+std::string generateInterfaceDeserialization(Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
 
-std::string generateInterfaceDeserialization(Type const & type, size_t indentation);
+void generateUnion(CodeWriter & writer, Type const & type);
 
 std::string generateUnion(Type const & type, size_t indentation);
 
+void generateUnionDeserialization(
+        CodeWriter & writer, Type const & type, FunctionPart part = FunctionPart::InlineDefinition);
+
 std::string generateUnionDeserialization(Type const & type, size_t indentation);
 
-std::string generateObject(Type const & type, size_t indentation);
+void generateObject(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes = {});
 
-std::string generateObjectDeserialization(Type const & type, size_t indentation);
+std::string generateObject(Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
 
-std::string generateInputObject(Type const & type, size_t indentation);
+void generateObjectDeserialization(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+std::string generateObjectDeserialization(Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
+
+void generateInputObject(CodeWriter & writer, Type const & type, BoxedTypes const & boxedTypes = {});
+
+std::string generateInputObject(Type const & type, size_t indentation, BoxedTypes const & boxedTypes = {});
+
+void generateInputObjectSerialization(
+        CodeWriter & writer, Type const & type, FunctionPart part = FunctionPart::InlineDefinition);
 
 std::string generateInputObjectSerialization(Type const & type, size_t indentation);
 
+// Pool backed nullable box that generated types hold the types of recursive components in. Its declaration part is the
+// class alone, and its definition part the (de)serialization templates, which need the complete JSON type.
+void generateBoxedOptional(CodeWriter & writer, FunctionPart part = FunctionPart::InlineDefinition);
+
+std::string generateBoxedOptional(size_t indentation);
+
+// The JsonWriter that generated write_json functions write request variables with, and the write_json functions of
+// the types that aren't generated. Its declaration part is the class and the templates, and its definition part the
+// functions that aren't templates.
+void generateJsonWriter(
+        CodeWriter & writer, BoxedTypes const & boxedTypes, FunctionPart part = FunctionPart::InlineDefinition);
+
+// Forward declares the types of a recursive component and their (de)serialization functions, then defines them. Unions
+// are declared first and interfaces defined last, as they hold their possible types by value. The definition part is
+// the (de)serialization functions alone.
+void generateRecursiveComponent(
+        CodeWriter & writer,
+        TypeComponent const & component,
+        TypeMap const & typeMap,
+        BoxedTypes const & boxedTypes,
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+std::string generateRecursiveComponent(
+        TypeComponent const & component, TypeMap const & typeMap, BoxedTypes const & boxedTypes, size_t indentation);
+
+// The SaxDecoder that generated saxDecode functions decode values with, and the saxDecode functions of the types that
+// aren't generated. Declared headers leave it to the generated source.
+void generateSaxDecoder(CodeWriter & writer, BoxedTypes const & boxedTypes);
+
+// The sax decoding of generated types only has definition parts, which a header that declares its functions omits.
+void generateObjectSaxDecoding(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+void generateInterfaceSaxDecoding(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+void generateUnionSaxDecoding(
+        CodeWriter & writer, Type const & type, FunctionPart part = FunctionPart::InlineDefinition);
+
+// The onDemandDecode functions of the types that aren't generated, and the response decoding of operations.
+void generateOnDemandDecoder(CodeWriter & writer, BoxedTypes const & boxedTypes);
+
+// Like the sax decoding, only has definition parts.
+void generateObjectOnDemandDecoding(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+void generateInterfaceOnDemandDecoding(
+        CodeWriter & writer,
+        Type const & type,
+        BoxedTypes const & boxedTypes = {},
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+void generateUnionOnDemandDecoding(
+        CodeWriter & writer, Type const & type, FunctionPart part = FunctionPart::InlineDefinition);
+
 std::string operationQueryName(Operation operation);
 
 struct QueryVariable {
-    std::string name;
+    // Descriptive name, which the parameters of the request functions are named
+    Symbol name;
     TypeRef type;
+    // Name that compact queries declare the variable as, and empty in indented queries
+    Symbol compactName;
+
+    // Name that the query declares the variable as, which keys it in the request's variables.
+    std::string const & queryName() const { return compactName.empty() ? name.str() : compactName.str(); }
 };
 
-CAFFQL_DEFINE_EQUALS(QueryVariable, return lhs.name == rhs.name && lhs.type == rhs.type;)
+CAFFQL_DEFINE_EQUALS(QueryVariable,
+                     return lhs.name == rhs.name && lhs.type == rhs.type && lhs.compactName == rhs.compactName;)
 
 std::string appendNameToVariablePrefix(std::string const & variablePrefix, std::string const & name);
 
+// Name of the variable at `index` of a compact query: the letters a to z and A to Z, then pairs of them, and so on, so
+// that no name is longer than it needs to be.
+std::string compactVariableName(size_t index);
+
+// Strips the insignificant whitespace of a generated selection set and replaces its variable references with the
+// compact names of `variables`. Generated selection sets reference each variable once, in the order of `variables`.
+std::string compactQuery(std::string_view query, std::vector<QueryVariable> const & variables);
+
+// Fields whose type is already being expanded are omitted from the selection set, so that expanding recursive types
+// terminates. Selection sets left without any fields select `__typename`.
 std::string generateQueryFields(
         Type const & type,
         TypeMap const & typeMap,
@@ -222,30 +564,191 @@ struct QueryDocument {
     std::vector<QueryVariable> variables;
 };
 
+// Selection sets that the query repeats are written once as named fragments, when that makes the query shorter, and
+// spread where they occur. Compact documents ignore `indentation`. A `maxDepth` other than 0 limits the depth of the
+// query's selection sets, and a `selection` from a selection manifest is followed, as SelectionDepth describes.
 QueryDocument generateQueryDocument(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        QueryFormat format = QueryFormat::Indented,
+        size_t maxDepth = 0,
+        Json const * selection = nullptr);
 
 bool shouldPassByReferenceToRequestFunction(TypeRef const & type);
 
+// `document` is the field's query document, generated with no indentation.
+void generateOperationRequestFunction(
+        CodeWriter & writer,
+        Field const & field,
+        QueryDocument const & document,
+        FunctionPart part = FunctionPart::InlineDefinition,
+        QueryFormat format = QueryFormat::Indented);
+
 std::string generateOperationRequestFunction(
-        Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        QueryFormat format = QueryFormat::Indented);
+
+// Name of the string_view constant holding the start of an operation's request body, up to the json of its variables.
+constexpr auto requestBodyPrefixName = "requestBodyPrefix";
+
+// Name of the string_view constant holding the hex SHA-256 of an operation's query, which automatic persisted query
+// requests send in place of the query.
+constexpr auto queryHashName = "queryHash";
+
+// Name of the string_view constant holding the start of an operation's persisted query request body, up to the query
+// or variables.
+constexpr auto persistedRequestBodyPrefixName = "persistedRequestBodyPrefix";
+
+// The query is escaped as a json string when it is generated, so building a request body only writes variables, which
+// writeVariables writes with a JsonWriter without building json values. writeRequestBody appends the body to a string
+// that can be reused between requests, and requestBody returns it. The persisted request body functions write
+// automatic persisted query requests, which send the hash of the query in place of the query, or along with it when
+// the server doesn't have it yet.
+void generateOperationRequestBodyPrefix(CodeWriter & writer, QueryDocument const & document);
+
+void generateOperationRequestBodyFunction(
+        CodeWriter & writer,
+        Field const & field,
+        QueryDocument const & document,
+        FunctionPart part = FunctionPart::InlineDefinition);
+
+// The request body prefix and function of the field's operation.
+std::string generateOperationRequestBodyFunction(
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        size_t indentation,
+        QueryFormat format = QueryFormat::Indented);
+
+void generateOperationResponseFunction(
+        CodeWriter & writer, Field const & field, FunctionPart part = FunctionPart::InlineDefinition);
+
+// decodeResponse functions decoding a response body with the SaxDecoder, or with simdjson On Demand.
+void generateOperationResponseDecoder(
+        CodeWriter & writer,
+        Field const & field,
+        FunctionPart part = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Sax);
 
 std::string generateOperationResponseFunction(Field const & field, size_t indentation);
 
+// The definition part is the operation type's request and response functions, defined outside of its struct.
+void generateOperationType(
+        CodeWriter & writer,
+        Field const & field,
+        Operation operation,
+        TypeMap const & typeMap,
+        FunctionPart part = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat format = QueryFormat::Indented,
+        size_t maxDepth = 0,
+        Json const * selection = nullptr);
+
 std::string generateOperationType(
         Field const & field, Operation operation, TypeMap const & typeMap, size_t indentation);
 
+void generateOperationTypes(
+        CodeWriter & writer,
+        Type const & type,
+        Operation operation,
+        TypeMap const & typeMap,
+        FunctionPart part = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat format = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
 std::string generateOperationTypes(Type const & type, Operation operation, TypeMap const & typeMap, size_t indentation);
 
+void generateGraphqlErrorType(CodeWriter & writer);
+
 std::string generateGraphqlErrorType(size_t indentation);
 
+void generateGraphqlErrorDeserialization(CodeWriter & writer, FunctionPart part = FunctionPart::InlineDefinition);
+
 std::string generateGraphqlErrorDeserialization(size_t indentation);
 
 enum class AlgebraicNamespace { Std, Absl };
 
 std::string algrebraicNamespaceName(AlgebraicNamespace algebraicNamespace);
 
+// Flushes the writer after each finished type, so a writer with a sink only ever holds the largest single type's code.
+// The trailing namespace close is left in the writer. With more than one job, types and root fields are generated on
+// that many threads, with output identical to generating them on one. With `functions` as FunctionPart::Declaration,
+// the header only includes nlohmann/json_fwd.hpp and declares the functions that generateSource defines.
+void generateTypes(
+        CodeWriter & writer,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs = 1,
+        FunctionPart functions = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat queryFormat = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
 std::string generateTypes(
-        Schema const & schema, std::string const & generatedNamespace, AlgebraicNamespace algebraicNamespace);
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs = 1,
+        FunctionPart functions = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat queryFormat = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
+// Defines the functions declared by the header that generateTypes or generateSplitTypes generate with
+// FunctionPart::Declaration, which the source includes as `headerIncludePath`.
+void generateSource(
+        CodeWriter & writer,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        std::string const & headerIncludePath,
+        size_t jobs = 1,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat queryFormat = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
+std::string generateSource(
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        std::string const & headerIncludePath,
+        size_t jobs = 1,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat queryFormat = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
+// Included by every header of split output. Hyphens can't appear in GraphQL names, so it can't share a type's name.
+constexpr auto splitCommonHeaderName = "caffql-common.hpp";
+
+// Receives each header of split output, named relative to the output directory.
+using HeaderSink = std::function<void(std::string const & headerName, std::string_view code)>;
+
+// Generates the code of generateTypes into a header per type and per operation namespace, each including only the
+// headers of the types it depends on, plus a common header that they all include. The types of a recursive component
+// are generated into the header of its first type, which the headers of the others include. Headers are passed to
+// `writeHeader` in dependency order, starting with the common header. Returns the names of the headers, other than
+// those that only include another, in that order.
+std::vector<std::string> generateSplitTypes(
+        HeaderSink const & writeHeader,
+        Schema const & schema,
+        std::string const & generatedNamespace,
+        AlgebraicNamespace algebraicNamespace,
+        size_t jobs = 1,
+        FunctionPart functions = FunctionPart::InlineDefinition,
+        ResponseDecoding decoding = ResponseDecoding::Dom,
+        QueryFormat queryFormat = QueryFormat::Indented,
+        SelectionDepth const & depth = {});
+
+// Includes every header of split output, for code that used the single header.
+void generateUmbrellaHeader(CodeWriter & writer, std::vector<std::string> const & includePaths);
+
+std::string generateUmbrellaHeader(std::vector<std::string> const & includePaths);
 
 } // namespace caffql
@@ -0,0 +1,22 @@
+#include "CodeWriter.hpp"
+#include <cctype>
+
+namespace caffql {
+
+CodeWriter & CodeWriter::capitalized(std::string_view text) {
+    if (!text.empty()) {
+        buffer.push_back(static_cast<char>(toupper(text.front())));
+        buffer.append(text.substr(1));
+    }
+    return *this;
+}
+
+CodeWriter & CodeWriter::uncapitalized(std::string_view text) {
+    if (!text.empty()) {
+        buffer.push_back(static_cast<char>(tolower(text.front())));
+        buffer.append(text.substr(1));
+    }
+    return *this;
+}
+
+} // namespace caffql
@@ -0,0 +1,77 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace caffql {
+
+constexpr size_t spacesPerIndent = 4;
+
+// Receives blocks of generated code as they are finished.
+using CodeSink = std::function<void(std::string_view code)>;
+
+// Builds generated code in a single growing buffer. Tracks the indentation of the code being written, so generators
+// append the pieces of each line directly instead of concatenating temporary strings. Writers with a sink hand their
+// code to it whenever they are flushed, so the buffer only holds the code written since.
+struct CodeWriter {
+    explicit CodeWriter(size_t indentation = 0) : currentIndentation{indentation} {}
+
+    explicit CodeWriter(CodeSink sink, size_t indentation = 0)
+        : currentIndentation{indentation}, sink{std::move(sink)} {}
+
+    // Begins a line at the current indentation, plus `extraLevels`.
+    CodeWriter & indent(size_t extraLevels = 0) {
+        buffer.append((currentIndentation + extraLevels) * spacesPerIndent, ' ');
+        return *this;
+    }
+
+    void increaseIndentation(size_t levels = 1) { currentIndentation += levels; }
+
+    void decreaseIndentation(size_t levels = 1) { currentIndentation -= levels; }
+
+    size_t indentation() const { return currentIndentation; }
+
+    CodeWriter & operator<<(std::string_view text) {
+        buffer.append(text);
+        return *this;
+    }
+
+    CodeWriter & operator<<(char character) {
+        buffer.push_back(character);
+        return *this;
+    }
+
+    // Writes `text` with its first character uppercased.
+    CodeWriter & capitalized(std::string_view text);
+
+    // Writes `text` with its first character lowercased.
+    CodeWriter & uncapitalized(std::string_view text);
+
+    size_t size() const { return buffer.size(); }
+
+    // Discards everything written after the first `size` characters. Sizes are only meaningful until the next flush.
+    void truncate(size_t size) { buffer.resize(size); }
+
+    std::string const & str() const { return buffer; }
+
+    // Moves the written code out, leaving the writer empty.
+    std::string take() { return std::move(buffer); }
+
+    void reserve(size_t capacity) { buffer.reserve(capacity); }
+
+    // Passes the code written so far to the sink, keeping the buffer's capacity for the code that follows. Does nothing
+    // without a sink.
+    void flush() {
+        if (sink) {
+            sink(buffer);
+            buffer.clear();
+        }
+    }
+
+private:
+    size_t currentIndentation;
+    std::string buffer;
+    CodeSink sink;
+};
+
+} // namespace caffql
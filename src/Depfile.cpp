@@ -0,0 +1,43 @@
+#include "Depfile.hpp"
+
+namespace caffql {
+
+static void appendEscapedPath(std::string & depfile, std::string const & path) {
+    for (auto const character : path) {
+        switch (character) {
+        case ' ':
+        case '#':
+            depfile += '\\';
+            break;
+        case '$':
+            depfile += '$';
+            break;
+        default:
+            break;
+        }
+        depfile += character;
+    }
+}
+
+std::string generateDepfile(std::vector<std::string> const & targets, std::vector<std::string> const & prerequisites) {
+    std::string depfile;
+
+    for (auto const & target : targets) {
+        if (!depfile.empty()) {
+            depfile += ' ';
+        }
+        appendEscapedPath(depfile, target);
+    }
+    depfile += ':';
+
+    for (auto const & prerequisite : prerequisites) {
+        depfile += " \\\n    ";
+        appendEscapedPath(depfile, prerequisite);
+    }
+
+    depfile += '\n';
+
+    return depfile;
+}
+
+} // namespace caffql
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace caffql {
+
+// Make style dependency file, read by Make and Ninja, naming the files `targets` were generated from, so that build
+// systems regenerate them when any of them change. Spaces, #s and $s in paths are escaped.
+std::string generateDepfile(std::vector<std::string> const & targets, std::vector<std::string> const & prerequisites);
+
+} // namespace caffql
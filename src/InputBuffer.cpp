@@ -0,0 +1,139 @@
+#include "InputBuffer.hpp"
+#include <cerrno>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define CAFFQL_HAS_MMAP 1
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#else
+#    define CAFFQL_HAS_MMAP 0
+#    include <fstream>
+#    include <iostream>
+#endif
+
+namespace caffql {
+
+static std::system_error fileError(std::string const & description, std::string const & path) {
+    return std::system_error{errno, std::generic_category(), description + " " + path};
+}
+
+#if CAFFQL_HAS_MMAP
+
+namespace {
+
+struct FileDescriptor {
+    int fd;
+    // Standard input is borrowed and stays open
+    bool isOwned;
+
+    ~FileDescriptor() {
+        if (isOwned && fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+} // namespace
+
+static std::string readAll(int fd, size_t sizeHint, std::string const & path) {
+    std::string contents;
+    contents.reserve(sizeHint);
+
+    constexpr size_t chunkSize = 1 << 16;
+    while (true) {
+        auto const offset = contents.size();
+        contents.resize(offset + chunkSize);
+        auto const count = read(fd, &contents[offset], chunkSize);
+        if (count < 0) {
+            if (errno == EINTR) {
+                contents.resize(offset);
+                continue;
+            }
+            throw fileError("Unable to read", path);
+        }
+        contents.resize(offset + static_cast<size_t>(count));
+        if (count == 0) {
+            return contents;
+        }
+    }
+}
+
+InputBuffer InputBuffer::open(std::string const & path, InputMode mode) {
+    InputBuffer buffer;
+
+    auto const isStandardInput = path == standardInputPath;
+    FileDescriptor file{isStandardInput ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY), !isStandardInput};
+    if (file.fd < 0) {
+        throw fileError("Unable to open", path);
+    }
+
+    struct stat status;
+    if (fstat(file.fd, &status) != 0) {
+        throw fileError("Unable to stat", path);
+    }
+
+    auto const isRegularFile = S_ISREG(status.st_mode);
+    auto const size = isRegularFile ? static_cast<size_t>(status.st_size) : 0;
+
+    // mmap rejects empty mappings, and empty inputs have nothing to copy anyway.
+    if (mode == InputMode::Mapped && isRegularFile && size > 0) {
+        auto const mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+        if (mapping != MAP_FAILED) {
+            // The schema is parsed front to back exactly once.
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            madvise(mapping, size, MADV_WILLNEED);
+            buffer.mapping = mapping;
+            buffer.mappingSize = size;
+            return buffer;
+        }
+    }
+
+    buffer.owned = readAll(file.fd, size, path);
+    return buffer;
+}
+
+void InputBuffer::reset() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+    owned.clear();
+}
+
+#else
+
+InputBuffer InputBuffer::open(std::string const & path, InputMode) {
+    InputBuffer buffer;
+
+    if (path == standardInputPath) {
+        buffer.owned.assign(std::istreambuf_iterator<char>{std::cin}, std::istreambuf_iterator<char>{});
+        return buffer;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw fileError("Unable to open", path);
+    }
+    buffer.owned.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    return buffer;
+}
+
+void InputBuffer::reset() { owned.clear(); }
+
+#endif
+
+InputBuffer & InputBuffer::operator=(InputBuffer && buffer) {
+    reset();
+    mapping = buffer.mapping;
+    mappingSize = buffer.mappingSize;
+    owned = std::move(buffer.owned);
+    buffer.mapping = nullptr;
+    buffer.mappingSize = 0;
+    return *this;
+}
+
+} // namespace caffql
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace caffql {
+
+enum class InputMode {
+    // Memory map regular files where the platform supports it, falling back to reading for anything else
+    Mapped,
+    // Always read the input into an owned buffer
+    Buffered
+};
+
+constexpr auto standardInputPath = "-";
+
+// Read-only contiguous view of an input file's contents. Regular files are memory mapped in `InputMode::Mapped`;
+// pipes, character devices, standard input (`standardInputPath`) and platforms without mmap are read into an owned
+// buffer instead. Throws std::system_error if the input can't be opened or read.
+struct InputBuffer {
+
+    static InputBuffer open(std::string const & path, InputMode mode);
+
+    InputBuffer() = default;
+
+    InputBuffer(InputBuffer const &) = delete;
+
+    InputBuffer & operator=(InputBuffer const &) = delete;
+
+    InputBuffer(InputBuffer && buffer) { *this = std::move(buffer); }
+
+    InputBuffer & operator=(InputBuffer && buffer);
+
+    ~InputBuffer() { reset(); }
+
+    void reset();
+
+    bool isMapped() const { return mapping != nullptr; }
+
+    char const * data() const { return isMapped() ? static_cast<char const *>(mapping) : owned.data(); }
+
+    size_t size() const { return isMapped() ? mappingSize : owned.size(); }
+
+    std::string_view view() const { return {data(), size()}; }
+
+private:
+    void * mapping = nullptr;
+    size_t mappingSize = 0;
+    std::string owned;
+};
+
+} // namespace caffql
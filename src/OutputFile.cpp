@@ -0,0 +1,237 @@
+#include "OutputFile.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define CAFFQL_HAS_POSIX_IO 1
+#    include <fcntl.h>
+#    include <unistd.h>
+#else
+#    define CAFFQL_HAS_POSIX_IO 0
+#    include <random>
+#endif
+
+namespace caffql {
+
+static std::system_error fileError(std::string const & description, std::string const & path) {
+    return std::system_error{errno, std::generic_category(), description + " " + path};
+}
+
+// Distinguishes the temporary files of the outputs a process writes concurrently.
+static std::atomic<unsigned> temporaryFileCount{0};
+
+#if CAFFQL_HAS_POSIX_IO
+
+bool OutputFile::hasTemporaryFile() const { return fd >= 0; }
+
+void OutputFile::openTemporaryFile() {
+    // Concurrent runs writing the same output each get their own temporary file, named after their process. Creating
+    // it exclusively retries with the next name should a file of that name be left over.
+    while (true) {
+        temporaryPath = path + '.' + std::to_string(getpid()) + '.' + std::to_string(temporaryFileCount++) + ".tmp";
+        fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            return;
+        }
+        if (errno != EEXIST) {
+            throw fileError("Unable to create", temporaryPath);
+        }
+    }
+}
+
+void OutputFile::closeTemporaryFile() {
+    auto const result = ::close(fd);
+    fd = -1;
+    if (result != 0) {
+        throw fileError("Unable to close", temporaryPath);
+    }
+}
+
+void OutputFile::writeToFile(std::string_view data) {
+    while (!data.empty()) {
+        auto const count = ::write(fd, data.data(), data.size());
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw fileError("Unable to write", temporaryPath);
+        }
+        data.remove_prefix(static_cast<size_t>(count));
+    }
+}
+
+void OutputFile::discard() {
+    if (hasTemporaryFile()) {
+        ::close(fd);
+        fd = -1;
+        std::remove(temporaryPath.c_str());
+    }
+    path.clear();
+    existing.reset();
+}
+
+OutputFile & OutputFile::operator=(OutputFile && file) {
+    discard();
+    fd = file.fd;
+    file.fd = -1;
+    path = std::move(file.path);
+    temporaryPath = std::move(file.temporaryPath);
+    buffer = std::move(file.buffer);
+    existing = std::move(file.existing);
+    matchedSize = file.matchedSize;
+    isDiverged = file.isDiverged;
+    file.path.clear();
+    return *this;
+}
+
+#else
+
+bool OutputFile::hasTemporaryFile() const { return stream != nullptr; }
+
+void OutputFile::openTemporaryFile() {
+    static auto const processId = std::random_device{}();
+    temporaryPath = path + '.' + std::to_string(processId) + '.' + std::to_string(temporaryFileCount++) + ".tmp";
+    stream = std::fopen(temporaryPath.c_str(), "wb");
+    if (!stream) {
+        throw fileError("Unable to create", temporaryPath);
+    }
+    // Writes are already buffered here.
+    std::setvbuf(stream, nullptr, _IONBF, 0);
+}
+
+void OutputFile::closeTemporaryFile() {
+    auto const result = std::fclose(stream);
+    stream = nullptr;
+    if (result != 0) {
+        throw fileError("Unable to close", temporaryPath);
+    }
+}
+
+void OutputFile::writeToFile(std::string_view data) {
+    if (std::fwrite(data.data(), 1, data.size(), stream) != data.size()) {
+        throw fileError("Unable to write", temporaryPath);
+    }
+}
+
+void OutputFile::discard() {
+    if (hasTemporaryFile()) {
+        std::fclose(stream);
+        stream = nullptr;
+        std::remove(temporaryPath.c_str());
+    }
+    path.clear();
+    existing.reset();
+}
+
+OutputFile & OutputFile::operator=(OutputFile && file) {
+    discard();
+    stream = file.stream;
+    file.stream = nullptr;
+    path = std::move(file.path);
+    temporaryPath = std::move(file.temporaryPath);
+    buffer = std::move(file.buffer);
+    existing = std::move(file.existing);
+    matchedSize = file.matchedSize;
+    isDiverged = file.isDiverged;
+    file.path.clear();
+    return *this;
+}
+
+#endif
+
+OutputFile OutputFile::create(std::string const & path) {
+    OutputFile file;
+    file.path = path;
+
+    // Missing or unreadable outputs are always replaced. Here "-" names a file rather than standard input.
+    auto hasExisting = false;
+    if (path != standardInputPath) {
+        try {
+            file.existing = InputBuffer::open(path, InputMode::Mapped);
+            hasExisting = true;
+        } catch (std::system_error const &) {
+        }
+    }
+
+    if (!hasExisting) {
+        file.diverge();
+    }
+
+    return file;
+}
+
+void OutputFile::diverge() {
+    openTemporaryFile();
+    isDiverged = true;
+    buffer.reserve(bufferSize);
+    write(existing.view().substr(0, matchedSize));
+    existing.reset();
+}
+
+void OutputFile::write(std::string_view data) {
+    if (!isDiverged) {
+        auto const remaining = existing.view().substr(matchedSize);
+        if (remaining.size() >= data.size() && std::memcmp(remaining.data(), data.data(), data.size()) == 0) {
+            matchedSize += data.size();
+            return;
+        }
+        diverge();
+    }
+
+    if (buffer.size() + data.size() > bufferSize) {
+        flush();
+    }
+
+    // Blocks larger than the buffer would only be copied through it in pieces.
+    if (data.size() >= bufferSize) {
+        writeToFile(data);
+    } else {
+        buffer.append(data);
+    }
+}
+
+void OutputFile::flush() {
+    writeToFile(buffer);
+    buffer.clear();
+}
+
+bool OutputFile::close() {
+    // Output that stops short of the end of the existing file differs from it too.
+    if (!isDiverged && matchedSize != existing.size()) {
+        diverge();
+    }
+
+    auto const isChanged = isDiverged;
+    if (isChanged) {
+        std::error_code error;
+        try {
+            flush();
+            closeTemporaryFile();
+            // Replaced outputs keep their permissions rather than taking the temporary file's.
+            auto const status = std::filesystem::status(path, error);
+            if (!error && std::filesystem::exists(status)) {
+                std::filesystem::permissions(temporaryPath, status.permissions(), error);
+            }
+            error.clear();
+            std::filesystem::rename(temporaryPath, path, error);
+        } catch (...) {
+            discard();
+            std::remove(temporaryPath.c_str());
+            throw;
+        }
+
+        if (error) {
+            discard();
+            std::remove(temporaryPath.c_str());
+            throw std::system_error{error, "Unable to replace " + path};
+        }
+    }
+
+    discard();
+    return isChanged;
+}
+
+} // namespace caffql
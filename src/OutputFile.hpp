@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "InputBuffer.hpp"
+
+namespace caffql {
+
+// Buffered writer that replaces an output file only if its contents change, so that unchanged outputs keep their
+// modification times and don't trigger rebuilds. Output is compared against the existing file as it is written, and
+// nothing is written to disk unless it differs. From the first difference on, output is written to a temporary file
+// beside the output through a fixed size buffer, and closing renames the temporary file over the output. Each file has
+// its own uniquely named temporary file, so concurrent runs writing the same output never mix their contents. Throws
+// std::system_error if the output can't be written. Files that are destroyed without being closed leave the output
+// untouched.
+struct OutputFile {
+
+    static constexpr size_t bufferSize = 1 << 16;
+
+    static OutputFile create(std::string const & path);
+
+    OutputFile() = default;
+
+    OutputFile(OutputFile const &) = delete;
+
+    OutputFile & operator=(OutputFile const &) = delete;
+
+    OutputFile(OutputFile && file) { *this = std::move(file); }
+
+    OutputFile & operator=(OutputFile && file);
+
+    ~OutputFile() { discard(); }
+
+    bool isOpen() const { return !path.empty(); }
+
+    void write(std::string_view data);
+
+    // Replaces the output if its contents changed and closes the file. Returns whether the output was replaced.
+    bool close();
+
+private:
+    // Begins writing to the temporary file, starting with the output that matched the existing file.
+    void diverge();
+
+    bool hasTemporaryFile() const;
+
+    void openTemporaryFile();
+
+    void closeTemporaryFile();
+
+    void flush();
+
+    void writeToFile(std::string_view data);
+
+    void discard();
+
+    std::string path;
+    std::string temporaryPath;
+    std::string buffer;
+    // Contents of the output before it is replaced
+    InputBuffer existing;
+    size_t matchedSize = 0;
+    bool isDiverged = false;
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = -1;
+#else
+    std::FILE * stream = nullptr;
+#endif
+};
+
+} // namespace caffql
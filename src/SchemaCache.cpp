@@ -0,0 +1,454 @@
+#include "SchemaCache.hpp"
+#include <cstring>
+#include <filesystem>
+#include "InputBuffer.hpp"
+#include "OutputFile.hpp"
+#include "SchemaLoader.hpp"
+
+namespace caffql {
+
+namespace {
+
+constexpr char cacheMagic[8] = {'C', 'A', 'F', 'F', 'Q', 'L', 'S', 'C'};
+// Caches are written in native byte order and rejected on machines that disagree.
+constexpr uint32_t byteOrderMark = 0x01020304;
+// String id 0 represents a null optional string.
+constexpr uint32_t nullString = 0;
+
+struct Range {
+    uint32_t first;
+    uint32_t count;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceHash;
+    uint32_t queryType;
+    uint32_t mutationType;
+    uint32_t subscriptionType;
+    // Including the null string
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t typeCount;
+    uint32_t fieldCount;
+    uint32_t inputValueCount;
+    uint32_t enumValueCount;
+    uint32_t typeRefCount;
+};
+
+// Mirrors TypeRef's flat representation.
+struct TypeRefRecord {
+    uint32_t modifiers;
+    uint8_t modifierCount;
+    uint8_t kind;
+    uint16_t reserved;
+    uint32_t name;
+};
+
+struct InputValueRecord {
+    uint32_t name;
+    uint32_t description;
+    TypeRefRecord type;
+};
+
+struct FieldRecord {
+    uint32_t name;
+    uint32_t description;
+    TypeRefRecord type;
+    Range args;
+};
+
+struct EnumValueRecord {
+    uint32_t name;
+    uint32_t description;
+};
+
+struct TypeRecord {
+    uint32_t kind;
+    uint32_t name;
+    uint32_t description;
+    Range fields;
+    Range inputFields;
+    // Ranges of TypeRefs
+    Range interfaces;
+    Range enumValues;
+    Range possibleTypes;
+};
+
+uint32_t checkedCount(size_t count) {
+    if (count > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error{"Schema is too large to cache"};
+    }
+    return static_cast<uint32_t>(count);
+}
+
+class CacheWriter {
+public:
+    std::string write(Schema const & schema, uint64_t sourceHash) {
+        Header header{};
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = schemaCacheVersion;
+        header.byteOrder = byteOrderMark;
+        header.sourceHash = sourceHash;
+
+        auto operationType = [&](std::optional<Schema::OperationType> const & type) {
+            return type ? string(type->name) : nullString;
+        };
+        header.queryType = operationType(schema.queryType);
+        header.mutationType = operationType(schema.mutationType);
+        header.subscriptionType = operationType(schema.subscriptionType);
+
+        for (auto const & type : schema.types) {
+            addType(type);
+        }
+
+        std::vector<uint32_t> stringOffsets;
+        stringOffsets.reserve(strings.size() + 1);
+        size_t stringBytes = 0;
+        for (auto const string : strings) {
+            stringOffsets.push_back(checkedCount(stringBytes));
+            stringBytes += string.size();
+        }
+        stringOffsets.push_back(checkedCount(stringBytes));
+
+        header.stringCount = checkedCount(strings.size());
+        header.stringBytes = checkedCount(stringBytes);
+        header.typeCount = checkedCount(types.size());
+        header.fieldCount = checkedCount(fields.size());
+        header.inputValueCount = checkedCount(inputValues.size());
+        header.enumValueCount = checkedCount(enumValues.size());
+        header.typeRefCount = checkedCount(typeRefs.size());
+
+        std::string cache;
+        append(cache, &header, sizeof(header));
+        appendSection(cache, stringOffsets);
+        for (auto const string : strings) {
+            cache.append(string);
+        }
+        appendSection(cache, types);
+        appendSection(cache, fields);
+        appendSection(cache, inputValues);
+        appendSection(cache, enumValues);
+        appendSection(cache, typeRefs);
+        return cache;
+    }
+
+private:
+    std::vector<std::string_view> strings{std::string_view{}};
+    std::unordered_map<std::string_view, uint32_t> stringIds;
+    std::vector<TypeRecord> types;
+    std::vector<FieldRecord> fields;
+    std::vector<InputValueRecord> inputValues;
+    std::vector<EnumValueRecord> enumValues;
+    std::vector<TypeRefRecord> typeRefs;
+
+    static void append(std::string & cache, void const * data, size_t size) {
+        cache.append(static_cast<char const *>(data), size);
+    }
+
+    template <typename T>
+    static void appendSection(std::string & cache, std::vector<T> const & records) {
+        append(cache, records.data(), records.size() * sizeof(T));
+    }
+
+    uint32_t string(std::string const & string) {
+        auto const [it, inserted] = stringIds.emplace(string, static_cast<uint32_t>(strings.size()));
+        if (inserted) {
+            strings.push_back(string);
+        }
+        return it->second;
+    }
+
+    uint32_t string(std::optional<std::string> const & optionalString) {
+        return optionalString ? string(*optionalString) : nullString;
+    }
+
+    uint32_t string(Symbol symbol) { return string(symbol.str()); }
+
+    TypeRefRecord typeRef(TypeRef const & type) {
+        auto const underlyingType = type.underlyingType();
+        TypeRefRecord record{0,
+                             0,
+                             static_cast<uint8_t>(underlyingType.kind()),
+                             0,
+                             underlyingType.hasName() ? string(underlyingType.name()) : nullString};
+        for (auto wrapper = type; wrapper.hasOfType(); wrapper = wrapper.ofType()) {
+            if (wrapper.kind() == TypeKind::List) {
+                record.modifiers |= uint32_t{1} << record.modifierCount;
+            }
+            ++record.modifierCount;
+        }
+        return record;
+    }
+
+    Range typeRefList(std::vector<TypeRef> const & list) {
+        Range range{checkedCount(typeRefs.size()), checkedCount(list.size())};
+        for (auto const & type : list) {
+            typeRefs.push_back(typeRef(type));
+        }
+        return range;
+    }
+
+    InputValueRecord inputValue(InputValue const & value) {
+        return {string(value.name), string(value.description), typeRef(value.type)};
+    }
+
+    Range inputValueList(std::vector<InputValue> const & list) {
+        Range range{checkedCount(inputValues.size()), checkedCount(list.size())};
+        for (auto const & value : list) {
+            inputValues.push_back(inputValue(value));
+        }
+        return range;
+    }
+
+    void addType(Type const & type) {
+        TypeRecord record{static_cast<uint32_t>(type.kind), string(type.name), string(type.description)};
+
+        record.fields = {checkedCount(fields.size()), checkedCount(type.fields.size())};
+        for (auto const & field : type.fields) {
+            fields.push_back(
+                    {string(field.name), string(field.description), typeRef(field.type), inputValueList(field.args)});
+        }
+
+        record.inputFields = inputValueList(type.inputFields);
+        record.interfaces = typeRefList(type.interfaces);
+
+        record.enumValues = {checkedCount(enumValues.size()), checkedCount(type.enumValues.size())};
+        for (auto const & value : type.enumValues) {
+            enumValues.push_back({string(value.name), string(value.description)});
+        }
+
+        record.possibleTypes = typeRefList(type.possibleTypes);
+
+        types.push_back(record);
+    }
+};
+
+class CacheReader {
+public:
+    explicit CacheReader(std::string_view cache) : cache{cache} {}
+
+    std::optional<Schema> read(uint64_t sourceHash) {
+        Header header;
+        if (!readSection(&header, 1) || std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+            header.version != schemaCacheVersion || header.byteOrder != byteOrderMark ||
+            header.sourceHash != sourceHash || header.stringCount == 0) {
+            return std::nullopt;
+        }
+
+        if (!readSection(stringOffsets, size_t{header.stringCount} + 1) || stringOffsets.front() != 0 ||
+            stringOffsets.back() != header.stringBytes || header.stringBytes > remaining()) {
+            return std::nullopt;
+        }
+        for (size_t i = 1; i < stringOffsets.size(); ++i) {
+            if (stringOffsets[i] < stringOffsets[i - 1]) {
+                return std::nullopt;
+            }
+        }
+        stringBytes = cache.substr(offset, header.stringBytes);
+        offset += header.stringBytes;
+
+        if (!readSection(types, header.typeCount) || !readSection(fields, header.fieldCount) ||
+            !readSection(inputValues, header.inputValueCount) || !readSection(enumValues, header.enumValueCount) ||
+            !readSection(typeRefs, header.typeRefCount) || remaining() != 0) {
+            return std::nullopt;
+        }
+
+        try {
+            Schema schema;
+
+            auto operationType = [&](uint32_t name) -> std::optional<Schema::OperationType> {
+                if (name == nullString) {
+                    return std::nullopt;
+                }
+                return Schema::OperationType{symbol(name)};
+            };
+            schema.queryType = operationType(header.queryType);
+            schema.mutationType = operationType(header.mutationType);
+            schema.subscriptionType = operationType(header.subscriptionType);
+
+            schema.types.reserve(types.size());
+            for (auto const & record : types) {
+                schema.types.push_back(type(record));
+            }
+
+            return schema;
+        } catch (std::out_of_range const &) {
+            return std::nullopt;
+        }
+    }
+
+private:
+    std::string_view cache;
+    size_t offset = 0;
+    std::vector<uint32_t> stringOffsets;
+    std::string_view stringBytes;
+    std::vector<TypeRecord> types;
+    std::vector<FieldRecord> fields;
+    std::vector<InputValueRecord> inputValues;
+    std::vector<EnumValueRecord> enumValues;
+    std::vector<TypeRefRecord> typeRefs;
+
+    size_t remaining() const { return cache.size() - offset; }
+
+    template <typename T>
+    bool readSection(T * records, size_t count) {
+        if (count > remaining() / sizeof(T)) {
+            return false;
+        }
+        std::memcpy(records, cache.data() + offset, count * sizeof(T));
+        offset += count * sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool readSection(std::vector<T> & records, size_t count) {
+        if (count > remaining() / sizeof(T)) {
+            return false;
+        }
+        records.resize(count);
+        return readSection(records.data(), count);
+    }
+
+    // Malformed indices throw std::out_of_range, which rejects the cache.
+    static void checkRange(Range range, size_t size) {
+        if (range.first > size || range.count > size - range.first) {
+            throw std::out_of_range{"Invalid schema cache range"};
+        }
+    }
+
+    static TypeKind kind(uint32_t value) {
+        if (value > static_cast<uint32_t>(TypeKind::NonNull)) {
+            throw std::out_of_range{"Invalid schema cache TypeKind"};
+        }
+        return static_cast<TypeKind>(value);
+    }
+
+    std::string_view stringView(uint32_t id) const {
+        if (id == nullString || id >= stringOffsets.size() - 1) {
+            throw std::out_of_range{"Invalid schema cache string"};
+        }
+        return stringBytes.substr(stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+    }
+
+    std::string string(uint32_t id) const { return std::string{stringView(id)}; }
+
+    // Interns straight from the string table without an intermediate std::string.
+    Symbol symbol(uint32_t id) const { return Symbol{stringView(id)}; }
+
+    std::optional<std::string> optionalString(uint32_t id) const {
+        if (id == nullString) {
+            return std::nullopt;
+        }
+        return string(id);
+    }
+
+    TypeRef typeRef(TypeRefRecord const & record) const {
+        if (record.modifierCount > TypeRef::maxModifierCount) {
+            throw std::out_of_range{"Invalid schema cache TypeRef"};
+        }
+
+        // Wrap from the innermost modifier outwards.
+        auto const name = record.name == nullString ? std::nullopt : std::optional<Symbol>{symbol(record.name)};
+        TypeRef type{kind(record.kind), name};
+        for (auto i = record.modifierCount; i > 0; --i) {
+            auto const isList = (record.modifiers >> (i - 1)) & 1;
+            type = TypeRef{isList ? TypeKind::List : TypeKind::NonNull, std::nullopt, type};
+        }
+        return type;
+    }
+
+    std::vector<TypeRef> typeRefList(Range range) const {
+        checkRange(range, typeRefs.size());
+        std::vector<TypeRef> list;
+        list.reserve(range.count);
+        for (uint32_t i = 0; i < range.count; ++i) {
+            list.push_back(typeRef(typeRefs[range.first + i]));
+        }
+        return list;
+    }
+
+    std::vector<InputValue> inputValueList(Range range) const {
+        checkRange(range, inputValues.size());
+        std::vector<InputValue> list;
+        list.reserve(range.count);
+        for (uint32_t i = 0; i < range.count; ++i) {
+            auto const & record = inputValues[range.first + i];
+            list.push_back({typeRef(record.type), symbol(record.name), optionalString(record.description)});
+        }
+        return list;
+    }
+
+    Type type(TypeRecord const & record) const {
+        Type type{kind(record.kind), symbol(record.name), optionalString(record.description)};
+
+        checkRange(record.fields, fields.size());
+        type.fields.reserve(record.fields.count);
+        for (uint32_t i = 0; i < record.fields.count; ++i) {
+            auto const & field = fields[record.fields.first + i];
+            type.fields.push_back({typeRef(field.type),
+                                   symbol(field.name),
+                                   optionalString(field.description),
+                                   inputValueList(field.args)});
+        }
+
+        type.inputFields = inputValueList(record.inputFields);
+        type.interfaces = typeRefList(record.interfaces);
+
+        checkRange(record.enumValues, enumValues.size());
+        type.enumValues.reserve(record.enumValues.count);
+        for (uint32_t i = 0; i < record.enumValues.count; ++i) {
+            auto const & value = enumValues[record.enumValues.first + i];
+            type.enumValues.push_back({string(value.name), optionalString(value.description)});
+        }
+
+        type.possibleTypes = typeRefList(record.possibleTypes);
+
+        return type;
+    }
+};
+
+} // namespace
+
+uint64_t hashSchemaSource(std::string_view source) {
+    // 64 bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    for (auto const character : source) {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+std::string serializeSchemaCache(Schema const & schema, uint64_t sourceHash) {
+    return CacheWriter{}.write(schema, sourceHash);
+}
+
+std::optional<Schema> deserializeSchemaCache(std::string_view cache, uint64_t sourceHash) {
+    return CacheReader{cache}.read(sourceHash);
+}
+
+Schema loadSchemaWithCache(std::string_view source, std::string const & cachePath) {
+    auto const sourceHash = hashSchemaSource(source);
+
+    if (std::filesystem::exists(cachePath)) {
+        auto const cache = InputBuffer::open(cachePath, InputMode::Mapped);
+        if (auto schema = deserializeSchemaCache(cache.view(), sourceHash)) {
+            return std::move(*schema);
+        }
+    }
+
+    auto schema = loadSchema(source);
+
+    // Each run writes its own temporary file and renames it over the cache, so concurrent or interrupted runs never
+    // observe a partial cache.
+    auto file = OutputFile::create(cachePath);
+    file.write(serializeSchemaCache(schema, sourceHash));
+    file.close();
+
+    return schema;
+}
+
+} // namespace caffql
@@ -0,0 +1,28 @@
+#pragma once
+#include <string_view>
+#include "CodeGeneration.hpp"
+
+namespace caffql {
+
+// Binary precompiled schema cache.
+//
+// The cache is a header followed by flat sections: a deduplicated string table (offsets plus one character blob)
+// and fixed-size records for types, fields, input values, enum values and flat type references, which refer to
+// strings and to each other by index. Loading is a bounds check and a copy of each section rather than a parse.
+//
+// Each cache records a hash of the introspection json it was built from, and is only used when that hash matches
+// the current source. Bump `schemaCacheVersion` whenever the layout or the schema model changes.
+constexpr uint32_t schemaCacheVersion = 2;
+
+uint64_t hashSchemaSource(std::string_view source);
+
+std::string serializeSchemaCache(Schema const & schema, uint64_t sourceHash);
+
+// Returns nullopt if the cache was built from a different source, by an incompatible version, or is malformed.
+std::optional<Schema> deserializeSchemaCache(std::string_view cache, uint64_t sourceHash);
+
+// Loads the schema from the cache file at `cachePath` if it was built from `source`, otherwise parses `source` and
+// (re)writes the cache file.
+Schema loadSchemaWithCache(std::string_view source, std::string const & cachePath);
+
+} // namespace caffql
@@ -0,0 +1,683 @@
+#include "SchemaLoader.hpp"
+
+namespace caffql {
+
+namespace {
+
+enum class Key {
+    Unknown,
+    Data,
+    Schema,
+    QueryType,
+    MutationType,
+    SubscriptionType,
+    Types,
+    Kind,
+    Name,
+    Description,
+    Fields,
+    InputFields,
+    Interfaces,
+    EnumValues,
+    PossibleTypes,
+    Args,
+    Type,
+    OfType
+};
+
+constexpr char const * keyNames[] = {"",
+                                     "data",
+                                     "__schema",
+                                     "queryType",
+                                     "mutationType",
+                                     "subscriptionType",
+                                     "types",
+                                     "kind",
+                                     "name",
+                                     "description",
+                                     "fields",
+                                     "inputFields",
+                                     "interfaces",
+                                     "enumValues",
+                                     "possibleTypes",
+                                     "args",
+                                     "type",
+                                     "ofType"};
+
+Key keyFromString(std::string const & string) {
+    static std::unordered_map<std::string, Key> const keys = [] {
+        std::unordered_map<std::string, Key> keys;
+        for (size_t i = 1; i < std::size(keyNames); ++i) {
+            keys.emplace(keyNames[i], static_cast<Key>(i));
+        }
+        return keys;
+    }();
+
+    auto it = keys.find(string);
+    return it != keys.end() ? it->second : Key::Unknown;
+}
+
+constexpr uint32_t keyBit(Key key) { return uint32_t{1} << static_cast<uint32_t>(key); }
+
+// The Json value categories reported by the SAX parser, named as in `Json::type_name()` so errors match the ones
+// thrown when deserializing from a Json document.
+enum class ValueType { Null, Boolean, Number, String, Object, Array };
+
+char const * valueTypeName(ValueType type) {
+    switch (type) {
+    case ValueType::Null:
+        return "null";
+    case ValueType::Boolean:
+        return "boolean";
+    case ValueType::Number:
+        return "number";
+    case ValueType::String:
+        return "string";
+    case ValueType::Object:
+        return "object";
+    case ValueType::Array:
+        return "array";
+    }
+
+    throw std::invalid_argument{"Invalid ValueType value: " + std::to_string(static_cast<int>(type))};
+}
+
+Json::type_error typeError(ValueType expected, ValueType actual) {
+    return Json::type_error::create(
+            302, std::string{"type must be "} + valueTypeName(expected) + ", but is " + valueTypeName(actual));
+}
+
+TypeKind typeKindFromString(std::string const & string) {
+    // Matches NLOHMANN_JSON_SERIALIZE_ENUM, which falls back to the first case for unrecognized values.
+    if (string == "OBJECT") {
+        return TypeKind::Object;
+    } else if (string == "INTERFACE") {
+        return TypeKind::Interface;
+    } else if (string == "UNION") {
+        return TypeKind::Union;
+    } else if (string == "ENUM") {
+        return TypeKind::Enum;
+    } else if (string == "INPUT_OBJECT") {
+        return TypeKind::InputObject;
+    } else if (string == "LIST") {
+        return TypeKind::List;
+    } else if (string == "NON_NULL") {
+        return TypeKind::NonNull;
+    }
+    return TypeKind::Scalar;
+}
+
+struct Frame {
+    enum class Kind {
+        Root,
+        Data,
+        Schema,
+        OperationType,
+        Type,
+        Field,
+        InputValue,
+        EnumValue,
+        TypeRef,
+        // Arrays of the above
+        Types,
+        Fields,
+        InputValues,
+        EnumValues,
+        TypeRefs
+    };
+
+    Kind kind;
+    void * target;
+    Key key = Key::Unknown;
+    uint32_t seenKeys = 0;
+    // TypeRef only: how many ofTypes in from the outermost TypeRef this frame is
+    uint32_t depth = 0;
+
+    template <typename T>
+    T & as() const {
+        return *static_cast<T *>(target);
+    }
+
+    uint32_t requiredKeys() const {
+        switch (kind) {
+        case Kind::Root:
+            return keyBit(Key::Data);
+        case Kind::Data:
+            return keyBit(Key::Schema);
+        case Kind::Schema:
+            return keyBit(Key::Types);
+        case Kind::OperationType:
+        case Kind::EnumValue:
+            return keyBit(Key::Name);
+        case Kind::Type:
+            return keyBit(Key::Kind) | keyBit(Key::Name);
+        case Kind::Field:
+            return keyBit(Key::Name) | keyBit(Key::Args) | keyBit(Key::Type);
+        case Kind::InputValue:
+            return keyBit(Key::Name) | keyBit(Key::Type);
+        case Kind::TypeRef:
+            return keyBit(Key::Kind);
+        case Kind::Types:
+        case Kind::Fields:
+        case Kind::InputValues:
+        case Kind::EnumValues:
+        case Kind::TypeRefs:
+            return 0;
+        }
+
+        throw std::invalid_argument{"Invalid Frame::Kind value: " + std::to_string(static_cast<int>(kind))};
+    }
+};
+
+class SchemaSaxHandler {
+public:
+    explicit SchemaSaxHandler(Schema & schema) : schema{schema} {}
+
+    bool null() { return scalar(ValueType::Null, nullptr); }
+
+    bool boolean(bool) { return scalar(ValueType::Boolean, nullptr); }
+
+    bool number_integer(Json::number_integer_t) { return scalar(ValueType::Number, nullptr); }
+
+    bool number_unsigned(Json::number_unsigned_t) { return scalar(ValueType::Number, nullptr); }
+
+    bool number_float(Json::number_float_t, Json::string_t const &) { return scalar(ValueType::Number, nullptr); }
+
+    bool string(Json::string_t & value) { return scalar(ValueType::String, &value); }
+
+    bool key(Json::string_t & value) {
+        if (skipDepth == 0) {
+            auto & frame = frames.back();
+            frame.key = keyFromString(value);
+            frame.seenKeys |= keyBit(frame.key);
+        }
+        return true;
+    }
+
+    bool start_object(size_t) {
+        if (skipDepth > 0) {
+            ++skipDepth;
+            return true;
+        }
+
+        if (frames.empty()) {
+            frames.push_back({Frame::Kind::Root, nullptr});
+            return true;
+        }
+
+        auto const & frame = frames.back();
+        switch (frame.kind) {
+        case Frame::Kind::Root:
+            return pushOrSkip(frame.key == Key::Data, Frame::Kind::Data, nullptr);
+
+        case Frame::Kind::Data:
+            return pushOrSkip(frame.key == Key::Schema, Frame::Kind::Schema, &schema);
+
+        case Frame::Kind::Schema:
+            switch (frame.key) {
+            case Key::QueryType:
+                return push(Frame::Kind::OperationType, &schema.queryType.emplace());
+            case Key::MutationType:
+                return push(Frame::Kind::OperationType, &schema.mutationType.emplace());
+            case Key::SubscriptionType:
+                return push(Frame::Kind::OperationType, &schema.subscriptionType.emplace());
+            case Key::Types:
+                throw typeError(ValueType::Array, ValueType::Object);
+            default:
+                return skip();
+            }
+
+        case Frame::Kind::Field:
+            if (frame.key == Key::Type) {
+                return pushTypeRef(&frame.as<Field>().type);
+            }
+            break;
+
+        case Frame::Kind::InputValue:
+            if (frame.key == Key::Type) {
+                return pushTypeRef(&frame.as<InputValue>().type);
+            }
+            break;
+
+        case Frame::Kind::TypeRef:
+            if (frame.key == Key::OfType) {
+                auto const depth = frame.depth + 1;
+                typeRefChain.resize(depth);
+                typeRefChain.emplace_back();
+                frames.push_back({Frame::Kind::TypeRef, frame.target, Key::Unknown, 0, depth});
+                return true;
+            }
+            break;
+
+        case Frame::Kind::Types:
+            return push(Frame::Kind::Type, &frame.as<std::vector<Type>>().emplace_back());
+
+        case Frame::Kind::Fields:
+            return push(Frame::Kind::Field, &frame.as<std::vector<Field>>().emplace_back());
+
+        case Frame::Kind::InputValues:
+            return push(Frame::Kind::InputValue, &frame.as<std::vector<InputValue>>().emplace_back());
+
+        case Frame::Kind::EnumValues:
+            return push(Frame::Kind::EnumValue, &frame.as<std::vector<EnumValue>>().emplace_back());
+
+        case Frame::Kind::TypeRefs:
+            return pushTypeRef(&frame.as<std::vector<TypeRef>>().emplace_back());
+
+        case Frame::Kind::OperationType:
+        case Frame::Kind::Type:
+        case Frame::Kind::EnumValue:
+            break;
+        }
+
+        checkUnexpectedValue(frame, ValueType::Object);
+        return skip();
+    }
+
+    bool end_object() {
+        if (skipDepth > 0) {
+            --skipDepth;
+            return true;
+        }
+
+        auto const & frame = frames.back();
+        auto const missingKeys = frame.requiredKeys() & ~frame.seenKeys;
+        if (missingKeys != 0) {
+            for (size_t i = 0; i < std::size(keyNames); ++i) {
+                if (missingKeys & keyBit(static_cast<Key>(i))) {
+                    throw Json::out_of_range::create(403, std::string{"key '"} + keyNames[i] + "' not found");
+                }
+            }
+        }
+
+        if (frame.kind == Frame::Kind::TypeRef && frame.depth == 0) {
+            frame.as<TypeRef>() = buildTypeRef();
+        }
+
+        frames.pop_back();
+        return true;
+    }
+
+    bool start_array(size_t) {
+        if (skipDepth > 0) {
+            ++skipDepth;
+            return true;
+        }
+
+        if (frames.empty()) {
+            throw typeError(ValueType::Object, ValueType::Array);
+        }
+
+        auto const & frame = frames.back();
+        switch (frame.kind) {
+        case Frame::Kind::Schema:
+            if (frame.key == Key::Types) {
+                // Assigning replaces rather than appends, as with get_to.
+                schema.types.clear();
+                return push(Frame::Kind::Types, &schema.types);
+            }
+            break;
+
+        case Frame::Kind::Type: {
+            auto & type = frame.as<Type>();
+            switch (frame.key) {
+            case Key::Fields:
+                type.fields.clear();
+                return push(Frame::Kind::Fields, &type.fields);
+            case Key::InputFields:
+                type.inputFields.clear();
+                return push(Frame::Kind::InputValues, &type.inputFields);
+            case Key::Interfaces:
+                type.interfaces.clear();
+                return push(Frame::Kind::TypeRefs, &type.interfaces);
+            case Key::EnumValues:
+                type.enumValues.clear();
+                return push(Frame::Kind::EnumValues, &type.enumValues);
+            case Key::PossibleTypes:
+                type.possibleTypes.clear();
+                return push(Frame::Kind::TypeRefs, &type.possibleTypes);
+            default:
+                break;
+            }
+            break;
+        }
+
+        case Frame::Kind::Field:
+            if (frame.key == Key::Args) {
+                auto & args = frame.as<Field>().args;
+                args.clear();
+                return push(Frame::Kind::InputValues, &args);
+            }
+            break;
+
+        case Frame::Kind::Types:
+        case Frame::Kind::Fields:
+        case Frame::Kind::InputValues:
+        case Frame::Kind::EnumValues:
+        case Frame::Kind::TypeRefs:
+            throw typeError(ValueType::Object, ValueType::Array);
+
+        case Frame::Kind::Root:
+        case Frame::Kind::Data:
+        case Frame::Kind::OperationType:
+        case Frame::Kind::InputValue:
+        case Frame::Kind::EnumValue:
+        case Frame::Kind::TypeRef:
+            break;
+        }
+
+        checkUnexpectedValue(frame, ValueType::Array);
+        return skip();
+    }
+
+    bool end_array() {
+        if (skipDepth > 0) {
+            --skipDepth;
+            return true;
+        }
+
+        frames.pop_back();
+        return true;
+    }
+
+    bool parse_error(size_t, std::string const &, nlohmann::detail::exception const & exception) {
+        // Rethrow with the exception's concrete type, as the Json DOM parser does.
+        switch ((exception.id / 100) % 100) {
+        case 1:
+            throw *static_cast<Json::parse_error const *>(&exception);
+        case 4:
+            throw *static_cast<Json::out_of_range const *>(&exception);
+        default:
+            throw exception;
+        }
+    }
+
+private:
+    struct TypeRefElement {
+        TypeKind kind = TypeKind::Scalar;
+        std::optional<Symbol> name;
+    };
+
+    Schema & schema;
+    std::vector<Frame> frames;
+    // The kinds and names of the TypeRef being read, outermost first
+    std::vector<TypeRefElement> typeRefChain;
+    // Depth of nested containers inside a value that is not part of the schema model.
+    size_t skipDepth = 0;
+
+    bool push(Frame::Kind kind, void * target) {
+        frames.push_back({kind, target});
+        return true;
+    }
+
+    bool pushTypeRef(TypeRef * target) {
+        typeRefChain.assign(1, {});
+        return push(Frame::Kind::TypeRef, target);
+    }
+
+    TypeRef buildTypeRef() const {
+        auto const & innermost = typeRefChain.back();
+        TypeRef type{innermost.kind, innermost.name};
+        for (auto it = typeRefChain.rbegin() + 1; it != typeRefChain.rend(); ++it) {
+            type = TypeRef{it->kind, it->name, type};
+        }
+        return type;
+    }
+
+    bool pushOrSkip(bool shouldPush, Frame::Kind kind, void * target) {
+        return shouldPush ? push(kind, target) : skip();
+    }
+
+    bool skip() {
+        skipDepth = 1;
+        return true;
+    }
+
+    static void checkUnexpectedValue(Frame const & frame, ValueType actual) {
+        switch (frame.kind) {
+        case Frame::Kind::Types:
+        case Frame::Kind::Fields:
+        case Frame::Kind::InputValues:
+        case Frame::Kind::EnumValues:
+        case Frame::Kind::TypeRefs:
+            throw typeError(ValueType::Object, actual);
+
+        default:
+            break;
+        }
+
+        switch (frame.key) {
+        case Key::Kind:
+        case Key::Name:
+        case Key::Description:
+            if (frame.kind != Frame::Kind::Root && frame.kind != Frame::Kind::Data && frame.kind != Frame::Kind::Schema) {
+                throw typeError(ValueType::String, actual);
+            }
+            break;
+
+        case Key::Args:
+            if (frame.kind == Frame::Kind::Field) {
+                throw typeError(ValueType::Array, actual);
+            }
+            break;
+
+        case Key::Types:
+            if (frame.kind == Frame::Kind::Schema) {
+                throw typeError(ValueType::Array, actual);
+            }
+            break;
+
+        case Key::Type:
+            if (frame.kind == Frame::Kind::Field || frame.kind == Frame::Kind::InputValue) {
+                throw typeError(ValueType::Object, actual);
+            }
+            break;
+
+        case Key::Data:
+            if (frame.kind == Frame::Kind::Root) {
+                throw typeError(ValueType::Object, actual);
+            }
+            break;
+
+        case Key::Schema:
+            if (frame.kind == Frame::Kind::Data) {
+                throw typeError(ValueType::Object, actual);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    static void assignOptional(std::optional<std::string> & target, ValueType type, Json::string_t * value) {
+        if (type == ValueType::String) {
+            target = std::move(*value);
+        } else if (type == ValueType::Null) {
+            target.reset();
+        } else {
+            throw typeError(ValueType::String, type);
+        }
+    }
+
+    static void assignOptional(std::optional<Symbol> & target, ValueType type, Json::string_t * value) {
+        if (type == ValueType::String) {
+            target = Symbol{*value};
+        } else if (type == ValueType::Null) {
+            target.reset();
+        } else {
+            throw typeError(ValueType::String, type);
+        }
+    }
+
+    static void assign(std::string & target, ValueType type, Json::string_t * value) {
+        if (type != ValueType::String) {
+            throw typeError(ValueType::String, type);
+        }
+        target = std::move(*value);
+    }
+
+    static void assign(Symbol & target, ValueType type, Json::string_t * value) {
+        if (type != ValueType::String) {
+            throw typeError(ValueType::String, type);
+        }
+        target = Symbol{*value};
+    }
+
+    static void assign(TypeKind & target, ValueType type, Json::string_t * value) {
+        if (type != ValueType::String) {
+            // Non-string enum values don't match any case either
+            target = TypeKind::Scalar;
+            return;
+        }
+        target = typeKindFromString(*value);
+    }
+
+    bool scalar(ValueType type, Json::string_t * value) {
+        if (skipDepth > 0) {
+            return true;
+        }
+
+        if (frames.empty()) {
+            throw typeError(ValueType::Object, type);
+        }
+
+        auto const & frame = frames.back();
+        switch (frame.kind) {
+        case Frame::Kind::Schema:
+            switch (frame.key) {
+            case Key::QueryType:
+            case Key::MutationType:
+            case Key::SubscriptionType:
+                if (type != ValueType::Null) {
+                    throw typeError(ValueType::Object, type);
+                }
+                return true;
+            default:
+                break;
+            }
+            break;
+
+        case Frame::Kind::OperationType:
+            if (frame.key == Key::Name) {
+                assign(frame.as<Schema::OperationType>().name, type, value);
+                return true;
+            }
+            break;
+
+        case Frame::Kind::Type: {
+            auto & target = frame.as<Type>();
+            switch (frame.key) {
+            case Key::Kind:
+                assign(target.kind, type, value);
+                return true;
+            case Key::Name:
+                assign(target.name, type, value);
+                return true;
+            case Key::Description:
+                assignOptional(target.description, type, value);
+                return true;
+            default:
+                // Non-array values for the list members are ignored
+                return true;
+            }
+        }
+
+        case Frame::Kind::Field: {
+            auto & target = frame.as<Field>();
+            switch (frame.key) {
+            case Key::Name:
+                assign(target.name, type, value);
+                return true;
+            case Key::Description:
+                assignOptional(target.description, type, value);
+                return true;
+            default:
+                break;
+            }
+            break;
+        }
+
+        case Frame::Kind::InputValue: {
+            auto & target = frame.as<InputValue>();
+            switch (frame.key) {
+            case Key::Name:
+                assign(target.name, type, value);
+                return true;
+            case Key::Description:
+                assignOptional(target.description, type, value);
+                return true;
+            default:
+                break;
+            }
+            break;
+        }
+
+        case Frame::Kind::EnumValue: {
+            auto & target = frame.as<EnumValue>();
+            switch (frame.key) {
+            case Key::Name:
+                assign(target.name, type, value);
+                return true;
+            case Key::Description:
+                assignOptional(target.description, type, value);
+                return true;
+            default:
+                break;
+            }
+            break;
+        }
+
+        case Frame::Kind::TypeRef: {
+            auto & target = typeRefChain[frame.depth];
+            switch (frame.key) {
+            case Key::Kind:
+                assign(target.kind, type, value);
+                return true;
+            case Key::Name:
+                assignOptional(target.name, type, value);
+                return true;
+            case Key::OfType:
+                if (type != ValueType::Null) {
+                    throw typeError(ValueType::Object, type);
+                }
+                typeRefChain.resize(frame.depth + 1);
+                return true;
+            default:
+                break;
+            }
+            break;
+        }
+
+        case Frame::Kind::Root:
+        case Frame::Kind::Data:
+        case Frame::Kind::Types:
+        case Frame::Kind::Fields:
+        case Frame::Kind::InputValues:
+        case Frame::Kind::EnumValues:
+        case Frame::Kind::TypeRefs:
+            break;
+        }
+
+        checkUnexpectedValue(frame, type);
+        return true;
+    }
+};
+
+template <typename Input>
+Schema loadSchemaFrom(Input && input) {
+    Schema schema;
+    SchemaSaxHandler handler{schema};
+    Json::sax_parse(std::forward<Input>(input), &handler);
+    return schema;
+}
+
+} // namespace
+
+Schema loadSchema(std::istream & input) { return loadSchemaFrom(input); }
+
+Schema loadSchema(std::string_view input) {
+    return loadSchemaFrom(nlohmann::detail::input_adapter(input.data(), input.size()));
+}
+
+} // namespace caffql
@@ -0,0 +1,17 @@
+#pragma once
+#include <istream>
+#include <string_view>
+#include "CodeGeneration.hpp"
+
+namespace caffql {
+
+// Loads the schema from an introspection query response (`{"data": {"__schema": ...}}`) by filling the schema
+// model directly from the parser's token stream instead of building an intermediate Json document.
+// Produces the same result as `from_json` on `json.at("data").at("__schema")` and throws the same Json exception
+// types on malformed input.
+Schema loadSchema(std::istream & input);
+
+// Parses directly from a contiguous buffer, such as a memory mapped InputBuffer.
+Schema loadSchema(std::string_view input);
+
+} // namespace caffql
@@ -0,0 +1,480 @@
+#include "SelectionManifest.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace caffql {
+
+namespace {
+
+constexpr std::string_view fragmentPrefix = "...on ";
+
+bool hasSelectionSet(TypeKind kind) {
+    return kind == TypeKind::Object || kind == TypeKind::Interface || kind == TypeKind::Union;
+}
+
+// nullptr if the type has no field named `name`
+Field const * findField(Type const & type, Symbol name) {
+    auto const field = std::find_if(
+            type.fields.begin(), type.fields.end(), [&](Field const & field) { return field.name == name; });
+    return field == type.fields.end() ? nullptr : &*field;
+}
+
+void keepFields(std::vector<Field> & fields, std::unordered_set<Symbol> const & kept) {
+    fields.erase(
+            std::remove_if(
+                    fields.begin(), fields.end(), [&](Field const & field) { return kept.count(field.name) == 0; }),
+            fields.end());
+}
+
+// By index in `typeMap`, whether the type is one of the schema's operation types.
+std::vector<bool> operationTypes(Schema const & schema, TypeMap const & typeMap) {
+    std::vector<bool> isOperationType(typeMap.size());
+    for (auto const & operationType : {schema.queryType, schema.mutationType, schema.subscriptionType}) {
+        if (operationType) {
+            auto const index = typeMap.find(operationType->name);
+            if (index != TypeMap::npos) {
+                isOperationType[index] = true;
+            }
+        }
+    }
+    return isOperationType;
+}
+
+// Removes the types that trimming the fields of `schema`, whose types `typeMap` indexes, left unreached.
+void removeUnreachedTypes(Schema & schema, TypeMap const & typeMap, std::vector<bool> const & isOperationType) {
+    // Object, interface and union types that the remaining fields don't reach would only be generated to go unused, and
+    // interfaces among them would name fields that their trimmed possible types may not have.
+    std::vector<bool> isReached(typeMap.size());
+    std::vector<TypeIndex> pending;
+    auto reach = [&](Symbol name) {
+        auto const index = typeMap.find(name);
+        if (index != TypeMap::npos && !isReached[index]) {
+            isReached[index] = true;
+            pending.push_back(index);
+        }
+    };
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        if (isOperationType[index]) {
+            reach(typeMap.at(index).name);
+        }
+    }
+    while (!pending.empty()) {
+        auto const & type = schema.types[pending.back()];
+        pending.pop_back();
+        for (auto const & field : type.fields) {
+            reach(field.type.underlyingType().name());
+        }
+        for (auto const & possibleType : type.possibleTypes) {
+            reach(possibleType.name());
+        }
+    }
+
+    std::vector<Type> types;
+    std::unordered_set<Symbol> unreachedInterfaces;
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        auto & type = schema.types[index];
+        if (isReached[index] || !hasSelectionSet(type.kind)) {
+            types.push_back(std::move(type));
+        } else if (type.kind == TypeKind::Interface) {
+            unreachedInterfaces.insert(type.name);
+        }
+    }
+    for (auto & type : types) {
+        auto & interfaces = type.interfaces;
+        interfaces.erase(std::remove_if(interfaces.begin(),
+                                        interfaces.end(),
+                                        [&](TypeRef const & interface) {
+                                            return unreachedInterfaces.count(interface.name()) > 0;
+                                        }),
+                         interfaces.end());
+    }
+    schema.types = std::move(types);
+}
+
+// Makes the fields named in `nullableFields`, by type index in `typeMap`, nullable in `schema`, whose types `typeMap`
+// indexes.
+void makeFieldsNullable(
+        Schema & schema, TypeMap const & typeMap, std::vector<std::unordered_set<Symbol>> & nullableFields) {
+    // Interfaces return their fields from their possible types, so each field an interface keeps has to be nullable in
+    // all of them or in none.
+    for (auto isChanged = true; isChanged;) {
+        isChanged = false;
+        for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+            auto const & type = schema.types[index];
+            if (type.kind != TypeKind::Interface) {
+                continue;
+            }
+
+            std::vector<TypeIndex> implementations{index};
+            for (auto const & possibleType : type.possibleTypes) {
+                auto const possibleTypeIndex = typeMap.find(possibleType.name());
+                if (possibleTypeIndex != TypeMap::npos) {
+                    implementations.push_back(possibleTypeIndex);
+                }
+            }
+
+            for (auto const & field : type.fields) {
+                auto const isNullable =
+                        std::any_of(implementations.begin(), implementations.end(), [&](TypeIndex implementation) {
+                            return nullableFields[implementation].count(field.name) > 0;
+                        });
+                if (isNullable) {
+                    for (auto const implementation : implementations) {
+                        isChanged = nullableFields[implementation].insert(field.name).second || isChanged;
+                    }
+                }
+            }
+        }
+    }
+
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        for (auto & field : schema.types[index].fields) {
+            if (field.type.kind() == TypeKind::NonNull && nullableFields[index].count(field.name) > 0) {
+                field.type = field.type.ofType();
+            }
+        }
+    }
+}
+
+// Gathers the fields of each type that the selections of a manifest select.
+struct FieldSelector {
+    TypeMap const & typeMap;
+    // Types whose fields are trimmed to selectedFields, unless allFieldsSelected
+    std::vector<bool> reached;
+    std::vector<bool> allFieldsSelected;
+    std::vector<std::unordered_set<Symbol>> selectedFields;
+    // The number of objects of fields that select each type's fields in queries, and how many of them select each
+    // field. Fields that only some of them select are left out of the responses of the others.
+    std::vector<size_t> selectionCounts;
+    std::vector<std::unordered_map<Symbol, size_t>> fieldSelectionCounts;
+
+    explicit FieldSelector(TypeMap const & typeMap)
+        : typeMap{typeMap},
+          reached(typeMap.size()),
+          allFieldsSelected(typeMap.size()),
+          selectedFields(typeMap.size()),
+          selectionCounts(typeMap.size()),
+          fieldSelectionCounts(typeMap.size()) {}
+
+    [[noreturn]] static void fail(std::string const & path, std::string const & message) {
+        throw std::invalid_argument{"Selection manifest " + path + ": " + message};
+    }
+
+    TypeIndex indexOf(Symbol name, std::string const & path) const {
+        auto const index = typeMap.find(name);
+        if (index == TypeMap::npos) {
+            fail(path, "no type named " + name.str());
+        }
+        return index;
+    }
+
+    // Selects every field of the type and of the types nested in it.
+    void selectAllFields(TypeIndex index) {
+        if (allFieldsSelected[index]) {
+            return;
+        }
+        allFieldsSelected[index] = true;
+
+        auto const & type = typeMap.at(index);
+        for (auto const & field : type.fields) {
+            auto const fieldType = typeMap.find(field.type.underlyingType().name());
+            if (fieldType != TypeMap::npos) {
+                selectAllFields(fieldType);
+            }
+        }
+        for (auto const & possibleType : type.possibleTypes) {
+            auto const possibleTypeIndex = typeMap.find(possibleType.name());
+            if (possibleTypeIndex != TypeMap::npos) {
+                selectAllFields(possibleTypeIndex);
+            }
+        }
+    }
+
+    // Selects `selection`, a field's `true` or selection of its type's fields.
+    void selectField(Field const & field, Json const & selection, std::string const & path) {
+        auto const underlyingType = field.type.underlyingType();
+        auto const isComposite = hasSelectionSet(underlyingType.kind());
+
+        if (selection.is_boolean() && selection.get<bool>()) {
+            if (isComposite) {
+                selectAllFields(indexOf(underlyingType.name(), path));
+            }
+        } else if (selection.is_object()) {
+            if (!isComposite) {
+                fail(path, field.name.str() + " has no fields to select");
+            }
+            if (selection.empty()) {
+                fail(path, "expected at least one field to select");
+            }
+            select(indexOf(underlyingType.name(), path), selection, path);
+        } else {
+            fail(path, "expected true or an object of fields");
+        }
+    }
+
+    // Selects the fields of a type, and of its possible types, in one place of a query.
+    void select(TypeIndex index, Json const & selection, std::string const & path) {
+        auto const & type = typeMap.at(index);
+        reached[index] = true;
+        ++selectionCounts[index];
+
+        Json interfaceFields = Json::object();
+        // By possible type, its fragment and the fragment's path
+        std::unordered_map<Symbol, std::pair<Json const *, std::string>> fragments;
+        for (auto const & [key, fieldSelection] : selection.items()) {
+            auto const fieldPath = path + '.' + key;
+
+            if (std::string_view{key}.substr(0, fragmentPrefix.size()) == fragmentPrefix) {
+                Symbol const possibleTypeName{key.substr(fragmentPrefix.size())};
+                auto const isPossibleType = std::any_of(
+                        type.possibleTypes.begin(), type.possibleTypes.end(), [&](TypeRef const & possibleType) {
+                            return possibleType.name() == possibleTypeName;
+                        });
+                if (!isPossibleType) {
+                    fail(fieldPath, possibleTypeName.str() + " isn't a possible type of " + type.name.str());
+                }
+                if (!fieldSelection.is_object()) {
+                    fail(fieldPath, "expected an object of fields");
+                }
+                if (fieldSelection.empty()) {
+                    fail(fieldPath, "expected at least one field to select");
+                }
+                fragments.emplace(possibleTypeName, std::pair{&fieldSelection, fieldPath});
+                continue;
+            }
+
+            Symbol const fieldName{key};
+            auto const field = findField(type, fieldName);
+            if (!field) {
+                fail(fieldPath, type.name.str() + " has no field named " + key);
+            }
+
+            selectedFields[index].insert(fieldName);
+            ++fieldSelectionCounts[index][fieldName];
+            selectField(*field, fieldSelection, fieldPath);
+            interfaceFields[key] = fieldSelection;
+        }
+
+        // Possible types are held in place of the interface or union, so they are trimmed along with it. Each is
+        // selected in this place by its fragment, if any, along with the interface's fields that it reads from them,
+        // which queries select in place of the fragment's.
+        for (auto const & possibleType : type.possibleTypes) {
+            auto const possibleTypeIndex = indexOf(possibleType.name(), path);
+            auto const fragment = fragments.find(possibleType.name());
+            if (type.kind != TypeKind::Interface && fragment == fragments.end()) {
+                reached[possibleTypeIndex] = true;
+                ++selectionCounts[possibleTypeIndex];
+                continue;
+            }
+
+            auto possibleTypeSelection = interfaceFields;
+            if (fragment != fragments.end()) {
+                for (auto const & [key, fieldSelection] : fragment->second.first->items()) {
+                    possibleTypeSelection.emplace(key, fieldSelection);
+                }
+            }
+            select(possibleTypeIndex,
+                   possibleTypeSelection,
+                   fragment != fragments.end() ? fragment->second.second
+                                               : path + ".(" + possibleType.name().str() + ')');
+        }
+    }
+
+    // Fields kept by types that some of their selections in queries leave out.
+    std::vector<std::unordered_set<Symbol>> partiallySelectedFields() const {
+        std::vector<std::unordered_set<Symbol>> fields(typeMap.size());
+        for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+            if (selectionCounts[index] == 0) {
+                continue;
+            }
+            for (auto const & field : typeMap.at(index).fields) {
+                auto const count = fieldSelectionCounts[index].find(field.name);
+                if (count == fieldSelectionCounts[index].end() || count->second < selectionCounts[index]) {
+                    fields[index].insert(field.name);
+                }
+            }
+        }
+        return fields;
+    }
+};
+
+// Gathers the depths that the selection sets of each type are built at in queries limited by a SelectionDepth, which
+// are the number of levels of selection sets that may still be nested in them.
+struct DepthLimiter {
+    static constexpr size_t unlimitedDepth = std::numeric_limits<size_t>::max();
+
+    TypeMap const & typeMap;
+    std::vector<std::unordered_set<size_t>> reachedDepths;
+
+    explicit DepthLimiter(TypeMap const & typeMap) : typeMap{typeMap}, reachedDepths(typeMap.size()) {}
+
+    void reachField(Field const & field, size_t depth) {
+        auto const underlyingType = field.type.underlyingType();
+        if (depth > 0 && hasSelectionSet(underlyingType.kind())) {
+            auto const index = typeMap.find(underlyingType.name());
+            if (index != TypeMap::npos) {
+                reach(index, depth == unlimitedDepth ? unlimitedDepth : depth - 1);
+            }
+        }
+    }
+
+    void reach(TypeIndex index, size_t depth) {
+        if (!reachedDepths[index].insert(depth).second) {
+            return;
+        }
+
+        auto const & type = typeMap.at(index);
+        for (auto const & field : type.fields) {
+            reachField(field, depth);
+        }
+        for (auto const & possibleType : type.possibleTypes) {
+            auto const possibleTypeIndex = typeMap.find(possibleType.name());
+            if (possibleTypeIndex != TypeMap::npos) {
+                reach(possibleTypeIndex, depth);
+            }
+        }
+    }
+
+    // Whether any selection set of the type selects its fields that have selection sets of their own
+    bool isExpandedBeyond(TypeIndex index) const {
+        auto const & depths = reachedDepths[index];
+        return std::any_of(depths.begin(), depths.end(), [](size_t depth) { return depth > 0; });
+    }
+
+    // Whether any selection set of the type leaves out its fields that have selection sets of their own
+    bool isCutOff(TypeIndex index) const { return reachedDepths[index].count(0) > 0; }
+};
+
+} // namespace
+
+Schema selectFields(Schema const & schema, Json const & manifest) {
+    if (!manifest.is_object()) {
+        throw std::invalid_argument{"Selection manifest: expected an object of operation types"};
+    }
+
+    TypeMap const typeMap{schema.types};
+    FieldSelector selector{typeMap};
+    auto const isOperationType = operationTypes(schema, typeMap);
+
+    // Root fields selected by the manifest, by operation type
+    std::vector<std::unordered_set<Symbol>> rootFields(typeMap.size());
+
+    for (auto const & [operationTypeName, operationSelection] : manifest.items()) {
+        auto const index = typeMap.find(Symbol{operationTypeName});
+        if (index == TypeMap::npos || !isOperationType[index]) {
+            FieldSelector::fail(operationTypeName, "isn't an operation type of the schema");
+        }
+        if (!operationSelection.is_object()) {
+            FieldSelector::fail(operationTypeName, "expected an object of root fields");
+        }
+
+        auto const & operationType = typeMap.at(index);
+        for (auto const & [fieldName, selection] : operationSelection.items()) {
+            auto const path = operationTypeName + '.' + fieldName;
+            Symbol const name{fieldName};
+            auto const field = findField(operationType, name);
+            if (!field) {
+                FieldSelector::fail(path, operationTypeName + " has no field named " + fieldName);
+            }
+
+            rootFields[index].insert(name);
+            selector.selectField(*field, selection, path);
+        }
+    }
+
+    auto selected = schema;
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        auto & fields = selected.types[index].fields;
+        if (isOperationType[index]) {
+            keepFields(fields, rootFields[index]);
+        } else if (selector.reached[index] && !selector.allFieldsSelected[index]) {
+            keepFields(fields, selector.selectedFields[index]);
+        }
+    }
+
+    // Operation types keep their fields, which are the roots of the operations rather than parts of their responses.
+    auto nullableFields = selector.partiallySelectedFields();
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        if (isOperationType[index]) {
+            nullableFields[index].clear();
+        }
+    }
+    makeFieldsNullable(selected, typeMap, nullableFields);
+
+    removeUnreachedTypes(selected, typeMap, isOperationType);
+
+    return selected;
+}
+
+std::map<std::pair<Symbol, Symbol>, Json> operationSelections(Json const & manifest) {
+    std::map<std::pair<Symbol, Symbol>, Json> selections;
+    for (auto const & [operationTypeName, operationSelection] : manifest.items()) {
+        for (auto const & [fieldName, selection] : operationSelection.items()) {
+            if (selection.is_object()) {
+                selections.emplace(std::pair{Symbol{operationTypeName}, Symbol{fieldName}}, selection);
+            }
+        }
+    }
+    return selections;
+}
+
+Schema limitSelectionDepth(Schema const & schema, SelectionDepth const & depth) {
+    TypeMap const typeMap{schema.types};
+    DepthLimiter limiter{typeMap};
+    auto const isOperationType = operationTypes(schema, typeMap);
+
+    for (auto const & [operationField, maxDepth] : depth.operationMaxDepths) {
+        auto const & [operationTypeName, fieldName] = operationField;
+        auto const path = operationTypeName.str() + '.' + fieldName.str();
+        auto const index = typeMap.find(operationTypeName);
+        if (index == TypeMap::npos || !isOperationType[index]) {
+            throw std::invalid_argument{"Selection depth " + path + ": " + operationTypeName.str() +
+                                        " isn't an operation type of the schema"};
+        }
+        if (!findField(typeMap.at(index), fieldName)) {
+            throw std::invalid_argument{"Selection depth " + path + ": " + operationTypeName.str() +
+                                        " has no field named " + fieldName.str()};
+        }
+    }
+
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        if (isOperationType[index]) {
+            auto const & operationType = typeMap.at(index);
+            for (auto const & field : operationType.fields) {
+                auto const maxDepth = depth.maxDepthOf(operationType.name, field.name);
+                limiter.reachField(field, maxDepth == 0 ? DepthLimiter::unlimitedDepth : maxDepth);
+            }
+        }
+    }
+
+    // Operation types keep their fields, which are the roots of the operations rather than parts of their responses.
+    auto limited = schema;
+    std::vector<std::unordered_set<Symbol>> nullableFields(typeMap.size());
+    for (TypeIndex index = 0; index < typeMap.size(); ++index) {
+        if (isOperationType[index] || limiter.reachedDepths[index].empty()) {
+            continue;
+        }
+
+        auto & fields = limited.types[index].fields;
+        auto const hasSelectionSetOfItsOwn = [](Field const & field) {
+            return hasSelectionSet(field.type.underlyingType().kind());
+        };
+        if (!limiter.isExpandedBeyond(index)) {
+            fields.erase(std::remove_if(fields.begin(), fields.end(), hasSelectionSetOfItsOwn), fields.end());
+        } else if (limiter.isCutOff(index)) {
+            for (auto const & field : fields) {
+                if (hasSelectionSetOfItsOwn(field)) {
+                    nullableFields[index].insert(field.name);
+                }
+            }
+        }
+    }
+
+    makeFieldsNullable(limited, typeMap, nullableFields);
+
+    removeUnreachedTypes(limited, typeMap, isOperationType);
+
+    return limited;
+}
+
+} // namespace caffql
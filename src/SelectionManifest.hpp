@@ -0,0 +1,35 @@
+#pragma once
+#include "CodeGeneration.hpp"
+
+namespace caffql {
+
+// Trims a schema to the operations and fields that a selection manifest selects, so that the generated queries only
+// request those fields and the generated types only hold them. The manifest maps the names of operation types to the
+// root fields to generate, and those to their selections:
+//
+//     {"Query": {"user": {"id": true, "posts": {"id": true}}, "search": {"...on User": {"id": true}}}}
+//
+// A selection maps the names of a type's fields to `true`, which selects the field along with every field nested in it
+// as without a manifest, or to a selection of the fields of the field's type, which selects at least one field.
+// Interfaces and unions select the fields of their possible types under `...on <Type>` keys, and the fields selected on
+// an interface are also selected on each of its possible types.
+//
+// Generated types are shared by every operation that uses them, so each type keeps every field that any selection
+// selects, and types that `true` reaches keep all of their fields. Root fields that the manifest doesn't name are
+// left out of the schema, as are object, interface and union types that the remaining fields don't reach. Throws
+// std::invalid_argument naming the path to a selection that doesn't match the schema.
+Schema selectFields(Schema const & schema, Json const & manifest);
+
+// The root fields that a manifest, already checked by selectFields, selects with objects of fields, which generated
+// queries follow as SelectionDepth describes.
+std::map<std::pair<Symbol, Symbol>, Json> operationSelections(Json const & manifest);
+
+// Trims a schema to the fields that queries limited by `depth` select, so that the generated types match the queries
+// that generateTypes generates with the same `depth`. Fields with selection sets of their own are left out of the types
+// that every query reaches at the limit, and become nullable in the types that only some queries reach at the limit,
+// which decode to nullopt there. Objects left without fields are kept, and their selection sets only select
+// `__typename`, as do the selection sets of any type left without fields in a query. Types left unreached are removed
+// as by selectFields. Throws std::invalid_argument naming an operation limit that doesn't match the schema.
+Schema limitSelectionDepth(Schema const & schema, SelectionDepth const & depth);
+
+} // namespace caffql
@@ -0,0 +1,95 @@
+#include "Sha256.hpp"
+#include <array>
+#include <cstdint>
+
+namespace caffql {
+
+static constexpr std::array<uint32_t, 64> roundConstants = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t rotateRight(uint32_t value, int bits) { return (value >> bits) | (value << (32 - bits)); }
+
+static void compress(std::array<uint32_t, 8> & state, unsigned char const * block) {
+    std::array<uint32_t, 64> schedule;
+    for (size_t i = 0; i < 16; ++i) {
+        schedule[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 |
+                      uint32_t(block[i * 4 + 2]) << 8 | uint32_t(block[i * 4 + 3]);
+    }
+    for (size_t i = 16; i < 64; ++i) {
+        auto const s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        auto const s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    auto working = state;
+    for (size_t i = 0; i < 64; ++i) {
+        auto & [a, b, c, d, e, f, g, h] = working;
+        auto const s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        auto const choice = (e & f) ^ (~e & g);
+        auto const temp1 = h + s1 + choice + roundConstants[i] + schedule[i];
+        auto const s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        auto const majority = (a & b) ^ (a & c) ^ (b & c);
+        auto const temp2 = s0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    for (size_t i = 0; i < 8; ++i) {
+        state[i] += working[i];
+    }
+}
+
+std::string sha256Hex(std::string_view text) {
+    std::array<uint32_t, 8> state = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    auto const data = reinterpret_cast<unsigned char const *>(text.data());
+    auto const fullBlocksSize = text.size() - text.size() % 64;
+    for (size_t offset = 0; offset < fullBlocksSize; offset += 64) {
+        compress(state, data + offset);
+    }
+
+    // The remaining bytes, a 1 bit, zeros, and the length in bits, padded to one or two blocks.
+    std::array<unsigned char, 128> tail{};
+    auto const remaining = text.size() - fullBlocksSize;
+    for (size_t i = 0; i < remaining; ++i) {
+        tail[i] = data[fullBlocksSize + i];
+    }
+    tail[remaining] = 0x80;
+
+    auto const tailSize = remaining < 56 ? 64 : 128;
+    auto const bitLength = uint64_t(text.size()) * 8;
+    for (size_t i = 0; i < 8; ++i) {
+        tail[tailSize - 1 - i] = static_cast<unsigned char>(bitLength >> (i * 8));
+    }
+
+    for (size_t offset = 0; offset < size_t(tailSize); offset += 64) {
+        compress(state, tail.data() + offset);
+    }
+
+    static constexpr char hexDigits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(64);
+    for (auto const word : state) {
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            hex += hexDigits[(word >> shift) & 0xf];
+        }
+    }
+    return hex;
+}
+
+} // namespace caffql
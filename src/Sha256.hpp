@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace caffql {
+
+// Lowercase hex SHA-256 digest of `text`, which automatic persisted queries name queries by.
+std::string sha256Hex(std::string_view text);
+
+} // namespace caffql
@@ -0,0 +1,51 @@
+#include "Symbol.hpp"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace caffql {
+
+struct Symbol::Table {
+    std::mutex mutex;
+    // A deque never moves its elements, so symbols can point at them while more are added.
+    std::deque<Entry> entries;
+    std::unordered_map<std::string_view, Entry const *> entriesByText;
+};
+
+Symbol::Table & Symbol::table() {
+    static Table table;
+    return table;
+}
+
+Symbol::Symbol(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    auto & table = Symbol::table();
+    std::lock_guard<std::mutex> lock{table.mutex};
+
+    auto it = table.entriesByText.find(text);
+    if (it != table.entriesByText.end()) {
+        entry = it->second;
+        return;
+    }
+
+    auto const id = static_cast<uint32_t>(table.entries.size() + 1);
+    auto const & added = table.entries.emplace_back(Entry{std::string{text}, id});
+    table.entriesByText.emplace(added.text, &added);
+    entry = &added;
+}
+
+size_t Symbol::count() {
+    auto & table = Symbol::table();
+    std::lock_guard<std::mutex> lock{table.mutex};
+    return table.entries.size() + 1;
+}
+
+std::string const & Symbol::emptyString() {
+    static std::string const empty;
+    return empty;
+}
+
+} // namespace caffql
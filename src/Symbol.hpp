@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace caffql {
+
+// Interned string. All symbols with the same text share a single process-wide entry, so a symbol is pointer sized and
+// copying, comparing for equality and hashing never touch the text. Entries live until the process exits. Interning
+// is thread safe, and reading a symbol's text never locks.
+struct Symbol {
+
+    Symbol() = default;
+
+    Symbol(std::string_view text);
+
+    Symbol(std::string const & text) : Symbol{std::string_view{text}} {}
+
+    Symbol(char const * text) : Symbol{std::string_view{text}} {}
+
+    std::string const & str() const { return entry ? entry->text : emptyString(); }
+
+    // Dense id in interning order. The empty string is 0.
+    uint32_t id() const { return entry ? entry->id : 0; }
+
+    bool empty() const { return entry == nullptr; }
+
+    // Number of interned symbols, including the empty string. Every id is less than this.
+    static size_t count();
+
+    friend bool operator==(Symbol lhs, Symbol rhs) { return lhs.entry == rhs.entry; }
+
+    friend bool operator!=(Symbol lhs, Symbol rhs) { return lhs.entry != rhs.entry; }
+
+    // Orders by text so that sorting is deterministic regardless of interning order.
+    friend bool operator<(Symbol lhs, Symbol rhs) { return lhs.entry != rhs.entry && lhs.str() < rhs.str(); }
+
+private:
+    friend struct std::hash<Symbol>;
+
+    struct Entry {
+        std::string text;
+        uint32_t id;
+    };
+
+    struct Table;
+
+    Entry const * entry = nullptr;
+
+    static Table & table();
+
+    static std::string const & emptyString();
+};
+
+} // namespace caffql
+
+namespace std {
+template <>
+struct hash<caffql::Symbol> {
+    size_t operator()(caffql::Symbol symbol) const { return std::hash<void const *>{}(symbol.entry); }
+};
+} // namespace std
@@ -1,5 +1,13 @@
-#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
 #include "CodeGeneration.hpp"
+#include "Depfile.hpp"
+#include "InputBuffer.hpp"
+#include "OutputFile.hpp"
+#include "SchemaCache.hpp"
+#include "SchemaLoader.hpp"
+#include "SelectionManifest.hpp"
 #include "cxxopts.hpp"
 
 namespace caffql {
@@ -9,6 +17,16 @@ struct ProgramInputs {
     std::string outputFile;
     std::string generatedNamespace;
     AlgebraicNamespace algebraicNamespace;
+    InputMode inputMode;
+    std::optional<std::string> schemaCacheFile;
+    std::optional<std::string> selectionFile;
+    size_t jobs;
+    std::optional<std::string> depfile;
+    std::optional<std::string> splitOutputDirectory;
+    std::optional<std::string> sourceFile;
+    ResponseDecoding responseDecoding;
+    QueryFormat queryFormat;
+    SelectionDepth selectionDepth;
 };
 
 ProgramInputs parseCommandLine(int argc, char * argv[]) {
@@ -17,10 +35,50 @@ ProgramInputs parseCommandLine(int argc, char * argv[]) {
                 "caffql",
                 "Generate c++ types and GraphQL request and response serialization from a GraphQL json schema "
                 "file.");
-        options.add_options()("s,schema", "input json schema file", cxxopts::value<std::string>())(
+        options.add_options()(
+                "s,schema", "input json schema file, or - for stdin", cxxopts::value<std::string>())(
                 "o,output", "output generated header file", cxxopts::value<std::string>())(
                 "n,namespace", "generated namespace", cxxopts::value<std::string>()->default_value("caffql"))(
-                "a,absl", "use absl optional and variant instead of std")("h,help", "help");
+                "a,absl", "use absl optional and variant instead of std")(
+                "no-mmap", "read the schema file into memory instead of memory mapping it")(
+                "schema-cache",
+                "binary schema cache file, loaded instead of parsing the schema when it is up to date and rewritten "
+                "otherwise",
+                cxxopts::value<std::string>())(
+                "selection",
+                "json selection manifest naming the operations to generate and the fields they select, with the "
+                "generated types only holding the selected fields",
+                cxxopts::value<std::string>())(
+                "j,jobs",
+                "number of threads to generate types on, or 0 for one per hardware thread",
+                cxxopts::value<size_t>()->default_value("1"))(
+                "depfile",
+                "write a make style dependency file naming the schema the output, source and split headers were "
+                "generated from",
+                cxxopts::value<std::string>())(
+                "split-output",
+                "generate a header per type and operation namespace into this directory, with the output file "
+                "including them all",
+                cxxopts::value<std::string>())(
+                "source",
+                "define the (de)serialization, request and response functions in this generated source file, "
+                "leaving only their declarations in the headers",
+                cxxopts::value<std::string>())(
+                "decoder",
+                "also generate decodeResponse functions, which decode response bodies without building json values, "
+                "with the json SAX parser (sax) or with simdjson On Demand (on-demand)",
+                cxxopts::value<std::string>())(
+                "compact-queries",
+                "generate queries without insignificant whitespace and with short variable names, keeping the "
+                "descriptive names for the request function parameters")(
+                "max-depth",
+                "most levels of selection sets that generated queries nest, leaving out the fields below them, or 0 "
+                "for no limit",
+                cxxopts::value<size_t>()->default_value("0"))(
+                "operation-max-depth",
+                "most levels of selection sets of a single operation, as <operation type>.<field>=<depth>, "
+                "overriding --max-depth",
+                cxxopts::value<std::vector<std::string>>())("h,help", "help");
 
         auto result = options.parse(argc, argv);
 
@@ -39,10 +97,62 @@ ProgramInputs parseCommandLine(int argc, char * argv[]) {
             exit(1);
         }
 
+        auto jobs = result["jobs"].as<size_t>();
+        if (jobs == 0) {
+            jobs = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        auto responseDecoding = ResponseDecoding::Dom;
+        if (result.count("decoder")) {
+            auto const decoder = result["decoder"].as<std::string>();
+            if (decoder == "sax") {
+                responseDecoding = ResponseDecoding::Sax;
+            } else if (decoder == "on-demand") {
+                responseDecoding = ResponseDecoding::OnDemand;
+            } else {
+                printf("decoder must be sax or on-demand\n");
+                exit(1);
+            }
+        }
+
+        SelectionDepth selectionDepth;
+        selectionDepth.maxDepth = result["max-depth"].as<size_t>();
+        if (result.count("operation-max-depth")) {
+            for (auto const & limit : result["operation-max-depth"].as<std::vector<std::string>>()) {
+                auto const dot = limit.find('.');
+                auto const equals = limit.find('=', dot == std::string::npos ? 0 : dot);
+                size_t maxDepth = 0;
+                size_t parsedLength = 0;
+                try {
+                    maxDepth = std::stoul(limit.substr(equals + 1), &parsedLength);
+                } catch (std::logic_error const &) {
+                    parsedLength = 0;
+                }
+                if (dot == std::string::npos || equals == std::string::npos || parsedLength == 0 ||
+                    parsedLength != limit.size() - equals - 1) {
+                    printf("operation-max-depth must be <operation type>.<field>=<depth>\n");
+                    exit(1);
+                }
+                selectionDepth.operationMaxDepths[{Symbol{limit.substr(0, dot)},
+                                                   Symbol{limit.substr(dot + 1, equals - dot - 1)}}] = maxDepth;
+            }
+        }
+
         return {result["schema"].as<std::string>(),
                 result["output"].as<std::string>(),
                 result["namespace"].as<std::string>(),
-                result.count("absl") ? AlgebraicNamespace::Absl : AlgebraicNamespace::Std};
+                result.count("absl") ? AlgebraicNamespace::Absl : AlgebraicNamespace::Std,
+                result.count("no-mmap") ? InputMode::Buffered : InputMode::Mapped,
+                result.count("schema-cache") ? std::optional{result["schema-cache"].as<std::string>()} : std::nullopt,
+                result.count("selection") ? std::optional{result["selection"].as<std::string>()} : std::nullopt,
+                jobs,
+                result.count("depfile") ? std::optional{result["depfile"].as<std::string>()} : std::nullopt,
+                result.count("split-output") ? std::optional{result["split-output"].as<std::string>()}
+                                             : std::nullopt,
+                result.count("source") ? std::optional{result["source"].as<std::string>()} : std::nullopt,
+                responseDecoding,
+                result.count("compact-queries") ? QueryFormat::Compact : QueryFormat::Indented,
+                std::move(selectionDepth)};
     } catch (cxxopts::OptionException const & e) {
         printf("Error parsing options: %s\n", e.what());
         exit(1);
@@ -57,15 +167,125 @@ int main(int argc, char * argv[]) {
     auto const inputs = parseCommandLine(argc, argv);
 
     try {
-        std::ifstream file(inputs.schemaFile);
-        auto const json = Json::parse(file);
-        Schema schema = json.at("data").at("__schema");
+        auto selectionDepth = inputs.selectionDepth;
+
+        auto const schema = [&] {
+            auto const input = InputBuffer::open(inputs.schemaFile, inputs.inputMode);
+            auto schema = inputs.schemaCacheFile ? loadSchemaWithCache(input.view(), *inputs.schemaCacheFile)
+                                                 : loadSchema(input.view());
+            if (inputs.selectionFile) {
+                auto const selectionInput = InputBuffer::open(*inputs.selectionFile, inputs.inputMode);
+                auto const selection = selectionInput.view();
+                Json manifest;
+                try {
+                    manifest = Json::parse(selection.begin(), selection.end());
+                } catch (Json::parse_error const & e) {
+                    throw std::invalid_argument{std::string{"Error parsing selection manifest: "} + e.what()};
+                }
+                schema = selectFields(schema, manifest);
+                selectionDepth.operationSelections = operationSelections(manifest);
+            }
+
+            // The types only hold the fields that the queries generated with the same limits select.
+            if (selectionDepth.isLimited()) {
+                schema = limitSelectionDepth(schema, selectionDepth);
+            }
+            return schema;
+        }();
+
+        namespace fs = std::filesystem;
+
+        auto const functions = inputs.sourceFile ? FunctionPart::Declaration : FunctionPart::InlineDefinition;
+
+        auto out = OutputFile::create(inputs.outputFile);
+
+        std::vector<std::string> outputPaths{inputs.outputFile};
+
+        if (inputs.splitOutputDirectory) {
+            fs::path const directory{*inputs.splitOutputDirectory};
+            fs::create_directories(directory);
+
+            auto writeHeader = [&](std::string const & headerName, std::string_view code) {
+                auto header = OutputFile::create((directory / headerName).string());
+                header.write(code);
+                header.close();
+            };
+
+            auto const headerNames = generateSplitTypes(
+                    writeHeader,
+                    schema,
+                    inputs.generatedNamespace,
+                    inputs.algebraicNamespace,
+                    inputs.jobs,
+                    functions,
+                    inputs.responseDecoding,
+                    inputs.queryFormat,
+                    selectionDepth);
+
+            // The umbrella header includes the headers relative to itself.
+            auto const umbrellaDirectory = fs::absolute(inputs.outputFile).parent_path();
+            auto const includeDirectory = fs::absolute(directory).lexically_relative(umbrellaDirectory);
+            std::vector<std::string> includePaths;
+            includePaths.reserve(headerNames.size());
+            for (auto const & headerName : headerNames) {
+                includePaths.push_back((includeDirectory / headerName).generic_string());
+                outputPaths.push_back((directory / headerName).string());
+            }
+
+            out.write(generateUmbrellaHeader(includePaths));
+        } else {
+            CodeWriter writer{[&](std::string_view code) { out.write(code); }};
+            generateTypes(
+                    writer,
+                    schema,
+                    inputs.generatedNamespace,
+                    inputs.algebraicNamespace,
+                    inputs.jobs,
+                    functions,
+                    inputs.responseDecoding,
+                    inputs.queryFormat,
+                    selectionDepth);
+            writer.flush();
+        }
 
-        auto const source = generateTypes(schema, inputs.generatedNamespace, inputs.algebraicNamespace);
-        std::ofstream out(inputs.outputFile);
-        out << source;
         out.close();
 
+        if (inputs.sourceFile) {
+            // The source includes the header, or the umbrella header of split output, relative to itself.
+            auto const sourceDirectory = fs::absolute(*inputs.sourceFile).parent_path();
+            auto const headerIncludePath = fs::absolute(inputs.outputFile).lexically_relative(sourceDirectory);
+
+            auto source = OutputFile::create(*inputs.sourceFile);
+            CodeWriter writer{[&](std::string_view code) { source.write(code); }};
+            generateSource(
+                    writer,
+                    schema,
+                    inputs.generatedNamespace,
+                    inputs.algebraicNamespace,
+                    headerIncludePath.generic_string(),
+                    inputs.jobs,
+                    inputs.responseDecoding,
+                    inputs.queryFormat,
+                    selectionDepth);
+            writer.flush();
+            source.close();
+            outputPaths.push_back(*inputs.sourceFile);
+        }
+
+        if (inputs.depfile) {
+            std::vector<std::string> prerequisites;
+            if (inputs.schemaFile != standardInputPath) {
+                prerequisites.push_back(inputs.schemaFile);
+            }
+            if (inputs.selectionFile) {
+                prerequisites.push_back(*inputs.selectionFile);
+            }
+
+            auto depfile = OutputFile::create(*inputs.depfile);
+            depfile.write(generateDepfile(outputPaths, prerequisites));
+            depfile.close();
+        }
+
         printf("Generated %s with namespace %s from %s using %s optional and variant\n",
                inputs.outputFile.c_str(),
                inputs.generatedNamespace.c_str(),
@@ -73,7 +293,7 @@ int main(int argc, char * argv[]) {
                algrebraicNamespaceName(inputs.algebraicNamespace).c_str());
 
         return 0;
-    } catch (std::ios_base::failure const & e) {
+    } catch (std::system_error const & e) {
         printf("File error: %s\n", e.what());
     } catch (Json::parse_error const & e) {
         printf("Error parsing schema file: %s\n", e.what());
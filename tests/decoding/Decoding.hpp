@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+// The root fields of decoding/schema.json, whose responses are decoded.
+enum class Operation { Viewer, Node, Search };
+
+// Each decodes a response body of the operation with one of the generated decoders, and describes the decoded response
+// as text, so that the decoders can be compared.
+std::string decodeWithJson(Operation operation, std::string const & body);
+std::string decodeWithSax(Operation operation, std::string const & body);
+std::string decodeWithOnDemand(Operation operation, std::string const & body);
@@ -0,0 +1,101 @@
+#include "Decoding.hpp"
+#include "doctest.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct Response {
+    Operation operation;
+    std::string body;
+    // The description of the decoded response, or "error" for responses that decoders reject.
+    std::string decoded;
+};
+
+std::string decodeOrError(
+        std::string (*decode)(Operation operation, std::string const & body), Response const & response) {
+    try {
+        return decode(response.operation, response.body);
+    } catch (std::exception const &) {
+        return "error";
+    }
+}
+
+std::vector<Response> const responses = {
+        {Operation::Viewer,
+         R"({"data":{"viewer":{"id":"u1","name":"Ada","mood":"HAPPY","score":1.5}}})",
+         R"(User{id:"u1",name:"Ada",mood:HAPPY,score:1.5,friends:null})"},
+        {Operation::Viewer,
+         R"({"extensions":{"cost":[1,{"a":null}]},"data":{"viewer":{"score":null,"unselected":{"b":[true]},)"
+         R"("id":"u2","name":"Line\nbreak \"quoted\" é 😀","mood":"ANGRY"}}})",
+         "User{id:\"u2\",name:\"Line\\nbreak \\\"quoted\\\" \xc3\xa9 \xf0\x9f\x98\x80\",mood:Unknown,score:null,"
+         "friends:null}"},
+        {Operation::Viewer,
+         R"({"data":{"viewer":{"id":"u3","name":"Bo","mood":null,"score":2,"friends":[)"
+         R"({"id":"u4","name":"Cy","mood":"SAD","score":-0.25,"friends":null},)"
+         R"({"id":"u5","name":"Di","mood":"HAPPY","score":1e3,"friends":[{"id":"u3","name":"Bo"}]}]}}})",
+         R"(User{id:"u3",name:"Bo",mood:null,score:2.0,friends:[)"
+         R"(User{id:"u4",name:"Cy",mood:SAD,score:-0.25,friends:null},)"
+         R"(User{id:"u5",name:"Di",mood:HAPPY,score:1000.0,friends:[)"
+         R"(User{id:"u3",name:"Bo",mood:null,score:null,friends:null}]}]})"},
+        {Operation::Viewer,
+         R"({"data":{"viewer":{"id":"u1","name":"Ada","id":"u2"}}})",
+         R"(User{id:"u2",name:"Ada",mood:null,score:null,friends:null})"},
+        {Operation::Viewer, R"({"data":{"viewer":{"id":"u1","id":"u2"}}})", "error"},
+        {Operation::Viewer,
+         R"({"errors":[{"message":"First","message":"Second"}]})",
+         R"([GraphqlError{message:"Second"}])"},
+        {Operation::Viewer,
+         R"({"data":null,"errors":[{"message":"PersistedQueryNotFound","locations":[]},{"message":"Other"}]})",
+         R"([GraphqlError{message:"PersistedQueryNotFound"},GraphqlError{message:"Other"}])"},
+        {Operation::Node,
+         R"({"data":{"node":{"__typename":"Post","id":"p1","title":"Hello","likes":-3,"published":true,)"
+         R"("tags":["a","b"],"author":{"id":"u1","name":"Ada","mood":"SAD","score":0}}}})",
+         R"(Post{id:"p1",title:"Hello",likes:-3,published:true,tags:["a","b"],)"
+         R"(author:User{id:"u1",name:"Ada",mood:SAD,score:0.0,friends:null}})"},
+        {Operation::Node,
+         R"({"data":{"node":{"id":"u1","name":"Ada","mood":"HAPPY","score":null,"__typename":"User"}}})",
+         R"(User{id:"u1",name:"Ada",mood:HAPPY,score:null,friends:null})"},
+        {Operation::Node,
+         R"({"data":{"node":{"__typename":"Comment","id":"c1","text":{"nested":["x"]}}}})",
+         R"(UnknownNode{id:"c1"})"},
+        {Operation::Node, R"({"data":{"node":null}})", "null"},
+        {Operation::Search,
+         R"({"data":{"search":[{"__typename":"User","id":"u1","name":"Ada","mood":"HAPPY","score":1},)"
+         R"({"__typename":"Comment","id":"c1"},)"
+         R"({"title":null,"likes":0,"published":false,"tags":[],"__typename":"Post","id":"p1",)"
+         R"("author":{"id":"u2","name":"Bo","mood":null,"score":null}}]}})",
+         R"([User{id:"u1",name:"Ada",mood:HAPPY,score:1.0,friends:null},Unknown,)"
+         R"(Post{id:"p1",title:null,likes:0,published:false,tags:[],)"
+         R"(author:User{id:"u2",name:"Bo",mood:null,score:null,friends:null}}])"},
+        {Operation::Search, R"({"data":{"search":[]}})", "[]"},
+};
+
+} // namespace
+
+TEST_CASE("json decoding") {
+    for (auto const & response : responses) {
+        CAPTURE(response.body);
+        CHECK(decodeOrError(&decodeWithJson, response) == response.decoded);
+    }
+}
+
+TEST_CASE("sax decoding") {
+    for (auto const & response : responses) {
+        CAPTURE(response.body);
+        CHECK(decodeOrError(&decodeWithSax, response) == response.decoded);
+    }
+}
+
+#ifdef CAFFQL_TEST_ON_DEMAND
+TEST_CASE("on demand decoding") {
+    for (auto const & response : responses) {
+        CAPTURE(response.body);
+        CHECK(decodeOrError(&decodeWithOnDemand, response) == response.decoded);
+    }
+}
+#else
+// Reported as skipped, as the build found no simdjson library to link the On Demand decoder with.
+TEST_CASE("on demand decoding" * doctest::skip()) {}
+#endif
@@ -0,0 +1,106 @@
+// Describes the types generated from decoding/schema.json as text. It is included after a generated header, in a
+// source where `generated` names the generated namespace, and only has internal linkage so that the sources of both
+// decoders can include it.
+
+namespace {
+
+std::string describe(std::string const & value);
+std::string describe(bool value);
+std::string describe(int32_t value);
+std::string describe(double value);
+std::string describe(generated::Mood value);
+std::string describe(generated::monostate);
+std::string describe(generated::User const & user);
+std::string describe(generated::Post const & post);
+std::string describe(generated::UnknownNode const & node);
+std::string describe(generated::Node const & node);
+std::string describe(generated::GraphqlError const & error);
+
+template <typename T>
+std::string describe(generated::optional<T> const & value);
+
+template <typename T>
+std::string describe(generated::BoxedOptional<T> const & box);
+
+template <typename T>
+std::string describe(std::vector<T> const & values);
+
+template <typename... Types>
+std::string describe(generated::variant<Types...> const & value);
+
+template <typename T>
+std::string describe(generated::optional<T> const & value) {
+    return value ? describe(*value) : "null";
+}
+
+template <typename T>
+std::string describe(generated::BoxedOptional<T> const & box) {
+    return box ? describe(*box) : "null";
+}
+
+template <typename T>
+std::string describe(std::vector<T> const & values) {
+    std::string description = "[";
+    for (auto const & value : values) {
+        if (description.size() > 1) {
+            description += ',';
+        }
+        description += describe(value);
+    }
+    return description + ']';
+}
+
+template <typename... Types>
+std::string describe(generated::variant<Types...> const & value) {
+    return generated::visit([](auto const & alternative) { return describe(alternative); }, value);
+}
+
+std::string describe(std::string const & value) {
+    return generated::Json(value).dump();
+}
+
+std::string describe(bool value) {
+    return value ? "true" : "false";
+}
+
+std::string describe(int32_t value) {
+    return std::to_string(value);
+}
+
+std::string describe(double value) {
+    return generated::Json(value).dump();
+}
+
+std::string describe(generated::Mood value) {
+    auto const name = generated::to_string_view(value);
+    return name.empty() ? "Unknown" : std::string{name};
+}
+
+std::string describe(generated::monostate) {
+    return "Unknown";
+}
+
+std::string describe(generated::User const & user) {
+    return "User{id:" + describe(user.id) + ",name:" + describe(user.name) + ",mood:" + describe(user.mood) +
+           ",score:" + describe(user.score) + ",friends:" + describe(user.friends) + "}";
+}
+
+std::string describe(generated::Post const & post) {
+    return "Post{id:" + describe(post.id) + ",title:" + describe(post.title) + ",likes:" + describe(post.likes) +
+           ",published:" + describe(post.published) + ",tags:" + describe(post.tags) +
+           ",author:" + describe(post.author) + "}";
+}
+
+std::string describe(generated::UnknownNode const & node) {
+    return "UnknownNode{id:" + describe(node.id) + "}";
+}
+
+std::string describe(generated::Node const & node) {
+    return describe(node.implementation);
+}
+
+std::string describe(generated::GraphqlError const & error) {
+    return "GraphqlError{message:" + describe(error.message) + "}";
+}
+
+} // namespace
@@ -0,0 +1,17 @@
+#include "Decoding.hpp"
+#include "OnDemand.hpp"
+
+namespace generated = onDemand;
+#include "Describe.hpp"
+
+std::string decodeWithOnDemand(Operation operation, std::string const & body) {
+    switch (operation) {
+    case Operation::Viewer:
+        return describe(generated::Query::ViewerField::decodeResponse(body));
+    case Operation::Node:
+        return describe(generated::Query::NodeField::decodeResponse(body));
+    case Operation::Search:
+        return describe(generated::Query::SearchField::decodeResponse(body));
+    }
+    return {};
+}
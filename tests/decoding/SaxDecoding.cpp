@@ -0,0 +1,30 @@
+#include "Decoding.hpp"
+#include "Sax.hpp"
+
+namespace generated = sax;
+#include "Describe.hpp"
+
+std::string decodeWithJson(Operation operation, std::string const & body) {
+    auto const json = generated::Json::parse(body);
+    switch (operation) {
+    case Operation::Viewer:
+        return describe(generated::Query::ViewerField::response(json));
+    case Operation::Node:
+        return describe(generated::Query::NodeField::response(json));
+    case Operation::Search:
+        return describe(generated::Query::SearchField::response(json));
+    }
+    return {};
+}
+
+std::string decodeWithSax(Operation operation, std::string const & body) {
+    switch (operation) {
+    case Operation::Viewer:
+        return describe(generated::Query::ViewerField::decodeResponse(body));
+    case Operation::Node:
+        return describe(generated::Query::NodeField::decodeResponse(body));
+    case Operation::Search:
+        return describe(generated::Query::SearchField::decodeResponse(body));
+    }
+    return {};
+}
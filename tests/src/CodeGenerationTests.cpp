@@ -1,4 +1,5 @@
 #include "CodeGeneration.hpp"
+#include "Sha256.hpp"
 #include "doctest.h"
 
 using namespace caffql;
@@ -24,18 +25,68 @@ TEST_CASE("custom type sorting") {
         // Has field of type A with argument of type F
         Type g{TypeKind::Object, "G", "", {Field{a, "a", "", {InputValue{f}}}}};
 
-        auto sorted = sortCustomTypesByDependencyOrder({g, f, e, d, c, b, a});
-        CHECK(sorted == std::vector{a, b, c, d, e, f, g});
+        TypeMap typeMap{{g, f, e, d, c, b, a}};
+        auto sorted = sortCustomTypesByDependencyOrder(typeMap);
+        CHECK(sorted == std::vector<TypeIndex>{6, 5, 4, 3, 2, 1, 0});
     }
 
-    SUBCASE("throws on circular type references") {
+    SUBCASE("sorts types that become ready in alphabetical passes") {
+        Type a{TypeKind::Object, "A", "", {Field{TypeRef{TypeKind::Object, "B"}, "b"}}};
+        Type b{TypeKind::Object, "B"};
+        Type c{TypeKind::Object, "C"};
+
+        // A is only ready after B, which the pass reaches after A, so A waits for the next pass.
+        TypeMap typeMap{{a, b, c}};
+        CHECK(sortCustomTypesByDependencyOrder(typeMap) == std::vector<TypeIndex>{1, 2, 0});
+    }
+
+    SUBCASE("sorts long dependency chains") {
+        // Each type depends on the next, so every type is only ready after the one alphabetically after it. The chain
+        // is long enough that a recursive sort would overflow the stack.
+        constexpr TypeIndex count = 20000;
+        auto name = [](TypeIndex index) {
+            auto const digits = std::to_string(index);
+            return "T" + std::string(5 - digits.size(), '0') + digits;
+        };
+
+        std::vector<Type> types;
+        for (TypeIndex index = 0; index < count; ++index) {
+            Type type{TypeKind::Object, name(index)};
+            if (index + 1 < count) {
+                type.fields = {Field{TypeRef{TypeKind::Object, name(index + 1)}, "next"}};
+            }
+            types.push_back(type);
+        }
+
+        TypeMap typeMap{std::move(types)};
+
+        auto sorted = sortCustomTypesByDependencyOrder(typeMap);
+
+        REQUIRE(sorted.size() == count);
+        for (TypeIndex index = 0; index < count; ++index) {
+            CHECK(sorted[index] == count - 1 - index);
+        }
+    }
+
+    SUBCASE("groups circular type references into recursive components") {
         Type a{TypeKind::Object, "A", "", {Field{TypeRef{TypeKind::Object, "B"}, "b"}}};
         Type b{TypeKind::Object, "B", "", {Field{TypeRef{TypeKind::Object, "A"}, "a"}}};
-        CHECK_THROWS(sortCustomTypesByDependencyOrder({a, b}));
+        // Depends on the cycle
+        Type c{TypeKind::Object, "C", "", {Field{TypeRef{TypeKind::Object, "A"}, "a"}}};
+        // References itself
+        Type d{TypeKind::Object, "D", "", {Field{TypeRef{TypeKind::Object, "D"}, "d"}}};
+        Type e{TypeKind::Enum, "E"};
+
+        TypeMap typeMap{{d, c, b, a, e}};
+        auto components = sortCustomTypeComponentsByDependencyOrder(typeMap);
+        CHECK(components == std::vector<TypeComponent>{{{3, 2}, true}, {{1}, false}, {{0}, true}, {{4}, false}});
+        CHECK(sortCustomTypesByDependencyOrder(typeMap) == std::vector<TypeIndex>{3, 2, 1, 0, 4});
+        CHECK(boxedTypes(components, typeMap) == BoxedTypes{"A", "B", "D"});
     }
 
     SUBCASE("filters out non custom types") {
-        auto types = sortCustomTypesByDependencyOrder({{TypeKind::Scalar}, {TypeKind::List}, {TypeKind::NonNull}});
+        auto types = sortCustomTypesByDependencyOrder(
+                TypeMap{{{TypeKind::Scalar}, {TypeKind::List}, {TypeKind::NonNull}}});
         CHECK(types.empty());
     }
 }
@@ -46,6 +97,26 @@ TEST_CASE("string conversion functions") {
     CHECK(uncapitalize("Text") == "text");
 }
 
+TEST_CASE("type references") {
+    TypeRef objectType{TypeKind::Object, "Object"};
+    TypeRef nonNullListOfObject{TypeKind::NonNull, {}, TypeRef{TypeKind::List, {}, objectType}};
+
+    CHECK(nonNullListOfObject.kind() == TypeKind::NonNull);
+    CHECK_FALSE(nonNullListOfObject.hasName());
+    CHECK(nonNullListOfObject.ofType() == TypeRef{TypeKind::List, {}, objectType});
+    CHECK(nonNullListOfObject.ofType().ofType() == objectType);
+    CHECK(nonNullListOfObject.underlyingType() == objectType);
+    CHECK(nonNullListOfObject.underlyingType().name() == Symbol{"Object"});
+    CHECK_FALSE(objectType.hasOfType());
+
+    SUBCASE("named kinds ignore ofType") { CHECK(TypeRef{TypeKind::Object, "Object", TypeRef{}} == objectType); }
+
+    SUBCASE("type names are memoized") {
+        CHECK(&cppTypeName(nonNullListOfObject) == &cppTypeName(TypeRef{nonNullListOfObject}));
+        CHECK(&graphqlTypeName(nonNullListOfObject) == &graphqlTypeName(TypeRef{nonNullListOfObject}));
+    }
+}
+
 TEST_CASE("cpp type name") {
     TypeRef objectType{TypeKind::Object, "Object"};
     CHECK(cppTypeName(objectType) == "optional<Object>");
@@ -56,6 +127,22 @@ TEST_CASE("cpp type name") {
           "std::vector<Object>");
 }
 
+TEST_CASE("cpp boxed type name") {
+    TypeRef objectType{TypeKind::Object, "Object"};
+    CHECK(cppBoxedTypeName(objectType) == "BoxedOptional<Object>");
+    CHECK(cppBoxedTypeName(TypeRef{TypeKind::NonNull, {}, objectType}) == "BoxedOptional<Object>");
+    CHECK(cppBoxedTypeName(TypeRef{TypeKind::List, {}, objectType}) ==
+          "optional<std::vector<BoxedOptional<Object>>>");
+    CHECK(cppBoxedTypeName(TypeRef{
+                  TypeKind::NonNull, {}, TypeRef{TypeKind::List, {}, TypeRef{TypeKind::NonNull, {}, objectType}}}) ==
+          "std::vector<BoxedOptional<Object>>");
+
+    CHECK(cppMemberTypeName(objectType, {"Object"}) == "BoxedOptional<Object>");
+    CHECK(cppMemberTypeName(objectType, {"Other"}) == "optional<Object>");
+    CHECK(cppMemberTypeName(TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::List, {}, objectType}}, {"Object"}) ==
+          "optional<std::vector<BoxedOptional<Object>>>");
+}
+
 TEST_CASE("graphql type name") {
     TypeRef objectType{TypeKind::Object, "Object"};
     CHECK(graphqlTypeName(objectType) == "Object");
@@ -108,11 +195,56 @@ TEST_CASE("enum generation") {
 
     SUBCASE("serialization") {
         std::string expected = R"(
-        NLOHMANN_JSON_SERIALIZE_ENUM(EnumType, {
-            {EnumType::Unknown, nullptr},
-            {EnumType::CaseOne, "CASE_ONE"},
-            {EnumType::CaseTwo, "CASE_TWO"},
-        });
+        constexpr string_view to_string_view(EnumType value) {
+            switch (value) {
+            case EnumType::CaseOne:
+                return "CASE_ONE";
+            case EnumType::CaseTwo:
+                return "CASE_TWO";
+            case EnumType::Unknown:
+                break;
+            }
+            return {};
+        }
+
+        inline void from_string_view(string_view name, EnumType & value) {
+            switch (name.size()) {
+            case 8:
+                switch (name[5]) {
+                case 'O':
+                    if (name == "CASE_ONE") {
+                        value = EnumType::CaseOne;
+                        return;
+                    }
+                    break;
+                case 'T':
+                    if (name == "CASE_TWO") {
+                        value = EnumType::CaseTwo;
+                        return;
+                    }
+                    break;
+                }
+                break;
+            }
+            value = EnumType::Unknown;
+        }
+
+        inline void to_json(Json & json, EnumType const & value) {
+            auto const name = to_string_view(value);
+            if (name.empty()) {
+                json = nullptr;
+            } else {
+                json = std::string(name.data(), name.size());
+            }
+        }
+
+        inline void from_json(Json const & json, EnumType & value) {
+            if (json.is_string()) {
+                from_string_view(json.get_ref<std::string const &>(), value);
+            } else {
+                value = EnumType::Unknown;
+            }
+        }
 
 )";
         CHECK("\n" + generateEnumSerialization(enumType, 2) == expected);
@@ -154,14 +286,26 @@ TEST_CASE("interface generation") {
         }
 
         inline void from_json(Json const & json, InterfaceType & value) {
-            std::string occupiedType = json.at("__typename");
-            if (occupiedType == "A") {
-                value = {A(json)};
-            } else if (occupiedType == "B") {
-                value = {B(json)};
-            } else {
-                value = {UnknownInterfaceType(json)};
+            auto const & occupiedType = json.at("__typename").get_ref<std::string const &>();
+            switch (occupiedType.size()) {
+            case 1:
+                switch (occupiedType[0]) {
+                case 'A':
+                    if (occupiedType == "A") {
+                        value = {A(json)};
+                        return;
+                    }
+                    break;
+                case 'B':
+                    if (occupiedType == "B") {
+                        value = {B(json)};
+                        return;
+                    }
+                    break;
+                }
+                break;
             }
+            value = {UnknownInterfaceType(json)};
         }
 
 )";
@@ -169,6 +313,55 @@ TEST_CASE("interface generation") {
     }
 }
 
+TEST_CASE("string dispatch generation") {
+    std::vector<std::string_view> const names = {"Post", "Comment", "User", "Product", "Pin"};
+    auto const generateMatch = [&](size_t index) { return "value = " + std::to_string(index) + ";"; };
+
+    auto const expected = R"(
+        switch (name.size()) {
+        case 3:
+            if (name == "Pin") {
+                value = 4;
+                return;
+            }
+            break;
+        case 4:
+            switch (name[0]) {
+            case 'P':
+                if (name == "Post") {
+                    value = 0;
+                    return;
+                }
+                break;
+            case 'U':
+                if (name == "User") {
+                    value = 2;
+                    return;
+                }
+                break;
+            }
+            break;
+        case 7:
+            switch (name[0]) {
+            case 'C':
+                if (name == "Comment") {
+                    value = 1;
+                    return;
+                }
+                break;
+            case 'P':
+                if (name == "Product") {
+                    value = 3;
+                    return;
+                }
+                break;
+            }
+            break;
+        }
+)";
+    CHECK("\n" + generateStringDispatch("name", names, generateMatch, 1) == expected);
+}
+
 TEST_CASE("union generation") {
     Type unionType{TypeKind::Union, "UnionType"};
     unionType.possibleTypes = {TypeRef{TypeKind::Object, "A"}, TypeRef{TypeKind::Object, "B"}};
@@ -185,14 +378,26 @@ TEST_CASE("union generation") {
     SUBCASE("deserialization") {
         std::string expected = R"(
         inline void from_json(Json const & json, UnionType & value) {
-            std::string occupiedType = json.at("__typename");
-            if (occupiedType == "A") {
-                value = {A(json)};
-            } else if (occupiedType == "B") {
-                value = {B(json)};
-            } else {
-                value = {UnknownUnionType()};
+            auto const & occupiedType = json.at("__typename").get_ref<std::string const &>();
+            switch (occupiedType.size()) {
+            case 1:
+                switch (occupiedType[0]) {
+                case 'A':
+                    if (occupiedType == "A") {
+                        value = {A(json)};
+                        return;
+                    }
+                    break;
+                case 'B':
+                    if (occupiedType == "B") {
+                        value = {B(json)};
+                        return;
+                    }
+                    break;
+                }
+                break;
             }
+            value = {UnknownUnionType()};
         }
 
 )";
@@ -224,6 +429,734 @@ TEST_CASE("object generation") {
 )";
         CHECK("\n" + generateObjectDeserialization(objectType, 2) == expected);
     }
+
+    SUBCASE("boxed type") {
+        std::string expected = R"(
+        struct ObjectType {
+            BoxedOptional<FieldType> field;
+        };
+
+)";
+
+        CHECK("\n" + generateObject(objectType, 2, {"FieldType"}) == expected);
+    }
+
+    SUBCASE("boxed deserialization is nullable") {
+        std::string expected = R"(
+        inline void from_json(Json const & json, ObjectType & value) {
+            {
+                auto it = json.find("field");
+                if (it != json.end()) {
+                    it->get_to(value.field);
+                } else {
+                    value.field.reset();
+                }
+            }
+        }
+
+)";
+        CHECK("\n" + generateObjectDeserialization(objectType, 2, {"FieldType"}) == expected);
+    }
+}
+
+TEST_CASE("recursive component generation") {
+    Type node{TypeKind::Interface, "Node"};
+    node.fields = {Field{TypeRef{TypeKind::Interface, "Node"}, "parent"}};
+    node.possibleTypes = {TypeRef{TypeKind::Object, "Item"}};
+
+    Type item{TypeKind::Object, "Item"};
+    item.fields = {node.fields[0], Field{TypeRef{TypeKind::Union, "Result"}, "result"}};
+
+    Type result{TypeKind::Union, "Result"};
+    result.possibleTypes = {TypeRef{TypeKind::Object, "Item"}};
+
+    TypeMap typeMap{{node, item, result}};
+    auto const components = sortCustomTypeComponentsByDependencyOrder(typeMap);
+    REQUIRE(components.size() == 1);
+
+    std::string expected = R"(
+    struct Item;
+    struct Node;
+
+    using UnknownResult = monostate;
+    using Result = variant<Item, UnknownResult>;
+
+    struct Item {
+        BoxedOptional<Node> parent;
+        BoxedOptional<Result> result;
+    };
+
+    struct UnknownNode {
+        BoxedOptional<Node> parent;
+    };
+
+    struct Node {
+        variant<Item, UnknownNode> implementation;
+
+        BoxedOptional<Node> const & parent() const {
+            return visit([](auto const & implementation) -> BoxedOptional<Node> const & {
+                return implementation.parent;
+            }, implementation);
+        }
+
+    };
+
+    inline void from_json(Json const & json, Item & value);
+    inline void from_json(Json const & json, Node & value);
+    inline void from_json(Json const & json, Result & value);
+
+)";
+
+    auto const generated =
+            generateRecursiveComponent(components[0], typeMap, boxedTypes(components, typeMap), 1);
+    CHECK("\n" + generated.substr(0, expected.size() - 1) == expected);
+}
+
+TEST_CASE("references out of recursive components are held by value") {
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+
+    Type user{TypeKind::Object, "User"};
+    user.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "Post"}}, "best"}};
+
+    Type post{TypeKind::Object, "Post"};
+    post.fields = {Field{TypeRef{TypeKind::Object, "User"}, "author"}};
+
+    Type comment{TypeKind::Object, "Comment"};
+    comment.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "User"}}, "author"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Object, "Comment"}, "comment"}};
+    schema.types = {user, post, comment, query};
+
+    auto const generated = generateTypes(schema, "caffql", AlgebraicNamespace::Std);
+    CHECK(generated.find("struct Comment {\n        User author;\n    };") != std::string::npos);
+    CHECK(generated.find("struct Post {\n        BoxedOptional<User> author;\n    };") != std::string::npos);
+    CHECK(generated.find("struct User {\n        BoxedOptional<Post> best;\n    };") != std::string::npos);
+}
+
+TEST_CASE("parallel type generation") {
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+
+    Type query{TypeKind::Object, "Query"};
+    for (int i = 0; i < 200; ++i) {
+        auto const name = "Object" + std::to_string(i);
+        Type object{TypeKind::Object, name};
+        object.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "text"}};
+        if (i > 0) {
+            object.fields.push_back(Field{TypeRef{TypeKind::Object, "Object" + std::to_string(i - 1)}, "previous"});
+        }
+        if (i % 50 == 0) {
+            // Recursive with the previous object
+            object.fields.push_back(Field{TypeRef{TypeKind::Object, "Object" + std::to_string(i + 1)}, "next"});
+        }
+        schema.types.push_back(object);
+        query.fields.push_back(Field{TypeRef{TypeKind::Object, name}, "object" + std::to_string(i)});
+    }
+    schema.types.push_back(query);
+
+    auto const expected = generateTypes(schema, "caffql", AlgebraicNamespace::Std);
+
+    CHECK(generateTypes(schema, "caffql", AlgebraicNamespace::Std, 8) == expected);
+
+    std::string streamed;
+    size_t flushes = 0;
+    CodeWriter writer{[&](std::string_view code) {
+        streamed += code;
+        ++flushes;
+    }};
+    generateTypes(writer, schema, "caffql", AlgebraicNamespace::Std, 3);
+    writer.flush();
+    CHECK(streamed == expected);
+    CHECK(flushes > schema.types.size());
+}
+
+TEST_CASE("split type generation") {
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+
+    Type color{TypeKind::Enum, "Color"};
+    color.enumValues = {EnumValue{"RED"}};
+
+    Type leaf{TypeKind::Object, "Leaf"};
+    leaf.fields = {Field{TypeRef{TypeKind::Enum, "Color"}, "color"}};
+
+    Type a{TypeKind::Object, "A"};
+    a.fields = {Field{TypeRef{TypeKind::Object, "B"}, "b"}, Field{TypeRef{TypeKind::Object, "Leaf"}, "leaf"}};
+
+    Type b{TypeKind::Object, "B"};
+    b.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}, Field{TypeRef{TypeKind::Object, "Leaf"}, "leaf"}};
+
+    schema.types = {color, leaf, a, b, query};
+
+    std::vector<std::pair<std::string, std::string>> headers;
+    auto const headerNames = generateSplitTypes(
+            [&](std::string const & name, std::string_view code) { headers.push_back({name, std::string{code}}); },
+            schema,
+            "caffql",
+            AlgebraicNamespace::Std);
+
+    std::vector<std::string> expectedNames{splitCommonHeaderName, "Color.hpp", "Leaf.hpp", "A.hpp", "Query.hpp"};
+    CHECK(headerNames == expectedNames);
+
+    REQUIRE(headers.size() == 6);
+    CHECK(headers[0].first == splitCommonHeaderName);
+    CHECK(headers[3].first == "A.hpp");
+    CHECK(headers[4].first == "B.hpp");
+    CHECK(headers[4].second == R"(// This file was automatically generated and should not be edited.
+#pragma once
+
+#include "A.hpp"
+)");
+
+    std::string expectedLeaf = R"(// This file was automatically generated and should not be edited.
+#pragma once
+
+#include "caffql-common.hpp"
+#include "Color.hpp"
+
+namespace caffql {
+
+    struct Leaf {
+        optional<Color> color;
+    };
+
+)";
+    CHECK(headers[2].second.substr(0, expectedLeaf.size()) == expectedLeaf);
+
+    auto const & queryHeader = headers[5].second;
+    auto const queryIncludes = R"(#include "A.hpp"
+#include "Leaf.hpp"
+
+namespace caffql {
+
+    namespace Query {)";
+    CHECK(queryHeader.find(queryIncludes) != std::string::npos);
+
+    // The headers hold the same code as the single header.
+    auto const single = generateTypes(schema, "caffql", AlgebraicNamespace::Std);
+    std::string const namespaceBegin = "namespace caffql {\n\n";
+    for (auto const & [name, code] : headers) {
+        auto const begin = code.find(namespaceBegin);
+        if (begin != std::string::npos && name != splitCommonHeaderName) {
+            auto const bodyBegin = begin + namespaceBegin.size();
+            auto const body = code.substr(bodyBegin, code.rfind("} // namespace caffql") - bodyBegin);
+            CHECK(single.find(body) != std::string::npos);
+        }
+    }
+
+    CHECK(generateUmbrellaHeader({"types/caffql-common.hpp", "types/A.hpp"}) ==
+          R"(// This file was automatically generated and should not be edited.
+#pragma once
+
+#include "types/caffql-common.hpp"
+#include "types/A.hpp"
+)");
+}
+
+TEST_CASE("out of line function generation") {
+    Type objectType{TypeKind::Object, "ObjectType"};
+    objectType.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "FieldType"}}, "field"}};
+
+    SUBCASE("deserialization") {
+        CodeWriter declaration{1};
+        generateObjectDeserialization(declaration, objectType, {}, FunctionPart::Declaration);
+        CHECK(declaration.str() == "    void from_json(Json const & json, ObjectType & value);\n\n");
+
+        CodeWriter definition{1};
+        generateObjectDeserialization(definition, objectType, {}, FunctionPart::Definition);
+        CHECK(definition.str() == R"(    void from_json(Json const & json, ObjectType & value) {
+        json.at("field").get_to(value.field);
+    }
+
+)");
+    }
+
+    SUBCASE("enum serialization") {
+        Type color{TypeKind::Enum, "Color"};
+        color.enumValues = {EnumValue{"RED"}};
+
+        CodeWriter declaration{1};
+        generateEnumSerialization(declaration, color, FunctionPart::Declaration);
+        CHECK(declaration.str() == R"(    constexpr string_view to_string_view(Color value) {
+        switch (value) {
+        case Color::Red:
+            return "RED";
+        case Color::Unknown:
+            break;
+        }
+        return {};
+    }
+
+    void from_string_view(string_view name, Color & value);
+    void to_json(Json & json, Color const & value);
+    void from_json(Json const & json, Color & value);
+
+)");
+
+        CodeWriter definition{1};
+        generateEnumSerialization(definition, color, FunctionPart::Definition);
+        CHECK(definition.str() == R"(    void from_string_view(string_view name, Color & value) {
+        switch (name.size()) {
+        case 3:
+            if (name == "RED") {
+                value = Color::Red;
+                return;
+            }
+            break;
+        }
+        value = Color::Unknown;
+    }
+
+    void to_json(Json & json, Color const & value) {
+        auto const name = to_string_view(value);
+        if (name.empty()) {
+            json = nullptr;
+        } else {
+            json = std::string(name.data(), name.size());
+        }
+    }
+
+    void from_json(Json const & json, Color & value) {
+        if (json.is_string()) {
+            from_string_view(json.get_ref<std::string const &>(), value);
+        } else {
+            value = Color::Unknown;
+        }
+    }
+
+)");
+    }
+
+    SUBCASE("operation type") {
+        Type fieldType{TypeKind::Object, "FieldType"};
+        Type query{TypeKind::Object, "Query"};
+        query.fields = {Field{TypeRef{TypeKind::Object, "ObjectType"}, "object"}};
+        TypeMap typeMap{{objectType, fieldType, query}};
+
+        CodeWriter declaration{1};
+        generateOperationType(declaration, query.fields[0], Operation::Query, typeMap, FunctionPart::Declaration);
+        CHECK(declaration.str() == R"cpp(    struct ObjectField {
+
+        static Operation constexpr operation = Operation::Query;
+
+        static string_view constexpr requestBodyPrefix = R"({"query":"query Object(\n) {\n    object {\n)cpp"
+                                   R"cpp(        field {\n            __typename\n        }\n    }\n}\n","variables":)";
+
+        static string_view constexpr queryHash = "7447032d7108ebd629cb34e84236a240eef3c8fdb80e39348e7988e9a54d6c5a";
+
+        static string_view constexpr persistedRequestBodyPrefix = R"({"extensions":{"persistedQuery":{"version":1,)cpp"
+                                   R"cpp("sha256Hash":"7447032d7108ebd629cb34e84236a240)cpp"
+                                   R"cpp(eef3c8fdb80e39348e7988e9a54d6c5a"}},)";
+
+        static Json request();
+
+        static void writeVariables(JsonWriter & writer);
+
+        static void writeRequestBody(std::string & body);
+
+        static std::string requestBody();
+
+        static void writePersistedRequestBody(std::string & body, bool includeQuery);
+
+        static std::string persistedRequestBody(bool includeQuery);
+
+        using ResponseData = optional<ObjectType>;
+
+        static GraphqlResponse<ResponseData> response(Json const & json);
+
+    };
+
+)cpp");
+
+        CodeWriter definition{1};
+        generateOperationType(definition, query.fields[0], Operation::Query, typeMap, FunctionPart::Definition);
+        auto const & code = definition.str();
+        CHECK(code.find("    Json ObjectField::request() {\n") == 0);
+        auto const writeVariablesDefinition =
+                "\n    void ObjectField::writeVariables(JsonWriter & writer) {\n        writer.append(\"null\");\n";
+        CHECK(code.find(writeVariablesDefinition) != std::string::npos);
+        CHECK(code.find("\n    std::string ObjectField::requestBody() {\n") != std::string::npos);
+        auto const responseDefinition =
+                "\n    GraphqlResponse<ObjectField::ResponseData> ObjectField::response(Json const & json) {\n";
+        CHECK(code.find(responseDefinition) != std::string::npos);
+        CHECK(code.find("static") == std::string::npos);
+    }
+
+    SUBCASE("header and source") {
+        Schema schema;
+        schema.queryType = Schema::OperationType{"Query"};
+
+        Type a{TypeKind::Object, "A"};
+        a.fields = {Field{TypeRef{TypeKind::Object, "B"}, "b"}};
+
+        Type b{TypeKind::Object, "B"};
+        b.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        Type query{TypeKind::Object, "Query"};
+        query.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        schema.types = {a, b, query};
+
+        auto const header = generateTypes(schema, "caffql", AlgebraicNamespace::Std, 1, FunctionPart::Declaration);
+        CHECK(header.find("#include \"nlohmann/json_fwd.hpp\"\n") != std::string::npos);
+        CHECK(header.find("json.hpp") == std::string::npos);
+        CHECK(header.find("adl_serializer") == std::string::npos);
+        CHECK(header.find("inline ") == std::string::npos);
+        CHECK(header.find("class BoxedOptional") != std::string::npos);
+        CHECK(header.find("#include <mutex>\n") != std::string::npos);
+        CHECK(header.find("        static SharedSlots & sharedSlots() {\n") != std::string::npos);
+        CHECK(header.find("    void from_json(Json const & json, A & value);\n") != std::string::npos);
+        CHECK(header.find("    class JsonWriter {\n") != std::string::npos);
+        CHECK(header.find("    void write_json(JsonWriter & writer, bool value);\n") != std::string::npos);
+
+        auto const source = generateSource(schema, "caffql", AlgebraicNamespace::Std, "Generated.hpp");
+        std::string const expectedPrelude = R"(// This file was automatically generated and should not be edited.
+#include "Generated.hpp"
+#include "nlohmann/json.hpp"
+
+// optional serialization
+)";
+        CHECK(source.substr(0, expectedPrelude.size()) == expectedPrelude);
+        CHECK(source.find("    void from_json(Json const & json, A & value) {\n") != std::string::npos);
+        CHECK(source.find("    void from_json(Json const & json, GraphqlError & value) {\n") != std::string::npos);
+        CHECK(source.find("void from_json(Json const & json, BoxedOptional<T> & box) {\n") != std::string::npos);
+        CHECK(source.find("    void JsonWriter::writeString(string_view text) {\n") != std::string::npos);
+        CHECK(source.find("class JsonWriter") == std::string::npos);
+        CHECK(source.find("struct A") == std::string::npos);
+        CHECK(source.find("class BoxedOptional") == std::string::npos);
+        CHECK(source.find("inline ") == std::string::npos);
+
+        CHECK(generateSource(schema, "caffql", AlgebraicNamespace::Std, "Generated.hpp", 4) == source);
+    }
+}
+
+TEST_CASE("sax decoding generation") {
+    SUBCASE("object") {
+        Type objectType{TypeKind::Object, "ObjectType"};
+        objectType.fields = {
+                Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "String"}}, "required"},
+                Field{TypeRef{TypeKind::Scalar, "Int"}, "optional"},
+                Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "ObjectType"}}, "boxed"}};
+        BoxedTypes const boxed{Symbol{"ObjectType"}};
+
+        CodeWriter writer{1};
+        generateObjectSaxDecoding(writer, objectType, boxed);
+        CHECK(writer.str() == R"(    inline void saxDecode(SaxDecoder & decoder, ObjectType & value, SaxEvent & event) {
+        if (event.kind != SaxEvent::Key) {
+            decoder.decodeObject(value, event, 1);
+        } else if (*event.string == "required") {
+            decoder.expectRequired(value.required, 0);
+        } else if (*event.string == "optional") {
+            decoder.expect(value.optional);
+        } else if (*event.string == "boxed") {
+            decoder.expect(value.boxed);
+        } else {
+            decoder.skip();
+        }
+    }
+
+)");
+
+        CodeWriter declaration{1};
+        generateObjectSaxDecoding(declaration, objectType, boxed, FunctionPart::Declaration);
+        CHECK(declaration.str().empty());
+    }
+
+    SUBCASE("union") {
+        Type unionType{TypeKind::Union, "UnionType"};
+        unionType.possibleTypes = {TypeRef{TypeKind::Object, "A"}, TypeRef{TypeKind::Object, "B"}};
+
+        CodeWriter writer{1};
+        generateUnionSaxDecoding(writer, unionType, FunctionPart::Definition);
+        auto const expected = R"(
+    void saxDecodeAlternative(SaxDecoder & decoder, UnionType & value, std::string const & typeName) {
+        switch (typeName.size()) {
+        case 1:
+            switch (typeName[0]) {
+            case 'A':
+                if (typeName == "A") {
+                    decoder.startObject(value.emplace<A>());
+                    return;
+                }
+                break;
+            case 'B':
+                if (typeName == "B") {
+                    decoder.startObject(value.emplace<B>());
+                    return;
+                }
+                break;
+            }
+            break;
+        }
+        decoder.startObject(value.emplace<UnknownUnionType>());
+    }
+
+    void saxDecode(SaxDecoder & decoder, UnionType & value, SaxEvent & event) {
+        decoder.decodeVariant(value, event);
+    }
+
+)";
+        CHECK("\n" + writer.str() == expected);
+    }
+
+    SUBCASE("interface") {
+        Type interfaceType{TypeKind::Interface, "InterfaceType"};
+        interfaceType.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"}};
+        interfaceType.possibleTypes = {TypeRef{TypeKind::Object, "A"}};
+
+        CodeWriter writer{0};
+        generateInterfaceSaxDecoding(writer, interfaceType);
+        auto const & code = writer.str();
+        auto const unknownCase = R"(
+inline void saxDecode(SaxDecoder & decoder, UnknownInterfaceType & value, SaxEvent & event) {
+    if (event.kind != SaxEvent::Key) {
+        decoder.decodeObject(value, event, 1);
+)";
+        CHECK(("\n" + code).find(unknownCase) == 0);
+        CHECK(code.find("decoder.startObject(value.implementation.emplace<A>());\n") != std::string::npos);
+        CHECK(code.find("decoder.startObject(value.implementation.emplace<UnknownInterfaceType>());\n")
+              != std::string::npos);
+        CHECK(code.find("inline void saxDecode(SaxDecoder & decoder, InterfaceType & value, SaxEvent & event) {\n")
+              != std::string::npos);
+    }
+
+    SUBCASE("operation response decoder") {
+        Field field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "ObjectType"}}, "object"};
+
+        CodeWriter writer{1};
+        generateOperationResponseDecoder(writer, field);
+        auto const expected = R"(
+    static GraphqlResponse<ResponseData> decodeResponse(char const * body, size_t size) {
+        return decodeGraphqlResponse<ResponseData>(body, size, "object", true);
+    }
+
+    static GraphqlResponse<ResponseData> decodeResponse(std::string const & body) {
+        return decodeResponse(body.data(), body.size());
+    }
+
+)";
+        CHECK("\n" + writer.str() == expected);
+
+        CodeWriter definition{0};
+        generateOperationResponseDecoder(definition, field, FunctionPart::Definition);
+        auto const expectedDefinition = R"(
+GraphqlResponse<ObjectField::ResponseData> ObjectField::decodeResponse(char const * body, size_t size) {
+    return decodeGraphqlResponse<ResponseData>(body, size, "object", true);
+}
+
+)";
+        CHECK("\n" + definition.str() == expectedDefinition);
+    }
+
+    SUBCASE("types") {
+        Schema schema;
+        schema.queryType = Schema::OperationType{"Query"};
+
+        Type a{TypeKind::Object, "A"};
+        a.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        Type query{TypeKind::Object, "Query"};
+        query.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        schema.types = {a, query};
+
+        auto const dom = generateTypes(schema, "caffql", AlgebraicNamespace::Std);
+        CHECK(dom.find("Sax") == std::string::npos);
+        CHECK(dom.find("decodeResponse") == std::string::npos);
+
+        auto const sax = generateTypes(
+                schema, "caffql", AlgebraicNamespace::Std, 1, FunctionPart::InlineDefinition, ResponseDecoding::Sax);
+        CHECK(sax.find("class SaxDecoder {\n") != std::string::npos);
+        CHECK(sax.find("void saxDecode(SaxDecoder & decoder, BoxedOptional<T> & box, SaxEvent & event) {\n")
+              != std::string::npos);
+        CHECK(sax.find("inline void saxDecode(SaxDecoder & decoder, A & value, SaxEvent & event) {\n")
+              != std::string::npos);
+        CHECK(sax.find("static GraphqlResponse<ResponseData> decodeResponse(std::string const & body) {\n")
+              != std::string::npos);
+
+        auto const header = generateTypes(
+                schema, "caffql", AlgebraicNamespace::Std, 1, FunctionPart::Declaration, ResponseDecoding::Sax);
+        CHECK(header.find("SaxDecoder {") == std::string::npos);
+        CHECK(header.find("saxDecode(") == std::string::npos);
+        CHECK(header.find("static GraphqlResponse<ResponseData> decodeResponse(char const * body, size_t size);\n")
+              != std::string::npos);
+
+        auto const source =
+                generateSource(schema, "caffql", AlgebraicNamespace::Std, "Generated.hpp", 1, ResponseDecoding::Sax);
+        CHECK(source.find("class SaxDecoder {\n") != std::string::npos);
+        CHECK(source.find("    void saxDecode(SaxDecoder & decoder, A & value, SaxEvent & event) {\n")
+              != std::string::npos);
+        auto const decodeResponseDefinition =
+                "GraphqlResponse<AField::ResponseData> AField::decodeResponse(char const * body, size_t size) {\n";
+        CHECK(source.find(decodeResponseDefinition) != std::string::npos);
+        CHECK(generateSource(schema, "caffql", AlgebraicNamespace::Std, "Generated.hpp", 4, ResponseDecoding::Sax)
+              == source);
+    }
+}
+
+TEST_CASE("on demand decoding generation") {
+    SUBCASE("object") {
+        Type objectType{TypeKind::Object, "ObjectType"};
+        objectType.fields = {
+                Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "String"}}, "required"},
+                Field{TypeRef{TypeKind::Scalar, "Int"}, "optional"}};
+
+        CodeWriter writer{1};
+        generateObjectOnDemandDecoding(writer, objectType);
+        auto const expected = R"(
+    inline void onDemandDecodeMembers(simdjson::ondemand::object object, ObjectType & value) {
+        std::bitset<1> requiredMembers;
+        for (simdjson::ondemand::field field : object) {
+            auto const key = field.key();
+            if (key == "required") {
+                requiredMembers.set(0);
+                onDemandDecode(field.value(), value.required);
+            } else if (key == "optional") {
+                onDemandDecode(field.value(), value.optional);
+            }
+        }
+        if (!requiredMembers.all()) {
+            throw simdjson::simdjson_error(simdjson::NO_SUCH_FIELD);
+        }
+    }
+
+    inline void onDemandDecode(simdjson::ondemand::value json, ObjectType & value) {
+        onDemandDecodeMembers(json.get_object(), value);
+    }
+
+)";
+        CHECK("\n" + writer.str() == expected);
+
+        CodeWriter declaration{1};
+        generateObjectOnDemandDecoding(declaration, objectType, {}, FunctionPart::Declaration);
+        CHECK(declaration.str().empty());
+    }
+
+    SUBCASE("object without fields") {
+        CodeWriter writer{1};
+        generateObjectOnDemandDecoding(writer, Type{TypeKind::Object, "ObjectType"});
+        auto const expected = R"(
+    inline void onDemandDecodeMembers(simdjson::ondemand::object object, ObjectType &) {
+        for (simdjson::ondemand::field field : object) {
+            static_cast<void>(field);
+        }
+    }
+
+    inline void onDemandDecode(simdjson::ondemand::value json, ObjectType & value) {
+        onDemandDecodeMembers(json.get_object(), value);
+    }
+
+)";
+        CHECK("\n" + writer.str() == expected);
+    }
+
+    SUBCASE("union") {
+        Type unionType{TypeKind::Union, "UnionType"};
+        unionType.possibleTypes = {TypeRef{TypeKind::Object, "A"}};
+
+        CodeWriter writer{0};
+        generateUnionOnDemandDecoding(writer, unionType, FunctionPart::Definition);
+        auto const expected = R"(
+void onDemandDecodeAlternative(simdjson::ondemand::object object, UnionType & value, std::string_view typeName) {
+    switch (typeName.size()) {
+    case 1:
+        if (typeName == "A") {
+            onDemandDecodeMembers(object, value.emplace<A>());
+            return;
+        }
+        break;
+    }
+    onDemandDecodeMembers(object, value.emplace<UnknownUnionType>());
+}
+
+void onDemandDecode(simdjson::ondemand::value json, UnionType & value) {
+    onDemandDecodeVariant(json, value);
+}
+
+)";
+        CHECK("\n" + writer.str() == expected);
+    }
+
+    SUBCASE("operation response decoder") {
+        Field field{TypeRef{TypeKind::Object, "ObjectType"}, "object"};
+
+        CodeWriter writer{0};
+        generateOperationResponseDecoder(writer, field, FunctionPart::Declaration, ResponseDecoding::OnDemand);
+        auto const expected = R"(
+static GraphqlResponse<ResponseData> decodeResponse(simdjson::padded_string_view body);
+
+static GraphqlResponse<ResponseData> decodeResponse(char const * body, size_t size);
+
+static GraphqlResponse<ResponseData> decodeResponse(std::string const & body) {
+    return decodeResponse(body.data(), body.size());
+}
+
+)";
+        CHECK("\n" + writer.str() == expected);
+
+        CodeWriter definition{0};
+        generateOperationResponseDecoder(definition, field, FunctionPart::Definition, ResponseDecoding::OnDemand);
+        auto const expectedDefinition = R"(
+GraphqlResponse<ObjectField::ResponseData> ObjectField::decodeResponse(simdjson::padded_string_view body) {
+    return decodeOnDemandResponse<ResponseData>(body, "object", false);
+}
+
+GraphqlResponse<ObjectField::ResponseData> ObjectField::decodeResponse(char const * body, size_t size) {
+    return decodeResponse(onDemandPaddedCopy(body, size));
+}
+
+)";
+        CHECK("\n" + definition.str() == expectedDefinition);
+    }
+
+    SUBCASE("types") {
+        Schema schema;
+        schema.queryType = Schema::OperationType{"Query"};
+
+        Type a{TypeKind::Object, "A"};
+        a.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        Type query{TypeKind::Object, "Query"};
+        query.fields = {Field{TypeRef{TypeKind::Object, "A"}, "a"}};
+
+        schema.types = {a, query};
+
+        auto const inlined = generateTypes(
+                schema,
+                "caffql",
+                AlgebraicNamespace::Std,
+                1,
+                FunctionPart::InlineDefinition,
+                ResponseDecoding::OnDemand);
+        CHECK(inlined.find("#include \"nlohmann/json.hpp\"\n#include \"simdjson.h\"\n") != std::string::npos);
+        CHECK(inlined.find("inline simdjson::ondemand::parser & onDemandParser() {\n") != std::string::npos);
+        CHECK(inlined.find("void onDemandDecode(simdjson::ondemand::value json, BoxedOptional<T> & box) {\n")
+              != std::string::npos);
+        // A is recursive, so its decoding is declared before it is defined.
+        CHECK(inlined.find("    inline void onDemandDecode(simdjson::ondemand::value json, A & value);\n")
+              != std::string::npos);
+        CHECK(inlined.find("Sax") == std::string::npos);
+
+        auto const header = generateTypes(
+                schema, "caffql", AlgebraicNamespace::Std, 1, FunctionPart::Declaration, ResponseDecoding::OnDemand);
+        CHECK(header.find("simdjson.h") == std::string::npos);
+        CHECK(header.find("namespace simdjson {\nclass padded_string_view;\n}\n") != std::string::npos);
+        CHECK(header.find("onDemandDecode(") == std::string::npos);
+
+        auto const source = generateSource(
+                schema, "caffql", AlgebraicNamespace::Std, "Generated.hpp", 1, ResponseDecoding::OnDemand);
+        CHECK(source.find("#include \"nlohmann/json.hpp\"\n#include \"simdjson.h\"\n#include <bitset>\n\n")
+              != std::string::npos);
+        CHECK(source.find("    void onDemandDecode(simdjson::ondemand::value json, A & value);\n")
+              != std::string::npos);
+        CHECK(source.find("    void onDemandDecode(simdjson::ondemand::value json, A & value) {\n")
+              != std::string::npos);
+    }
 }
 
 TEST_CASE("input object generation") {
@@ -248,6 +1181,12 @@ TEST_CASE("input object generation") {
             json["field"] = value.field;
         }
 
+        inline void write_json(JsonWriter & writer, InputObjectType const & value) {
+            writer.append("{\"field\":");
+            write_json(writer, value.field);
+            writer.append('}');
+        }
+
 )";
         CHECK("\n" + generateInputObjectSerialization(inputObjectType, 2) == expected);
     }
@@ -282,6 +1221,82 @@ TEST_CASE("request function argument passing") {
     }
 }
 
+TEST_CASE("request body generation") {
+    Type userType{TypeKind::Object, "User"};
+    userType.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "name"}};
+
+    Field userField{TypeRef{TypeKind::Object, "User"}, "user"};
+    userField.args = {InputValue{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"}};
+
+    TypeMap typeMap{{userType}};
+
+    auto const expected = R"cpp(
+        static string_view constexpr requestBodyPrefix = R"({"query":"query User(\n    $id: ID!\n) {\n    user(\n)cpp"
+                               R"cpp(        id: $id\n    ) {\n        name\n    }\n}\n","variables":)";
+
+        static string_view constexpr queryHash = "70aa3c7f12132f182db77c0c014734c9584c34a4b8ed6cd8f391e4d64e6807fb";
+
+        static string_view constexpr persistedRequestBodyPrefix = R"({"extensions":{"persistedQuery":{"version":1,)cpp"
+                               R"cpp("sha256Hash":"70aa3c7f12132f182db77c0c014734c9)cpp"
+                               R"cpp(584c34a4b8ed6cd8f391e4d64e6807fb"}},)";
+
+        static void writeVariables(JsonWriter & writer, Id const & id) {
+            writer.append("{\"id\":");
+            write_json(writer, id);
+            writer.append('}');
+        }
+
+        static void writeRequestBody(std::string & body, Id const & id) {
+            JsonWriter writer{body};
+            writer.append(requestBodyPrefix);
+            writeVariables(writer, id);
+            writer.append('}');
+        }
+
+        static std::string requestBody(Id const & id) {
+            std::string body;
+            writeRequestBody(body, id);
+            return body;
+        }
+
+        static void writePersistedRequestBody(std::string & body, bool includeQuery, Id const & id) {
+            JsonWriter writer{body};
+            writer.append(persistedRequestBodyPrefix);
+            if (includeQuery) {
+                writer.append(requestBodyPrefix.substr(1));
+            } else {
+                writer.append("\"variables\":");
+            }
+            writeVariables(writer, id);
+            writer.append('}');
+        }
+
+        static std::string persistedRequestBody(bool includeQuery, Id const & id) {
+            std::string body;
+            writePersistedRequestBody(body, includeQuery, id);
+            return body;
+        }
+
+)cpp";
+    CHECK("\n" + generateOperationRequestBodyFunction(userField, Operation::Query, typeMap, 2) == expected);
+    CHECK(sha256Hex("query User(\n    $id: ID!\n) {\n    user(\n        id: $id\n    ) {\n        name\n    }\n}\n") ==
+          "70aa3c7f12132f182db77c0c014734c9584c34a4b8ed6cd8f391e4d64e6807fb");
+}
+
+TEST_CASE("type map") {
+    Type object{TypeKind::Object, "Object"};
+    Type enumType{TypeKind::Enum, "Enum"};
+    TypeMap typeMap{{object, enumType}};
+
+    CHECK(typeMap.size() == 2);
+    CHECK(typeMap.indexOf("Enum") == 1);
+    CHECK(typeMap.at("Object") == object);
+    CHECK(typeMap.at(TypeIndex{1}) == enumType);
+    CHECK(typeMap.find("Missing") == TypeMap::npos);
+    CHECK_THROWS_AS(typeMap.at("Missing"), std::out_of_range);
+    CHECK(TypeMap{}.find("Object") == TypeMap::npos);
+}
+
 TEST_CASE("query field generation") {
     TypeMap typeMap;
     std::vector<QueryVariable> variables;
@@ -304,7 +1319,7 @@ TEST_CASE("query field generation") {
         objectType.fields = {Field{TypeRef{TypeKind::Scalar, "Int"}, "intField"},
                              Field{subobjectType, "subobjectField"}};
 
-        typeMap = {{"Object", objectType}, {"Subobject", subobjectType}};
+        typeMap = TypeMap{{objectType, subobjectType}};
 
         Field field{objectType, "field"};
 
@@ -333,7 +1348,7 @@ TEST_CASE("query field generation") {
 
         interfaceType.possibleTypes = {impA, impB};
 
-        typeMap = {{"Interface", interfaceType}, {"ImpA", impA}, {"ImpB", impB}};
+        typeMap = TypeMap{{interfaceType, impA, impB}};
 
         Field field{interfaceType, "field"};
 
@@ -361,7 +1376,7 @@ TEST_CASE("query field generation") {
 
         unionType.possibleTypes = {impA, impB};
 
-        typeMap = {{"Union", unionType}, {"ImpA", impA}, {"ImpB", impB}};
+        typeMap = TypeMap{{unionType, impA, impB}};
 
         Field field{unionType, "field"};
 
@@ -404,6 +1419,51 @@ TEST_CASE("query field generation") {
         CHECK(variables == expectedVariables);
     }
 
+    SUBCASE("recursive fields") {
+        Type objectType{TypeKind::Object, "Object"};
+        objectType.fields = {Field{TypeRef{TypeKind::Scalar, "Int"}, "intField"},
+                             Field{TypeRef{TypeKind::Object, "Object"}, "parent"},
+                             Field{TypeRef{TypeKind::Object, "Other"}, "other"}};
+
+        Type otherType{TypeKind::Object, "Other"};
+        otherType.fields = {Field{TypeRef{TypeKind::Object, "Object"}, "object"},
+                            Field{TypeRef{TypeKind::Scalar, "Float"}, "floatField"}};
+
+        typeMap = TypeMap{{objectType, otherType}};
+
+        Field field{objectType, "field"};
+
+        auto expected = R"(
+        field {
+            intField
+            other {
+                floatField
+            }
+        }
+)";
+
+        CHECK("\n" + generateQueryField(field, typeMap, "", variables, 2) == expected);
+    }
+
+    SUBCASE("recursive fields without scalar fields") {
+        Type aType{TypeKind::Object, "A", "", {Field{TypeRef{TypeKind::Object, "B"}, "b"}}};
+        Type bType{TypeKind::Object, "B", "", {Field{TypeRef{TypeKind::Object, "A"}, "a"}}};
+
+        typeMap = TypeMap{{aType, bType}};
+
+        Field field{aType, "a"};
+
+        auto expected = R"(
+        a {
+            b {
+                __typename
+            }
+        }
+)";
+
+        CHECK("\n" + generateQueryField(field, typeMap, "", variables, 2) == expected);
+    }
+
     SUBCASE("nested arguments") {
         Type objectType{TypeKind::Object, "Object"};
         Field nestedField{TypeRef{TypeKind::Scalar, "Int"}, "nestedField"};
@@ -414,7 +1474,7 @@ TEST_CASE("query field generation") {
 
         Field field{objectType, "field"};
 
-        typeMap = {{"Object", objectType}};
+        typeMap = TypeMap{{objectType}};
 
         auto expected = R"(
         field {
@@ -432,4 +1492,186 @@ TEST_CASE("query field generation") {
     }
 }
 
+TEST_CASE("compact query generation") {
+
+    SUBCASE("variable names are as short as they can be") {
+        CHECK(compactVariableName(0) == "a");
+        CHECK(compactVariableName(25) == "z");
+        CHECK(compactVariableName(26) == "A");
+        CHECK(compactVariableName(51) == "Z");
+        CHECK(compactVariableName(52) == "aa");
+        CHECK(compactVariableName(53) == "ab");
+        CHECK(compactVariableName(52 + 52 * 52 - 1) == "ZZ");
+        CHECK(compactVariableName(52 + 52 * 52) == "aaa");
+    }
+
+    SUBCASE("insignificant whitespace is stripped and variables are renamed") {
+        std::vector<QueryVariable> variables{{"userId", TypeRef{TypeKind::Scalar, "ID"}, "a"},
+                                             {"userPostsFirst", TypeRef{TypeKind::Scalar, "Int"}, "b"}};
+        auto const query = R"(
+user(
+    id: $userId
+) {
+    __typename
+    id
+    ...on Admin {
+        posts(
+            first: $userPostsFirst
+        ) {
+            id
+        }
+        name
+    }
+}
+)";
+        CHECK(compactQuery(query, variables) ==
+              "user(id:$a){__typename id...on Admin{posts(first:$b){id}name}}");
+        CHECK_THROWS_AS(compactQuery(query, {variables[0]}), std::logic_error);
+    }
+
+    Type userType{TypeKind::Object, "User"};
+    userType.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "name"}};
+    userType.fields[0].args = {InputValue{TypeRef{TypeKind::Scalar, "Int"}, "length"}};
+
+    Field userField{TypeRef{TypeKind::Object, "User"}, "user"};
+    userField.args = {InputValue{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"}};
+
+    TypeMap typeMap{{userType}};
+
+    SUBCASE("documents") {
+        auto const document = generateQueryDocument(userField, Operation::Query, typeMap, 2, QueryFormat::Compact);
+        CHECK(document.query == "query User($a:ID!$b:Int){user(id:$a){name(length:$b)}}");
+
+        std::vector<QueryVariable> expectedVariables{{"id", userField.args[0].type, "a"},
+                                                     {"userNameLength", TypeRef{TypeKind::Scalar, "Int"}, "b"}};
+        CHECK(document.variables == expectedVariables);
+
+        Field nameField{TypeRef{TypeKind::Scalar, "String"}, "name"};
+        CHECK(generateQueryDocument(nameField, Operation::Query, typeMap, 0, QueryFormat::Compact).query ==
+              "query Name{name}");
+    }
+
+    SUBCASE("request functions keep the descriptive parameter names") {
+        auto const expected = R"cpp(
+        static Json request(Id const & id, optional<int32_t> userNameLength) {
+            Json query = R"(query User($a:ID!$b:Int){user(id:$a){name(length:$b)}})";
+            Json variables;
+            variables["a"] = id;
+            variables["b"] = userNameLength;
+            return {{"query", std::move(query)}, {"variables", std::move(variables)}};
+        }
+
+)cpp";
+        CHECK("\n" + generateOperationRequestFunction(userField, Operation::Query, typeMap, 2, QueryFormat::Compact) ==
+              expected);
+
+        auto const body =
+                generateOperationRequestBodyFunction(userField, Operation::Query, typeMap, 2, QueryFormat::Compact);
+        CHECK(body.find(R"("query User($a:ID!$b:Int){user(id:$a){name(length:$b)}}")") != std::string::npos);
+        CHECK(body.find(R"(writer.append("{\"a\":");)") != std::string::npos);
+        CHECK(body.find("writeVariables(JsonWriter & writer, Id const & id, optional<int32_t> userNameLength)") !=
+              std::string::npos);
+    }
+}
+
+TEST_CASE("query fragment generation") {
+    Type userType{TypeKind::Object, "User"};
+    userType.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"},
+                       Field{TypeRef{TypeKind::Scalar, "String"}, "displayName"},
+                       Field{TypeRef{TypeKind::Scalar, "String"}, "emailAddress"},
+                       Field{TypeRef{TypeKind::Scalar, "String"}, "avatarUrl"}};
+
+    Type postType{TypeKind::Object, "Post"};
+    postType.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "title"},
+                       Field{TypeRef{TypeKind::Object, "User"}, "author"},
+                       Field{TypeRef{TypeKind::Object, "User"}, "editor"},
+                       Field{TypeRef{TypeKind::Object, "User"}, "reviewer"}};
+
+    TypeMap typeMap{{userType, postType}};
+    Field postField{TypeRef{TypeKind::Object, "Post"}, "post"};
+
+    SUBCASE("repeated selection sets are spread from a fragment") {
+        auto const document = generateQueryDocument(postField, Operation::Query, typeMap, 0);
+        CHECK(document.query == R"(query Post(
+) {
+    post {
+        title
+        author {
+            ...UserFields
+        }
+        editor {
+            ...UserFields
+        }
+        reviewer {
+            ...UserFields
+        }
+    }
+}
+fragment UserFields on User {
+    id
+    displayName
+    emailAddress
+    avatarUrl
+}
+)");
+
+        CHECK(generateQueryDocument(postField, Operation::Query, typeMap, 0, QueryFormat::Compact).query ==
+              "query Post{post{title author{...UserFields}editor{...UserFields}reviewer{...UserFields}}}"
+              "fragment UserFields on User{id displayName emailAddress avatarUrl}");
+    }
+
+    SUBCASE("fragments replace the type conditions of possible types") {
+        Type actorType{TypeKind::Union, "Actor"};
+        actorType.possibleTypes = {TypeRef{TypeKind::Object, "User"}};
+        Type actorPostType = postType;
+        actorPostType.fields[3] = Field{TypeRef{TypeKind::Union, "Actor"}, "reviewer"};
+        TypeMap actorTypeMap{{userType, actorPostType, actorType}};
+
+        CHECK(generateQueryDocument(postField, Operation::Query, actorTypeMap, 0, QueryFormat::Compact).query ==
+              "query Post{post{title author{...UserFields}editor{...UserFields}reviewer{__typename...UserFields}}}"
+              "fragment UserFields on User{id displayName emailAddress avatarUrl}");
+    }
+
+    SUBCASE("selection sets with variables stay inline") {
+        Type argumentUserType = userType;
+        argumentUserType.fields[3].args = {InputValue{TypeRef{TypeKind::Scalar, "Int"}, "size"}};
+        TypeMap argumentTypeMap{{argumentUserType, postType}};
+
+        auto const document = generateQueryDocument(postField, Operation::Query, argumentTypeMap, 0);
+        CHECK(document.query.find("fragment") == std::string::npos);
+        CHECK(document.variables.size() == 3);
+    }
+
+    SUBCASE("selection sets shorter than a fragment stay inline") {
+        Type shortUserType{TypeKind::Object, "User"};
+        shortUserType.fields = {userType.fields[0]};
+        TypeMap shortTypeMap{{shortUserType, postType}};
+        CHECK(generateQueryDocument(postField, Operation::Query, shortTypeMap, 0, QueryFormat::Compact).query ==
+              "query Post{post{title author{id}editor{id}reviewer{id}}}");
+    }
+}
+
+TEST_CASE("shared selection set generation") {
+    // Each level reaches the next through two fields, so the query reaches the last level 2^31 times, and only
+    // generates in reasonable time when the selection set of each level is built once.
+    std::vector<Type> levels;
+    for (size_t depth = 0; depth < 32; ++depth) {
+        Type level{TypeKind::Object, "Level" + std::to_string(depth)};
+        level.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"}};
+        if (depth + 1 < 32) {
+            TypeRef const next{TypeKind::Object, "Level" + std::to_string(depth + 1)};
+            level.fields.push_back(Field{next, "left"});
+            level.fields.push_back(Field{next, "right"});
+        }
+        levels.push_back(level);
+    }
+    TypeMap typeMap{levels};
+
+    auto const document = generateQueryDocument(
+            Field{TypeRef{TypeKind::Object, "Level0"}, "tree"}, Operation::Query, typeMap, 0, QueryFormat::Compact);
+    CHECK(document.query.size() < 4000);
+    CHECK(document.query.find("fragment Level1Fields on Level1{id left{...Level2Fields}right{...Level2Fields}}") !=
+          std::string::npos);
+}
+
 TEST_SUITE_END;
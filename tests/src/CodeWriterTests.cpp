@@ -0,0 +1,58 @@
+#include "CodeWriter.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("CodeWriter");
+
+TEST_CASE("indents lines at the tracked indentation") {
+    CodeWriter writer{1};
+    writer.indent() << "struct A {\n";
+    writer.indent(1) << "int a;\n";
+    writer.increaseIndentation();
+    writer.indent() << "int b;\n";
+    writer.decreaseIndentation();
+    writer.indent() << "};\n";
+
+    CHECK(writer.str() == "    struct A {\n        int a;\n        int b;\n    };\n");
+    CHECK(writer.indentation() == 1);
+}
+
+TEST_CASE("capitalization") {
+    CodeWriter writer;
+    writer.capitalized("field") << ' ';
+    writer.uncapitalized("Field") << ' ';
+    writer.capitalized("");
+    CHECK(writer.str() == "Field field ");
+}
+
+TEST_CASE("truncate discards what was written after a mark") {
+    CodeWriter writer;
+    writer << "kept";
+    auto const mark = writer.size();
+    writer << " discarded";
+    writer.truncate(mark);
+    CHECK(writer.take() == "kept");
+}
+
+TEST_CASE("flushing hands the written code to the sink") {
+    std::string flushed;
+    CodeWriter writer{[&](std::string_view code) { flushed += code; }};
+    writer << "first\n";
+    writer.flush();
+    CHECK(flushed == "first\n");
+    CHECK(writer.str().empty());
+
+    writer << "second\n";
+    writer.flush();
+    CHECK(flushed == "first\nsecond\n");
+}
+
+TEST_CASE("flushing without a sink keeps the code") {
+    CodeWriter writer;
+    writer << "kept";
+    writer.flush();
+    CHECK(writer.str() == "kept");
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,25 @@
+#include "Depfile.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Depfile");
+
+TEST_CASE("lists prerequisites of the target") {
+    CHECK(generateDepfile({"Generated.hpp"}, {"schema.json", "other.json"}) ==
+          "Generated.hpp: \\\n    schema.json \\\n    other.json\n");
+}
+
+TEST_CASE("lists every target") {
+    CHECK(generateDepfile({"Generated.hpp", "Generated.cpp", "split/Query.hpp"}, {"schema.json"}) ==
+          "Generated.hpp Generated.cpp split/Query.hpp: \\\n    schema.json\n");
+}
+
+TEST_CASE("targets without prerequisites") { CHECK(generateDepfile({"Generated.hpp"}, {}) == "Generated.hpp:\n"); }
+
+TEST_CASE("escapes special characters") {
+    CHECK(generateDepfile({"my dir/Generated.hpp"}, {"$schema#1.json"}) ==
+          "my\\ dir/Generated.hpp: \\\n    $$schema\\#1.json\n");
+}
+
+TEST_SUITE_END;
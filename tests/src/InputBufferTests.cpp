@@ -0,0 +1,66 @@
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include "InputBuffer.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Input Buffer");
+
+namespace {
+
+struct TemporaryFile {
+    std::string path;
+
+    explicit TemporaryFile(std::string const & contents)
+        : path{(std::filesystem::temp_directory_path() / "caffql-input-buffer-test.json").string()} {
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+    }
+
+    ~TemporaryFile() { std::filesystem::remove(path); }
+};
+
+} // namespace
+
+TEST_CASE("reads file contents") {
+    TemporaryFile file{R"({"data": {}})"};
+
+    SUBCASE("mapped") {
+        auto buffer = InputBuffer::open(file.path, InputMode::Mapped);
+#if defined(__unix__) || defined(__APPLE__)
+        CHECK(buffer.isMapped());
+#endif
+        CHECK(buffer.view() == R"({"data": {}})");
+    }
+
+    SUBCASE("buffered") {
+        auto buffer = InputBuffer::open(file.path, InputMode::Buffered);
+        CHECK_FALSE(buffer.isMapped());
+        CHECK(buffer.view() == R"({"data": {}})");
+    }
+}
+
+TEST_CASE("empty files produce an empty buffer") {
+    TemporaryFile file{""};
+    auto buffer = InputBuffer::open(file.path, InputMode::Mapped);
+    CHECK_FALSE(buffer.isMapped());
+    CHECK(buffer.size() == 0);
+}
+
+TEST_CASE("moving transfers the contents") {
+    TemporaryFile file{"contents"};
+    auto a = InputBuffer::open(file.path, InputMode::Mapped);
+    auto const data = a.data();
+    auto b = std::move(a);
+    CHECK(a.size() == 0);
+    CHECK(b.data() == data);
+    CHECK(b.view() == "contents");
+}
+
+TEST_CASE("missing files throw") {
+    CHECK_THROWS_AS(InputBuffer::open("/nonexistent/schema.json", InputMode::Mapped), std::system_error);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,154 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <vector>
+#include "OutputFile.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Output File");
+
+namespace {
+
+std::string const path = (std::filesystem::temp_directory_path() / "caffql-output-file-test.hpp").string();
+
+bool hasTemporaryFiles() {
+    auto const prefix = std::filesystem::path{path}.filename().string() + '.';
+    for (auto const & entry : std::filesystem::directory_iterator{std::filesystem::temp_directory_path()}) {
+        if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string contents() {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+}
+
+} // namespace
+
+TEST_CASE("writes in order across buffer flushes") {
+    std::string const large(OutputFile::bufferSize + 1, 'b');
+    std::string const filler(OutputFile::bufferSize - 1, 'c');
+
+    auto file = OutputFile::create(path);
+    file.write("a");
+    file.write(large);
+    file.write(filler);
+    file.write("d");
+    file.close();
+
+    CHECK_FALSE(file.isOpen());
+    CHECK(contents() == "a" + large + filler + "d");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("files that aren't closed leave the output untouched") {
+    {
+        auto file = OutputFile::create(path);
+        file.write("old");
+        file.close();
+    }
+    {
+        auto file = OutputFile::create(path);
+        file.write("new");
+    }
+    CHECK(contents() == "old");
+    CHECK_FALSE(hasTemporaryFiles());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("outputs are only replaced when their contents change") {
+    auto write = [](std::vector<std::string> const & pieces) {
+        auto file = OutputFile::create(path);
+        for (auto const & piece : pieces) {
+            file.write(piece);
+        }
+        return file.close();
+    };
+
+    CHECK(write({"first", " second"}));
+    auto const modified = std::filesystem::last_write_time(path);
+
+    CHECK_FALSE(write({"first second"}));
+    CHECK(std::filesystem::last_write_time(path) == modified);
+
+    SUBCASE("shorter") {
+        CHECK(write({"first"}));
+        CHECK(contents() == "first");
+    }
+
+    SUBCASE("longer") {
+        CHECK(write({"first second", " third"}));
+        CHECK(contents() == "first second third");
+    }
+
+    SUBCASE("different") {
+        CHECK(write({"first", " changed"}));
+        CHECK(contents() == "first changed");
+    }
+
+    CHECK_FALSE(hasTemporaryFiles());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("concurrently written outputs use separate temporary files") {
+    auto a = OutputFile::create(path);
+    auto b = OutputFile::create(path);
+    a.write("first");
+    b.write("second");
+    CHECK(b.close());
+    CHECK(contents() == "second");
+    CHECK(a.close());
+    CHECK(contents() == "first");
+    CHECK_FALSE(hasTemporaryFiles());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("replaced outputs keep their permissions") {
+    namespace fs = std::filesystem;
+    {
+        auto file = OutputFile::create(path);
+        file.write("old");
+        file.close();
+    }
+    auto const permissions = fs::perms::owner_read | fs::perms::owner_write | fs::perms::owner_exec;
+    fs::permissions(path, permissions);
+
+    auto file = OutputFile::create(path);
+    file.write("new");
+    CHECK(file.close());
+    CHECK(contents() == "new");
+    CHECK(fs::status(path).permissions() == permissions);
+    fs::remove(path);
+}
+
+TEST_CASE("empty outputs are created") {
+    std::filesystem::remove(path);
+    CHECK(OutputFile::create(path).close());
+    CHECK(std::filesystem::exists(path));
+    CHECK(contents().empty());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("moving transfers the file") {
+    auto a = OutputFile::create(path);
+    a.write("moved");
+    auto b = std::move(a);
+    CHECK_FALSE(a.isOpen());
+    b.close();
+    CHECK(contents() == "moved");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("uncreatable files throw") {
+    CHECK_THROWS_AS(OutputFile::create("/nonexistent/generated.hpp"), std::system_error);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,85 @@
+#include <filesystem>
+#include "SchemaCache.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Schema Cache");
+
+static Schema makeSchema() {
+    Type status{TypeKind::Enum, "Status", "Multiline\ndescription"};
+    status.enumValues = {{"ACTIVE"}, {"INACTIVE", "Description"}};
+
+    Type filter{TypeKind::InputObject, "Filter"};
+    filter.inputFields = {InputValue{TypeRef{TypeKind::NonNull, {}, {status}}, "status", ""}};
+
+    Type node{TypeKind::Interface, "Node"};
+    node.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"}};
+    node.possibleTypes = {TypeRef{TypeKind::Object, "User"}};
+
+    Type user{TypeKind::Object, "User", "A user"};
+    user.fields = node.fields;
+    user.fields.push_back(
+            Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::NonNull, {}, {status}}}, "statuses", "", {}});
+    user.interfaces = {node};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::List, {}, {user}},
+                          "users",
+                          std::nullopt,
+                          {InputValue{filter, "filter"}, InputValue{TypeRef{TypeKind::Scalar, "Int"}, "first"}}}};
+
+    return {Schema::OperationType{"Query"}, std::nullopt, Schema::OperationType{""}, {status, filter, node, user, query}};
+}
+
+TEST_CASE("round trips the schema") {
+    auto const schema = makeSchema();
+    auto const cache = serializeSchemaCache(schema, 1);
+    auto const loaded = deserializeSchemaCache(cache, 1);
+    REQUIRE(loaded);
+    CHECK(*loaded == schema);
+}
+
+TEST_CASE("rejects stale or malformed caches") {
+    auto const cache = serializeSchemaCache(makeSchema(), 1);
+
+    SUBCASE("different source hash") { CHECK_FALSE(deserializeSchemaCache(cache, 2)); }
+
+    SUBCASE("truncated") { CHECK_FALSE(deserializeSchemaCache(cache.substr(0, cache.size() - 1), 1)); }
+
+    SUBCASE("empty") { CHECK_FALSE(deserializeSchemaCache("", 1)); }
+
+    SUBCASE("corrupted index") {
+        auto corrupted = cache;
+        // The last record is the TypeRef for User's interface: point its name past the end of the string table.
+        corrupted[corrupted.size() - 1] = '\x7f';
+        CHECK_FALSE(deserializeSchemaCache(corrupted, 1));
+    }
+}
+
+TEST_CASE("source hash depends on content") {
+    CHECK(hashSchemaSource("{}") == hashSchemaSource("{}"));
+    CHECK(hashSchemaSource("{}") != hashSchemaSource("{ }"));
+}
+
+TEST_CASE("cache file is written and reused") {
+    auto const path = (std::filesystem::temp_directory_path() / "caffql-schema-cache-test.bin").string();
+    std::filesystem::remove(path);
+
+    auto const source = R"({"data": {"__schema": {"queryType": {"name": "Query"}, "types": [
+        {"kind": "OBJECT", "name": "Query", "fields": []}
+    ]}}})";
+
+    auto const parsed = loadSchemaWithCache(source, path);
+    CHECK(std::filesystem::exists(path));
+    CHECK(loadSchemaWithCache(source, path) == parsed);
+
+    SUBCASE("changed sources invalidate the cache") {
+        auto const changedSource = R"({"data": {"__schema": {"queryType": {"name": "Root"}, "types": []}}})";
+        CHECK(loadSchemaWithCache(changedSource, path).queryType->name == "Root");
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,109 @@
+#include <sstream>
+#include "SchemaLoader.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Schema Loader");
+
+static auto const introspectionResponse = R"({
+    "data": {
+        "__schema": {
+            "queryType": {"name": "Query"},
+            "mutationType": null,
+            "types": [
+                {
+                    "kind": "OBJECT",
+                    "name": "Query",
+                    "description": "Root\nquery",
+                    "fields": [
+                        {
+                            "name": "users",
+                            "description": null,
+                            "args": [
+                                {
+                                    "name": "first",
+                                    "description": "Count",
+                                    "type": {"kind": "SCALAR", "name": "Int", "ofType": null},
+                                    "defaultValue": "10"
+                                }
+                            ],
+                            "type": {
+                                "kind": "NON_NULL",
+                                "name": null,
+                                "ofType": {
+                                    "kind": "LIST",
+                                    "name": null,
+                                    "ofType": {"kind": "INTERFACE", "name": "Node", "ofType": null}
+                                }
+                            },
+                            "isDeprecated": false,
+                            "deprecationReason": null
+                        }
+                    ],
+                    "inputFields": null,
+                    "interfaces": [],
+                    "enumValues": null,
+                    "possibleTypes": null
+                },
+                {
+                    "kind": "ENUM",
+                    "name": "Status",
+                    "enumValues": [{"name": "ACTIVE", "description": null, "isDeprecated": false}]
+                },
+                {
+                    "kind": "INPUT_OBJECT",
+                    "name": "Filter",
+                    "inputFields": [{"name": "status", "type": {"kind": "ENUM", "name": "Status"}}]
+                },
+                {
+                    "kind": "INTERFACE",
+                    "name": "Node",
+                    "fields": [],
+                    "possibleTypes": [{"kind": "OBJECT", "name": "User", "ofType": null}]
+                }
+            ],
+            "directives": [{"name": "skip", "locations": ["FIELD"], "args": []}]
+        }
+    },
+    "extensions": {"cost": [1, 2.5, true, {"nested": null}]}
+})";
+
+TEST_CASE("loads the same schema as Json deserialization") {
+    Schema expected = Json::parse(introspectionResponse).at("data").at("__schema");
+
+    SUBCASE("from a string") { CHECK(loadSchema(std::string{introspectionResponse}) == expected); }
+
+    SUBCASE("from a stream") {
+        std::istringstream stream{introspectionResponse};
+        CHECK(loadSchema(stream) == expected);
+    }
+
+    SUBCASE("spot check") {
+        auto schema = loadSchema(std::string{introspectionResponse});
+        REQUIRE(schema.types.size() == 4);
+        CHECK(schema.queryType->name == "Query");
+        CHECK_FALSE(schema.mutationType);
+        CHECK(schema.types[0].description == "Root\nquery");
+        CHECK(graphqlTypeName(schema.types[0].fields[0].type) == "[Node]!");
+        CHECK(schema.types[0].fields[0].args[0].description == "Count");
+    }
+}
+
+TEST_CASE("missing required keys throw") {
+    CHECK_THROWS_AS(loadSchema(std::string{R"({"data": {}})"}), Json::out_of_range);
+    CHECK_THROWS_AS(loadSchema(std::string{R"({"data": {"__schema": {"types": [{"kind": "OBJECT"}]}}})"}),
+                    Json::out_of_range);
+}
+
+TEST_CASE("mistyped values throw") {
+    CHECK_THROWS_AS(loadSchema(std::string{R"({"data": {"__schema": {"types": {}}}})"}), Json::type_error);
+    CHECK_THROWS_AS(loadSchema(std::string{R"({"data": {"__schema": {"types": [{"kind": "ENUM", "name": 1}]}}})"}),
+                    Json::type_error);
+}
+
+TEST_CASE("malformed json throws a parse error") {
+    CHECK_THROWS_AS(loadSchema(std::string{R"({"data": {"__schema": )"}), Json::parse_error);
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,407 @@
+#include "SelectionManifest.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Selection Manifest");
+
+static Schema testSchema() {
+    Type node{TypeKind::Interface, "Node"};
+    node.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"}};
+    node.possibleTypes = {TypeRef{TypeKind::Object, "User"}, TypeRef{TypeKind::Object, "Post"}};
+
+    Type user{TypeKind::Object, "User"};
+    user.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"},
+                   Field{TypeRef{TypeKind::Scalar, "String"}, "name"},
+                   Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Object, "Post"}}, "posts"},
+                   Field{TypeRef{TypeKind::Object, "Profile"}, "profile"}};
+    user.interfaces = {TypeRef{TypeKind::Interface, "Node"}};
+
+    Type post{TypeKind::Object, "Post"};
+    post.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"},
+                   Field{TypeRef{TypeKind::Scalar, "Float"}, "score"},
+                   Field{TypeRef{TypeKind::Object, "User"}, "author"}};
+    post.interfaces = {TypeRef{TypeKind::Interface, "Node"}};
+
+    Type profile{TypeKind::Object, "Profile"};
+    profile.fields = {Field{TypeRef{TypeKind::Scalar, "String"}, "bio"},
+                      Field{TypeRef{TypeKind::Scalar, "String"}, "avatar"}};
+
+    Type searchResult{TypeKind::Union, "SearchResult"};
+    searchResult.possibleTypes = {TypeRef{TypeKind::Object, "User"}, TypeRef{TypeKind::Object, "Post"}};
+
+    Field userField{TypeRef{TypeKind::Object, "User"}, "user"};
+    userField.args = {InputValue{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {userField,
+                    Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Union, "SearchResult"}}, "search"},
+                    Field{TypeRef{TypeKind::Interface, "Node"}, "node"}};
+
+    Type mutation{TypeKind::Object, "Mutation"};
+    mutation.fields = {Field{TypeRef{TypeKind::Scalar, "Boolean"}, "logout"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.mutationType = Schema::OperationType{"Mutation"};
+    schema.types = {query, mutation, node, user, post, profile, searchResult};
+    return schema;
+}
+
+static std::vector<std::string> fieldNames(Schema const & schema, Symbol typeName) {
+    std::vector<std::string> names;
+    for (auto const & field : TypeMap{schema.types}.at(typeName).fields) {
+        names.push_back(field.name.str());
+    }
+    return names;
+}
+
+using Names = std::vector<std::string>;
+
+TEST_CASE("selected fields") {
+    auto const schema = testSchema();
+
+    SUBCASE("root fields that aren't named are left out") {
+        auto const selected = selectFields(schema, Json::parse(R"({"Query": {"user": {"id": true}}})"));
+        CHECK(fieldNames(selected, "Query") == Names{"user"});
+        CHECK(fieldNames(selected, "Mutation").empty());
+    }
+
+    SUBCASE("types keep the selected fields in schema order") {
+        auto const selected = selectFields(
+                schema, Json::parse(R"({"Query": {"user": {"profile": {"bio": true}, "name": true}}})"));
+        CHECK(fieldNames(selected, "User") == Names{"name", "profile"});
+        CHECK(fieldNames(selected, "Profile") == Names{"bio"});
+    }
+
+    SUBCASE("types that the selected fields don't reach are left out") {
+        auto const selected = selectFields(schema, Json::parse(R"({"Query": {"user": {"name": true}}})"));
+        TypeMap const typeMap{selected.types};
+        CHECK(typeMap.find("Post") == TypeMap::npos);
+        CHECK(typeMap.find("Node") == TypeMap::npos);
+        CHECK(typeMap.find("SearchResult") == TypeMap::npos);
+        CHECK(typeMap.at("User").interfaces.empty());
+    }
+
+    SUBCASE("true selects every nested field") {
+        auto const selected = selectFields(schema, Json::parse(R"({"Query": {"user": {"profile": true}}})"));
+        CHECK(fieldNames(selected, "User") == Names{"profile"});
+        CHECK(fieldNames(selected, "Profile") == Names{"bio", "avatar"});
+    }
+
+    SUBCASE("types that true reaches keep all of their fields") {
+        // Post's author is a User, so every field of User is selected along with the posts.
+        auto const selected = selectFields(schema, Json::parse(R"({"Query": {"user": {"id": true, "posts": true}}})"));
+        CHECK(fieldNames(selected, "User") == Names{"id", "name", "posts", "profile"});
+        CHECK(fieldNames(selected, "Post") == Names{"id", "score", "author"});
+    }
+
+    SUBCASE("types keep the fields of every selection") {
+        auto const selected = selectFields(
+                schema, Json::parse(R"({"Query": {"user": {"id": true}, "search": {"...on User": {"name": true}}}})"));
+        CHECK(fieldNames(selected, "Query") == Names{"user", "search"});
+        CHECK(fieldNames(selected, "User") == Names{"id", "name"});
+        CHECK(fieldNames(selected, "Post").empty());
+    }
+
+    SUBCASE("interface fields are selected on the possible types") {
+        auto const selected = selectFields(
+                schema, Json::parse(R"({"Query": {"node": {"id": true, "...on Post": {"score": true}}}})"));
+        CHECK(fieldNames(selected, "Node") == Names{"id"});
+        CHECK(fieldNames(selected, "User") == Names{"id"});
+        CHECK(fieldNames(selected, "Post") == Names{"id", "score"});
+    }
+
+    SUBCASE("selections that don't match the schema throw") {
+        auto checkThrows = [&](char const * manifest) {
+            CHECK_THROWS_AS(selectFields(schema, Json::parse(manifest)), std::invalid_argument);
+        };
+        checkThrows(R"(["user"])");
+        checkThrows(R"({"Profile": {"bio": true}})");
+        checkThrows(R"({"Query": {"missing": true}})");
+        checkThrows(R"({"Query": {"user": {"missing": true}}})");
+        checkThrows(R"({"Query": {"user": {"name": {"length": true}}}})");
+        checkThrows(R"({"Query": {"user": {"name": false}}})");
+        checkThrows(R"({"Query": {"search": {"...on Profile": {"bio": true}}}})");
+        checkThrows(R"({"Query": {"search": {"id": true}}})");
+        checkThrows(R"({"Query": {"search": {"...on User": {}}}})");
+    }
+
+    SUBCASE("empty selections throw") {
+        try {
+            selectFields(schema, Json::parse(R"({"Query": {"user": {}}})"));
+            FAIL("expected std::invalid_argument");
+        } catch (std::invalid_argument const & error) {
+            CHECK(std::string{error.what()} == "Selection manifest Query.user: expected at least one field to select");
+        }
+    }
+
+    SUBCASE("errors name the path of the selection") {
+        try {
+            selectFields(schema, Json::parse(R"({"Query": {"user": {"profile": {"missing": true}}}})"));
+            FAIL("expected std::invalid_argument");
+        } catch (std::invalid_argument const & error) {
+            CHECK(std::string{error.what()} ==
+                  "Selection manifest Query.user.profile.missing: Profile has no field named missing");
+        }
+    }
+}
+
+TEST_CASE("queries of selected fields") {
+    auto const selected = selectFields(
+            testSchema(), Json::parse(R"({"Query": {"user": {"name": true, "posts": {"score": true}}}})"));
+    TypeMap const typeMap{selected.types};
+
+    auto const document =
+            generateQueryDocument(typeMap.at("Query").fields[0], Operation::Query, typeMap, 0, QueryFormat::Compact);
+    CHECK(document.query == "query User($a:ID!){user(id:$a){name posts{score}}}");
+
+    CHECK(generateObject(typeMap.at("User"), 0) == R"(struct User {
+    optional<std::string> name;
+    optional<std::vector<optional<Post>>> posts;
+};
+
+)");
+}
+
+TEST_CASE("queries of explicitly nested recursive selections") {
+    Type comment{TypeKind::Object, "Comment"};
+    comment.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}}, "id"},
+                      Field{TypeRef{TypeKind::Scalar, "String"}, "text"},
+                      Field{TypeRef{TypeKind::Object, "Comment"}, "parent"}};
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Object, "Comment"}, "comment"}};
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {query, comment};
+
+    auto queryOf = [&](char const * manifestText) {
+        auto const manifest = Json::parse(manifestText);
+        auto const selected = selectFields(schema, manifest);
+        auto const selections = operationSelections(manifest);
+        TypeMap const typeMap{selected.types};
+        auto const & field = typeMap.at("Query").fields[0];
+        return generateQueryDocument(field,
+                                     Operation::Query,
+                                     typeMap,
+                                     0,
+                                     QueryFormat::Compact,
+                                     0,
+                                     &selections.at({Symbol{"Query"}, Symbol{"comment"}}))
+                .query;
+    };
+
+    SUBCASE("nested selections of a type being expanded are followed") {
+        CHECK(queryOf(R"({"Query": {"comment": {"id": true, "parent": {"id": true}}}})") ==
+              "query Comment{comment{id parent{id}}}");
+        // Each selection set only selects the fields that its own selection names.
+        CHECK(queryOf(R"({"Query": {"comment": {"parent": {"parent": {"text": true}}}}})") ==
+              "query Comment{comment{parent{parent{text}}}}");
+    }
+
+    SUBCASE("fields selected with true are left out where their type is being expanded") {
+        CHECK(queryOf(R"({"Query": {"comment": {"id": true, "parent": true}}})") == "query Comment{comment{id}}");
+    }
+}
+
+TEST_CASE("operations sharing a type") {
+    TypeRef const requiredId{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "ID"}};
+    TypeRef const requiredString{TypeKind::NonNull, {}, TypeRef{TypeKind::Scalar, "String"}};
+
+    Type node{TypeKind::Interface, "Node"};
+    node.fields = {Field{requiredId, "id"}};
+    node.possibleTypes = {TypeRef{TypeKind::Object, "User"}};
+
+    Type user{TypeKind::Object, "User"};
+    user.fields = {Field{requiredId, "id"}, Field{requiredString, "name"}, Field{requiredString, "email"}};
+    user.interfaces = {TypeRef{TypeKind::Interface, "Node"}};
+
+    Type result{TypeKind::Union, "Result"};
+    result.possibleTypes = {TypeRef{TypeKind::Object, "User"}};
+
+    Type query{TypeKind::Object, "Query"};
+    query.fields = {Field{TypeRef{TypeKind::Object, "User"}, "a"},
+                    Field{TypeRef{TypeKind::Object, "User"}, "b"},
+                    Field{TypeRef{TypeKind::Interface, "Node"}, "node"},
+                    Field{TypeRef{TypeKind::Union, "Result"}, "result"}};
+
+    Schema schema;
+    schema.queryType = Schema::OperationType{"Query"};
+    schema.types = {query, node, user, result};
+
+    auto requiredFields = [](Schema const & selected, Symbol typeName) {
+        TypeMap const typeMap{selected.types};
+        Names names;
+        for (auto const & field : typeMap.at(typeName).fields) {
+            if (field.type.kind() == TypeKind::NonNull) {
+                names.push_back(field.name.str());
+            }
+        }
+        return names;
+    };
+
+    auto queryOf = [](Schema const & selected, Json const & manifest, Symbol fieldName) {
+        auto const selections = operationSelections(manifest);
+        TypeMap const typeMap{selected.types};
+        auto const & fields = typeMap.at("Query").fields;
+        auto const field = std::find_if(
+                fields.begin(), fields.end(), [&](Field const & field) { return field.name == fieldName; });
+        return generateQueryDocument(*field,
+                                     Operation::Query,
+                                     typeMap,
+                                     0,
+                                     QueryFormat::Compact,
+                                     0,
+                                     &selections.at({Symbol{"Query"}, fieldName}))
+                .query;
+    };
+
+    SUBCASE("queries only select their own fields, which only some operations select are nullable") {
+        auto const manifest = Json::parse(R"({"Query": {"a": {"id": true}, "b": {"id": true, "name": true}}})");
+        auto const selected = selectFields(schema, manifest);
+        CHECK(fieldNames(selected, "User") == Names{"id", "name"});
+        CHECK(requiredFields(selected, "User") == Names{"id"});
+        CHECK(queryOf(selected, manifest, "a") == "query A{a{id}}");
+        CHECK(queryOf(selected, manifest, "b") == "query B{b{id name}}");
+    }
+
+    SUBCASE("fields selected everywhere the type is selected stay required") {
+        auto const selected = selectFields(
+                schema, Json::parse(R"({"Query": {"a": {"id": true, "name": true}, "b": {"name": true, "id": true}}})"));
+        CHECK(requiredFields(selected, "User") == Names{"id", "name"});
+    }
+
+    SUBCASE("types selected with true are selected whole") {
+        auto const manifest = Json::parse(R"({"Query": {"a": {"id": true}, "b": true}})");
+        auto const selected = selectFields(schema, manifest);
+        CHECK(fieldNames(selected, "User") == Names{"id", "name", "email"});
+        CHECK(requiredFields(selected, "User") == Names{"id"});
+        CHECK(queryOf(selected, manifest, "a") == "query A{a{id}}");
+    }
+
+    SUBCASE("possible types are selected with the interface's fields and their fragment") {
+        auto const manifest = Json::parse(
+                R"({"Query": {"a": {"id": true, "email": true}, "node": {"id": true, "...on User": {"name": true}}}})");
+        auto const selected = selectFields(schema, manifest);
+        CHECK(fieldNames(selected, "User") == Names{"id", "name", "email"});
+        CHECK(requiredFields(selected, "User") == Names{"id"});
+        CHECK(requiredFields(selected, "Node") == Names{"id"});
+        CHECK(queryOf(selected, manifest, "node") == "query Node{node{__typename id...on User{name}}}");
+    }
+
+    SUBCASE("possible types without a fragment in a union select none of their fields") {
+        auto const manifest = Json::parse(R"({"Query": {"a": {"id": true}, "result": {"...on User": {"id": true}}}})");
+        CHECK(requiredFields(selectFields(schema, manifest), "User") == Names{"id"});
+
+        auto const withoutFragment = Json::parse(R"({"Query": {"a": {"id": true}, "node": {"id": true}}})");
+        CHECK(requiredFields(selectFields(schema, withoutFragment), "User") == Names{"id"});
+        CHECK(queryOf(selectFields(schema, withoutFragment), withoutFragment, "node") ==
+              "query Node{node{__typename id}}");
+    }
+}
+
+TEST_CASE("limited selection depth") {
+    auto const schema = testSchema();
+
+    SUBCASE("fields below every query's limit are left out") {
+        SelectionDepth depth;
+        depth.maxDepth = 1;
+        auto const limited = limitSelectionDepth(schema, depth);
+        TypeMap const typeMap{limited.types};
+
+        CHECK(fieldNames(limited, "User") == Names{"id", "name"});
+        CHECK(fieldNames(limited, "Post") == Names{"id", "score"});
+        CHECK(typeMap.find("Profile") == TypeMap::npos);
+
+        auto const document = generateQueryDocument(
+                typeMap.at("Query").fields[0], Operation::Query, typeMap, 0, QueryFormat::Compact, 1);
+        CHECK(document.query == "query User($a:ID!){user(id:$a){id name}}");
+    }
+
+    SUBCASE("fields below some queries' limits are nullable") {
+        auto nonNullAuthorSchema = schema;
+        for (auto & type : nonNullAuthorSchema.types) {
+            if (type.name == Symbol{"Post"}) {
+                type.fields[2].type = TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "User"}};
+            }
+        }
+
+        SelectionDepth depth;
+        depth.operationMaxDepths[{Symbol{"Query"}, Symbol{"user"}}] = 2;
+        auto const limited = limitSelectionDepth(nonNullAuthorSchema, depth);
+        TypeMap const typeMap{limited.types};
+
+        CHECK(fieldNames(limited, "Post") == Names{"id", "score", "author"});
+        CHECK(typeMap.at("Post").fields[2].type == TypeRef{TypeKind::Object, "User"});
+
+        auto const document = generateQueryDocument(typeMap.at("Query").fields[0],
+                                                    Operation::Query,
+                                                    typeMap,
+                                                    0,
+                                                    QueryFormat::Compact,
+                                                    depth.maxDepthOf("Query", "user"));
+        CHECK(document.query ==
+              "query User($a:ID!){user(id:$a){id name posts{id score}profile{bio avatar}}}");
+    }
+
+    SUBCASE("selection sets left without fields select the type name") {
+        auto feedSchema = schema;
+        Type feed{TypeKind::Object, "Feed"};
+        feed.fields = {Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Object, "Post"}}, "posts"}};
+        feedSchema.types.push_back(feed);
+        feedSchema.types[0].fields.push_back(Field{TypeRef{TypeKind::Object, "Feed"}, "feed"});
+
+        SelectionDepth depth;
+        depth.operationMaxDepths[{Symbol{"Query"}, Symbol{"feed"}}] = 1;
+        auto const limited = limitSelectionDepth(feedSchema, depth);
+        TypeMap const typeMap{limited.types};
+
+        CHECK(fieldNames(limited, "Feed").empty());
+
+        auto const document = generateQueryDocument(
+                typeMap.at("Query").fields[3], Operation::Query, typeMap, 0, QueryFormat::Compact, 1);
+        CHECK(document.query == "query Feed{feed{__typename}}");
+    }
+
+    SUBCASE("nested selection sets left without fields select the type name") {
+        // The limit falls on Feed, whose fields all have selection sets of their own.
+        auto wrapperSchema = schema;
+        Type feed{TypeKind::Object, "Feed"};
+        feed.fields = {Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "Post"}}, "top"},
+                       Field{TypeRef{TypeKind::List, {}, TypeRef{TypeKind::Object, "User"}}, "authors"}};
+        Type wrapper{TypeKind::Object, "Wrapper"};
+        wrapper.fields = {Field{TypeRef{TypeKind::Scalar, "ID"}, "id"},
+                          Field{TypeRef{TypeKind::NonNull, {}, TypeRef{TypeKind::Object, "Feed"}}, "feed"}};
+        wrapperSchema.types.push_back(feed);
+        wrapperSchema.types.push_back(wrapper);
+        wrapperSchema.types[0].fields.push_back(Field{TypeRef{TypeKind::Object, "Wrapper"}, "wrapper"});
+
+        SelectionDepth depth;
+        depth.operationMaxDepths[{Symbol{"Query"}, Symbol{"wrapper"}}] = 2;
+        auto const limited = limitSelectionDepth(wrapperSchema, depth);
+        TypeMap const typeMap{limited.types};
+
+        CHECK(fieldNames(limited, "Wrapper") == Names{"id", "feed"});
+        CHECK(fieldNames(limited, "Feed").empty());
+
+        auto const document = generateQueryDocument(
+                typeMap.at("Query").fields[3], Operation::Query, typeMap, 0, QueryFormat::Compact, 2);
+        CHECK(document.query == "query Wrapper{wrapper{id feed{__typename}}}");
+
+        CHECK(generateObjectDeserialization(typeMap.at("Feed"), 0) ==
+              "inline void from_json(Json const &, Feed &) {}\n\n");
+    }
+
+    SUBCASE("limits of fields missing from the schema") {
+        SelectionDepth depth;
+        depth.operationMaxDepths[{Symbol{"Query"}, Symbol{"missing"}}] = 1;
+        try {
+            limitSelectionDepth(schema, depth);
+            FAIL("expected std::invalid_argument");
+        } catch (std::invalid_argument const & error) {
+            CHECK(std::string{error.what()} == "Selection depth Query.missing: Query has no field named missing");
+        }
+    }
+}
+
+TEST_SUITE_END;
@@ -0,0 +1,38 @@
+#include "Symbol.hpp"
+#include "doctest.h"
+
+using namespace caffql;
+
+TEST_SUITE_BEGIN("Symbol");
+
+TEST_CASE("symbols with equal text are the same symbol") {
+    Symbol a{"text"};
+    Symbol b{std::string{"te"} + "xt"};
+    CHECK(a == b);
+    CHECK(a.id() == b.id());
+    CHECK(&a.str() == &b.str());
+    CHECK(a != Symbol{"other"});
+}
+
+TEST_CASE("empty symbol") {
+    CHECK(Symbol{}.empty());
+    CHECK(Symbol{""} == Symbol{});
+    CHECK(Symbol{}.id() == 0);
+    CHECK(Symbol{}.str().empty());
+}
+
+TEST_CASE("ids are dense") {
+    Symbol symbol{"dense id"};
+    CHECK(symbol.id() > 0);
+    CHECK(symbol.id() < Symbol::count());
+}
+
+TEST_CASE("ordering is alphabetical") {
+    Symbol b{"b"};
+    Symbol a{"a"};
+    CHECK(a < b);
+    CHECK_FALSE(b < a);
+    CHECK_FALSE(a < a);
+}
+
+TEST_SUITE_END;